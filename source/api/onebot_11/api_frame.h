@@ -0,0 +1,164 @@
+#ifndef MIGANGBOT_API_ONTBOT_11_API_FRAME_H_
+#define MIGANGBOT_API_ONTBOT_11_API_FRAME_H_
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace white {
+namespace onebot11 {
+
+// 直接写出的api请求帧: {"action":"...","params":{...},"echo":N}。
+// 不构造Json，参数按顺序追加到缓冲区，字符串只转义一次；
+// echo在发送前由Finish追加，不需要重新序列化
+class ApiFrame {
+ public:
+  // 每个线程复用同一个缓冲区。从Begin到Finish之间不能挂起协程，
+  // 帧须在下一次使用ThreadLocal之前发出
+  static ApiFrame &ThreadLocal() {
+    thread_local ApiFrame frame;
+    return frame;
+  }
+
+ public:
+  ApiFrame &Begin(const std::string_view &action);
+
+  template <typename T>
+  ApiFrame &Param(const std::string_view &key, const T &value);
+
+  std::string_view Action() const noexcept {
+    return {buf_.data() + kActionPos, action_size_};
+  }
+
+  // Finish之前的内容，即动作与全部参数，用作请求的标识
+  std::string_view Identity() const noexcept { return buf_; }
+
+  // 结束整个帧并返回，echo为0时不带echo
+  const std::string &Finish(const uint64_t echo = 0);
+
+  // 追加json字符串(含两侧引号)
+  static void AppendString(std::string &out, const std::string_view &str);
+
+ private:
+  static constexpr std::string_view kHead = R"({"action":")";
+  static constexpr std::size_t kActionPos = kHead.size();
+  // 发过大图片后不长期占用内存
+  static constexpr std::size_t kMaxRetained = 1 << 20;
+
+  void AppendKey(const std::string_view &key);
+
+  template <typename T>
+  void AppendNumber(const T value);
+
+ private:
+  std::string buf_;
+  std::size_t action_size_ = 0;
+  bool has_param_ = false;
+};
+
+inline ApiFrame &ApiFrame::Begin(const std::string_view &action) {
+  if (buf_.capacity() > kMaxRetained) std::string().swap(buf_);
+  buf_.clear();
+  buf_.append(kHead);
+  // action均为代码中的字面量，不需要转义
+  buf_.append(action);
+  buf_.append(R"(","params":{)");
+  action_size_ = action.size();
+  has_param_ = false;
+  return *this;
+}
+
+inline void ApiFrame::AppendKey(const std::string_view &key) {
+  if (has_param_) buf_.push_back(',');
+  has_param_ = true;
+  buf_.push_back('"');
+  buf_.append(key);
+  buf_.append("\":");
+}
+
+template <typename T>
+inline void ApiFrame::AppendNumber(const T value) {
+  char digits[24];
+  auto [ptr, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+  buf_.append(digits, ptr);
+}
+
+template <typename T>
+inline ApiFrame &ApiFrame::Param(const std::string_view &key, const T &value) {
+  AppendKey(key);
+  if constexpr (std::is_same_v<T, bool>) {
+    buf_.append(value ? "true" : "false");
+  } else if constexpr (std::is_integral_v<T>) {
+    // uint8_t等字符类型也按数字写出
+    if constexpr (std::is_signed_v<T>)
+      AppendNumber(static_cast<int64_t>(value));
+    else
+      AppendNumber(static_cast<uint64_t>(value));
+  } else {
+    static_assert(std::is_convertible_v<const T &, std::string_view>,
+                  "不支持的api参数类型");
+    AppendString(buf_, value);
+  }
+  return *this;
+}
+
+inline const std::string &ApiFrame::Finish(const uint64_t echo) {
+  buf_.push_back('}');
+  if (echo) {
+    buf_.append(R"(,"echo":)");
+    AppendNumber(echo);
+  }
+  buf_.push_back('}');
+  return buf_;
+}
+
+inline void ApiFrame::AppendString(std::string &out,
+                                   const std::string_view &str) {
+  static constexpr char kHex[] = "0123456789abcdef";
+  out.reserve(out.size() + str.size() + 2);
+  out.push_back('"');
+  std::size_t start = 0;
+  for (std::size_t i = 0; i < str.size(); ++i) {
+    const auto ch = static_cast<unsigned char>(str[i]);
+    if (ch >= 0x20 && ch != '"' && ch != '\\') continue;
+    out.append(str.data() + start, i - start);
+    start = i + 1;
+    switch (ch) {
+      case '"':
+        out.append("\\\"");
+        break;
+      case '\\':
+        out.append("\\\\");
+        break;
+      case '\n':
+        out.append("\\n");
+        break;
+      case '\r':
+        out.append("\\r");
+        break;
+      case '\t':
+        out.append("\\t");
+        break;
+      case '\b':
+        out.append("\\b");
+        break;
+      case '\f':
+        out.append("\\f");
+        break;
+      default:
+        out.append("\\u00");
+        out.push_back(kHex[ch >> 4]);
+        out.push_back(kHex[ch & 0xf]);
+    }
+  }
+  out.append(str.data() + start, str.size() - start);
+  out.push_back('"');
+}
+
+}  // namespace onebot11
+}  // namespace white
+
+#endif
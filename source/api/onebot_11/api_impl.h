@@ -3,10 +3,12 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 
 #include <nlohmann/json.hpp>
 #include <utility>
 
+#include "api/onebot_11/api_frame.h"
 #include "type.h"
 
 namespace white {
@@ -16,268 +18,273 @@ using Event = Json;
 
 namespace api_impl {
 
-template <typename Action>
-inline Json CallApi(Action &&action, Json &&params) {
-  return Json{{"action", std::forward<Action>(action)},
-              {"params", std::move(params)}};
+// 以下函数都写入当前线程的ApiFrame并返回它，由ApiBot补上echo后发出
+
+inline ApiFrame &CallApi(const std::string_view &action) {
+  return ApiFrame::ThreadLocal().Begin(action);
 }
 
 template <typename Str>
-inline Json send_private_msg(QId user_id, Str &&message, bool auto_escape) {
-  return CallApi("send_private_msg",
-                 Json{
-                     {"user_id", user_id},
-                     {"message", std::forward<Str>(message)},
-                     {"auto_escape", auto_escape},
-                 });
+inline ApiFrame &send_private_msg(QId user_id, const Str &message,
+                                  bool auto_escape) {
+  return CallApi("send_private_msg")
+      .Param("user_id", user_id)
+      .Param("message", message)
+      .Param("auto_escape", auto_escape);
 }
 
 template <typename Str>
-inline Json send_group_msg(QId group_id, Str &&message, bool auto_escape) {
-  return CallApi("send_group_msg", Json{
-                                       {"group_id", group_id},
-                                       {"message", std::forward<Str>(message)},
-                                       {"auto_escape", auto_escape},
-                                   });
+inline ApiFrame &send_group_msg(QId group_id, const Str &message,
+                                bool auto_escape) {
+  return CallApi("send_group_msg")
+      .Param("group_id", group_id)
+      .Param("message", message)
+      .Param("auto_escape", auto_escape);
 }
 
 template <typename Type, typename Str, typename ID>
-inline Json send_msg(Type &&type, Str &&message, ID &&id,
-                     bool auto_escape = false) {
-  if (type == "group")
-    return CallApi("send_msg", Json{{"message_type", std::forward<Type>(type)},
-                                    {"group_id", std::forward<ID>(id)},
-                                    {"message", std::forward<Str>(message)},
-                                    {"auto_escape", auto_escape}});
-  return CallApi("send_msg", Json{{"message_type", std::forward<Type>(type)},
-                                  {"user_id", std::forward<ID>(id)},
-                                  {"message", std::forward<Str>(message)},
-                                  {"auto_escape", auto_escape}});
+inline ApiFrame &send_msg(const Type &type, const Str &message, const ID &id,
+                          bool auto_escape = false) {
+  std::string_view message_type{type};
+  return CallApi("send_msg")
+      .Param("message_type", message_type)
+      .Param(message_type == "group" ? "group_id" : "user_id", id)
+      .Param("message", message)
+      .Param("auto_escape", auto_escape);
 }
 
-inline Json delete_msg(const MsgId msg_id) {
-  return CallApi("delete_msg", Json{{"message_id", msg_id}});
+inline ApiFrame &delete_msg(const MsgId msg_id) {
+  return CallApi("delete_msg").Param("message_id", msg_id);
 }
 
-inline Json get_msg(const MsgId msg_id) {
-  return CallApi("get_msg", Json{
-                                {"message_id", msg_id},
-                            });
+inline ApiFrame &get_msg(const MsgId msg_id) {
+  return CallApi("get_msg").Param("message_id", msg_id);
 }
 
 template <typename Str>
-inline Json get_forward_msg(Str &&id) {
-  return CallApi("get_forward_msg", Json{{"id", std::forward<Str>(id)}});
+inline ApiFrame &get_forward_msg(const Str &id) {
+  return CallApi("get_forward_msg").Param("id", id);
 }
 
-inline Json send_like(const QId qid, uint8_t time) {
-  return CallApi("send_like", Json{{"user_id", qid}, {"time", time}});
+inline ApiFrame &send_like(const QId qid, uint8_t time) {
+  return CallApi("send_like").Param("user_id", qid).Param("time", time);
 }
 
 template <typename Str>
-inline Json set_group_kick(const GId gid, const QId uid, Str &message,
-                           bool reject_add_request) {
-  return CallApi("set_group_kick",
-                 Json{{"group_id", gid},
-                      {"user_id", uid},
-                      {"message", std::forward<Str>(message)},
-                      {"reject_add_request", reject_add_request}});
+inline ApiFrame &set_group_kick(const GId gid, const QId uid,
+                                const Str &message, bool reject_add_request) {
+  return CallApi("set_group_kick")
+      .Param("group_id", gid)
+      .Param("user_id", uid)
+      .Param("message", message)
+      .Param("reject_add_request", reject_add_request);
 }
 
-inline Json set_group_ban(const GId gid, const QId qid, uint32_t duration) {
-  return CallApi(
-      "set_group_ban",
-      Json{{"group_id", gid}, {"user_id", qid}, {"duration", duration}});
+inline ApiFrame &set_group_ban(const GId gid, const QId qid,
+                               uint32_t duration) {
+  return CallApi("set_group_ban")
+      .Param("group_id", gid)
+      .Param("user_id", qid)
+      .Param("duration", duration);
 }
 
 template <typename Str>
-inline Json set_group_anonymous_ban(const GId gid, int32_t duration,
-                                    Str &&anonymous_flag) {
-  return CallApi("set_group_anonymous_ban",
-                 Json{{"group_id", gid},
-                      {"anonymous_flag", std::forward<Str>(anonymous_flag)},
-                      {"duration", duration}});
+inline ApiFrame &set_group_anonymous_ban(const GId gid, int32_t duration,
+                                         const Str &anonymous_flag) {
+  return CallApi("set_group_anonymous_ban")
+      .Param("group_id", gid)
+      .Param("anonymous_flag", anonymous_flag)
+      .Param("duration", duration);
 }
 
-inline Json set_group_whole_ban(const GId gid, bool enable) {
-  return CallApi("set_group_whole_ban",
-                 Json{{"group_id", gid}, {"enable", enable}});
+inline ApiFrame &set_group_whole_ban(const GId gid, bool enable) {
+  return CallApi("set_group_whole_ban")
+      .Param("group_id", gid)
+      .Param("enable", enable);
 }
 
-inline Json set_group_admin(const GId gid, const QId qid, bool enable) {
-  return CallApi("set_group_admin",
-                 Json{{"group_id", gid}, {"user_id", qid}, {"enable", enable}});
+inline ApiFrame &set_group_admin(const GId gid, const QId qid, bool enable) {
+  return CallApi("set_group_admin")
+      .Param("group_id", gid)
+      .Param("user_id", qid)
+      .Param("enable", enable);
 }
 
-inline Json set_group_anonymous(const GId gid, bool enable) {
-  return CallApi("set_group_anonymous",
-                 Json{{"group_id", gid}, {"enable", enable}});
+inline ApiFrame &set_group_anonymous(const GId gid, bool enable) {
+  return CallApi("set_group_anonymous")
+      .Param("group_id", gid)
+      .Param("enable", enable);
 }
 
 template <typename Str>
-inline Json set_group_card(const GId gid, const QId qid, Str &&card) {
-  return CallApi("set_group_card", Json{{"group_id", gid},
-                                        {"user_id", qid},
-                                        {"card", std::forward<Str>(card)}});
+inline ApiFrame &set_group_card(const GId gid, const QId qid,
+                                const Str &card) {
+  return CallApi("set_group_card")
+      .Param("group_id", gid)
+      .Param("user_id", qid)
+      .Param("card", card);
 }
 
 template <typename Str>
-inline Json set_group_name(const GId gid, Str &&name) {
-  return CallApi("set_group_name",
-                 Json{{"group_id", gid}, {"name", std::forward<Str>(name)}});
+inline ApiFrame &set_group_name(const GId gid, const Str &name) {
+  return CallApi("set_group_name").Param("group_id", gid).Param("name", name);
 }
 
-inline Json set_group_leave(const GId gid, bool is_dismiss = false) {
-  return CallApi("set_group_leave",
-                 Json{{"group_id", gid}, {"is_dismiss", is_dismiss}});
+inline ApiFrame &set_group_leave(const GId gid, bool is_dismiss = false) {
+  return CallApi("set_group_leave")
+      .Param("group_id", gid)
+      .Param("is_dismiss", is_dismiss);
 }
 
 template <typename Str>
-inline Json set_group_special_title(const GId gid, const QId qid,
-                                    Str &&special_title) {
-  return CallApi("set_group_special_title",
-                 Json{{"group_id", gid},
-                      {"user_id", qid},
-                      {"special_title", std::forward<Str>(special_title)}});
+inline ApiFrame &set_group_special_title(const GId gid, const QId qid,
+                                         const Str &special_title) {
+  return CallApi("set_group_special_title")
+      .Param("group_id", gid)
+      .Param("user_id", qid)
+      .Param("special_title", special_title);
 }
 
 template <typename Str>
-inline Json set_friend_add_request(Str &&flag, bool approve) {
-  return CallApi("set_friend_add_request",
-                 Json{{"flag", std::forward<Str>(flag)}, {"approve", approve}});
+inline ApiFrame &set_friend_add_request(const Str &flag, bool approve) {
+  return CallApi("set_friend_add_request")
+      .Param("flag", flag)
+      .Param("approve", approve);
 }
 
 template <typename Str, typename SubType, typename Reason>
-inline Json set_group_add_request(Str &&flag, SubType &&sub_type,
-                                  Reason &&reason, bool approve) {
-  return CallApi("set_group_add_request",
-                 Json{{"flag", std::forward<Str>(flag)},
-                      {"sub_type", std::forward<SubType>(sub_type)},
-                      {"reason", std::forward<Reason>(reason)},
-                      {"approve", approve}});
+inline ApiFrame &set_group_add_request(const Str &flag, const SubType &sub_type,
+                                       const Reason &reason, bool approve) {
+  return CallApi("set_group_add_request")
+      .Param("flag", flag)
+      .Param("sub_type", sub_type)
+      .Param("reason", reason)
+      .Param("approve", approve);
 }
 
-inline Json get_login_info() { return CallApi("get_login_info", Json{}); }
+inline ApiFrame &get_login_info() { return CallApi("get_login_info"); }
 
-inline Json get_stranger_info(QId qid) {
-  return CallApi("get_stranger_info", Json{{"user_id", qid}});
+inline ApiFrame &get_stranger_info(QId qid, bool no_cache) {
+  return CallApi("get_stranger_info")
+      .Param("user_id", qid)
+      .Param("no_cache", no_cache);
 }
 
-inline Json get_friend_list() { return CallApi("get_friend_list", Json{}); }
+inline ApiFrame &get_friend_list() { return CallApi("get_friend_list"); }
 
-inline Json get_group_info(GId gid, bool no_cache) {
-  return CallApi("get_group_info", Json{
-                                       {"group_id", gid},
-                                       {"no_cache", no_cache},
-                                   });
+inline ApiFrame &get_group_info(GId gid, bool no_cache) {
+  return CallApi("get_group_info")
+      .Param("group_id", gid)
+      .Param("no_cache", no_cache);
 }
 
-inline Json get_group_list(bool no_cache) {
-  return CallApi("get_group_list", Json{{"no_cache", no_cache}});
+inline ApiFrame &get_group_list(bool no_cache) {
+  return CallApi("get_group_list").Param("no_cache", no_cache);
 }
 
-inline Json get_group_member_info(const GId gid, const QId uid, bool no_cache) {
-  return CallApi(
-      "get_group_member_info",
-      Json{{"group_id", gid}, {"user_id", uid}, {"no_cache", no_cache}});
+inline ApiFrame &get_group_member_info(const GId gid, const QId uid,
+                                       bool no_cache) {
+  return CallApi("get_group_member_info")
+      .Param("group_id", gid)
+      .Param("user_id", uid)
+      .Param("no_cache", no_cache);
 }
 
-inline Json get_group_member_list(const GId gid, bool no_cache) {
-  return CallApi("get_group_member_list",
-                 Json{{"group_id", gid}, {"no_cache", no_cache}});
+inline ApiFrame &get_group_member_list(const GId gid, bool no_cache) {
+  return CallApi("get_group_member_list")
+      .Param("group_id", gid)
+      .Param("no_cache", no_cache);
 }
 
 template <typename Str>
-inline Json get_group_honor_info(const GId gid, Str &&type) {
-  return CallApi("get_group_honor_info",
-                 Json{{"group_id", gid}, {"type", std::forward<Str>(type)}});
+inline ApiFrame &get_group_honor_info(const GId gid, const Str &type) {
+  return CallApi("get_group_honor_info")
+      .Param("group_id", gid)
+      .Param("type", type);
 }
 
 template <typename Str>
-inline Json get_cookies(Str &&domain) {
-  return CallApi("get_cookies", Json{
-                                    {"domain", std::forward<Str>(domain)},
-                                });
+inline ApiFrame &get_cookies(const Str &domain) {
+  return CallApi("get_cookies").Param("domain", domain);
 }
 
-inline Json get_csrf_token() { return CallApi("get_csrf_token", Json{}); }
+inline ApiFrame &get_csrf_token() { return CallApi("get_csrf_token"); }
 
 template <typename Str>
-inline Json get_credentials(Str &&domain) {
-  return CallApi("get_credentials", Json{
-                                        {"domain", std::forward<Str>(domain)},
-                                    });
+inline ApiFrame &get_credentials(const Str &domain) {
+  return CallApi("get_credentials").Param("domain", domain);
 }
 
 template <typename File, typename Str>
-inline Json get_record(File &&file, Str &&out_format) {
-  return CallApi("get_record",
-                 Json{{"file", std::forward<File>(file)},
-                      {"out_format", std::forward<Str>(out_format)}});
+inline ApiFrame &get_record(const File &file, const Str &out_format) {
+  return CallApi("get_record")
+      .Param("file", file)
+      .Param("out_format", out_format);
 }
 
 template <typename Str>
-inline Json get_image(Str &&file) {
-  return CallApi("get_image", Json{{"file", std::forward<Str>(file)}});
+inline ApiFrame &get_image(const Str &file) {
+  return CallApi("get_image").Param("file", file);
 }
 
-inline Json can_send_image() { return CallApi("can_send_image", Json{}); }
+inline ApiFrame &can_send_image() { return CallApi("can_send_image"); }
 
-inline Json can_send_record() { return CallApi("can_send_record", Json{}); }
+inline ApiFrame &can_send_record() { return CallApi("can_send_record"); }
 
-inline Json get_status() { return CallApi("get_status", Json{}); }
+inline ApiFrame &get_status() { return CallApi("get_status"); }
 
-inline Json get_version_info() { return CallApi("get_version_info", Json{}); }
+inline ApiFrame &get_version_info() { return CallApi("get_version_info"); }
 
-inline Json set_restart(int delay) {
-  return CallApi("set_restart", Json{{"delay", delay}});
+inline ApiFrame &set_restart(int delay) {
+  return CallApi("set_restart").Param("delay", delay);
 }
 
-inline Json clean_cache() { return CallApi("clean_cache", Json{}); }
+inline ApiFrame &clean_cache() { return CallApi("clean_cache"); }
 
 // go-cqhttp
 template <typename Str>
-inline Json get_word_slices(Str &&content) {
-  return CallApi(".get_word_slices",
-                 Json{{"content", std::forward<Str>(content)}});
+inline ApiFrame &get_word_slices(const Str &content) {
+  return CallApi(".get_word_slices").Param("content", content);
 }
 
 template <typename Str>
-inline Json ocr_image(Str &&image) {
-  return CallApi(".ocr_image", Json{{"image", std::forward<Str>(image)}});
+inline ApiFrame &ocr_image(const Str &image) {
+  return CallApi(".ocr_image").Param("image", image);
 }
 
 template <typename Str>
-inline Json get_model_show(Str &&model) {
-  return CallApi("_get_model_show", Json{{"model", std::forward<Str>(model)}});
+inline ApiFrame &get_model_show(const Str &model) {
+  return CallApi("_get_model_show").Param("model", model);
 }
 
-inline Json get_vip_info(const QId qid) {
-  return CallApi("_get_vip_info", {{"user_id", qid}});
+inline ApiFrame &get_vip_info(const QId qid) {
+  return CallApi("_get_vip_info").Param("user_id", qid);
 }
 
 template <typename Str, typename ImgStr>
-inline Json send_group_notice(const GId gid, Str &&content, ImgStr &&image) {
-  return CallApi("_send_group_notice",
-                 Json{{"group_id", gid},
-                      {"content", std::forward<Str>(content)},
-                      {"image", std::forward<ImgStr>(image)}});
+inline ApiFrame &send_group_notice(const GId gid, const Str &content,
+                                   const ImgStr &image) {
+  return CallApi("_send_group_notice")
+      .Param("group_id", gid)
+      .Param("content", content)
+      .Param("image", image);
 }
 
 template <typename ModelStr, typename ShowStr>
-inline Json set_model_show(ModelStr &&model, ShowStr &&model_show) {
-  return CallApi("_set_model_show",
-                 {{"model", std::forward<ModelStr>(model)},
-                  {"model_show", std::forward<ShowStr>(model_show)}});
+inline ApiFrame &set_model_show(const ModelStr &model,
+                                const ShowStr &model_show) {
+  return CallApi("_set_model_show")
+      .Param("model", model)
+      .Param("model_show", model_show);
 }
 
 template <typename Str>
-inline Json check_url_safely(Str &&url) {
-  return CallApi("check_url_safely", Json{{"url", std::forward<Str>(url)}});
+inline ApiFrame &check_url_safely(const Str &url) {
+  return CallApi("check_url_safely").Param("url", url);
 }
 
 }  // namespace api_impl
 }  // namespace onebot11
 }  // namespace white
 
-#endif
\ No newline at end of file
+#endif
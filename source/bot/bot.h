@@ -13,11 +13,14 @@
 
 #include <nlohmann/json.hpp>
 #include <hv/WebSocketServer.h>
-#include <oneapi/tbb/concurrent_unordered_map.h>
 
+#include "bot/event_queue.h"
 #include "bot/onebot_11/api_bot.h"
+#include "bot/onebot_11/echo_registry.h"
 #include "closure.h"
 #include "event/event.h"
+#include "event/decoded_event.h"
+#include "event/event_view.h"
 #include "event/event_handler.h"
 #include "global_config.h"
 #include "version.h"
@@ -27,6 +30,8 @@ namespace white {
 
 class Bot : public std::enable_shared_from_this<Bot> {
  public:
+  static constexpr uint32 kEchoSweepIntervalMs = 1000;
+
   Bot();
   ~Bot();
 
@@ -37,27 +42,41 @@ class Bot : public std::enable_shared_from_this<Bot> {
  private:
   void OnRun();
 
-  void Process(const std::string &message) noexcept;
+  void Process(std::string &&message, bool shed_all_msg = false) noexcept;
+
+  void Notify(const std::string &msg);
 
-  void Notify(std::string &&msg);
+  bool EventProcess(EventView &event) noexcept;
 
-  bool EventProcess(const Event &event) noexcept;
+  // 只依赖回调表，连接关闭后仍在排队的响应协程也可以安全执行
+  static void CompleteResponse(onebot11::EchoRegistry &registry,
+                               std::string &&message) noexcept;
+
+  static void CompleteResponse(onebot11::EchoRegistry &registry,
+                               EventView &event) noexcept;
 
  private:
   WebSocketChannelPtr channel_;
-  tbb::concurrent_unordered_map<std::time_t, std::function<void(const Json &)>>
-      echo_function_;
+  std::shared_ptr<onebot11::EchoRegistry> echo_registry_;
   onebot11::ApiBot api_bot_;
+  EventQueue queue_;
   std::list<onebot11::ApiBot *>::const_iterator botset_it_;
   EventHandler &handler_;
 };
 
 inline Bot::Bot()
-    : api_bot_([this](std::string &&msg) { Notify(std::move(msg)); },
-               echo_function_),
+    : echo_registry_(std::make_shared<onebot11::EchoRegistry>()),
+      api_bot_([this](const std::string &msg) { Notify(msg); },
+               echo_registry_),
+      queue_(config::EVENT_QUEUE_SIZE, config::EVENT_WORKERS),
       handler_(EventHandler::GetInstance()) {}
 
-inline Bot::~Bot() { BotSet::GetInstance().RemoveBot(botset_it_); }
+inline Bot::~Bot() {
+  queue_.Stop();
+  // 连接已断开，唤醒所有还在等待响应的协程
+  echo_registry_->Clear();
+  BotSet::GetInstance().RemoveBot(botset_it_);
+}
 
 inline void Bot::Run(const WebSocketChannelPtr &channel) noexcept {
   channel_ = channel;
@@ -65,50 +84,94 @@ inline void Bot::Run(const WebSocketChannelPtr &channel) noexcept {
 }
 
 inline void Bot::OnRun() {
+  queue_.Start([this](std::string &&msg, bool shed_all_msg) {
+    Process(std::move(msg), shed_all_msg);
+  });
+  // 定期清理对端始终没有回应的echo，连接断开后随回调表一起结束
+  go([weak_registry = std::weak_ptr(echo_registry_)] {
+    while (true) {
+      co::sleep(kEchoSweepIntervalMs);
+      auto registry = weak_registry.lock();
+      if (!registry) return;
+      registry->Sweep();
+    }
+  });
   botset_it_ = BotSet::GetInstance().AddBot(&api_bot_);
   for (auto superuser : config::SUPERUSERS)
     api_bot_.send_private_msg(
         superuser, fmt::format("MigangBot已启动\n版本: {}", kMigangBotVersion));
 }
 
-inline void Bot::OnRead(const std::string &msg) noexcept { Process(msg); }
+// api响应直接处理，以免等待中的协程被积压的事件拖住。
+// 协程可能在Bot析构之后才执行，只持有回调表而不持有this
+inline void Bot::OnRead(const std::string &msg) noexcept {
+  auto kind = frame::PeekKind(msg);
+  if (kind == FrameKind::kResponse) {
+    go([registry = echo_registry_, frame = msg]() mutable {
+      CompleteResponse(*registry, std::move(frame));
+    });
+    return;
+  }
+  queue_.Push(std::string(msg), kind);
+}
 
-inline void Bot::Notify(std::string &&msg) {
+inline void Bot::Notify(const std::string &msg) {
   LOG_DEBUG("Msg To sent: {}", msg);
-  channel_->send(std::move(msg));
+  channel_->send(msg);
 }
 
-inline void Bot::Process(const std::string &message) noexcept {
+inline void Bot::Process(std::string &&message, bool shed_all_msg) noexcept {
+  EventView event(std::move(message));
+  if (!event.Valid()) {
+    LOG_ERROR("无法解析的消息: {}", event.Raw());
+    return;
+  }
   try {
-    auto msg = Json::parse(message);
-    if (EventProcess(msg)) handler_.Handle(msg, api_bot_);
+    if (!EventProcess(event)) return;
+    DecodedEvent decoded(event);
+    handler_.Handle(decoded, api_bot_, shed_all_msg);
   } catch (Json::exception &e) {
     LOG_ERROR("Exception: {}", e.what());
   }
 }
 
-inline bool Bot::EventProcess(const Event &event) noexcept {
-  if (event.contains("retcode")) {
-    std::time_t echo_code = 0;
-    if (event.contains("echo")) echo_code = event["echo"].get<std::time_t>();
-    if (echo_function_.count(echo_code)) {
-      echo_function_.at(echo_code)(event["data"]);
-      echo_function_.unsafe_erase(echo_code);
-    }
+inline void Bot::CompleteResponse(onebot11::EchoRegistry &registry,
+                                  std::string &&message) noexcept {
+  EventView event(std::move(message));
+  if (!event.Valid()) {
+    LOG_ERROR("无法解析的消息: {}", event.Raw());
+    return;
+  }
+  CompleteResponse(registry, event);
+}
+
+// api响应只取出echo和data的原始文本，不构造Json
+inline void Bot::CompleteResponse(onebot11::EchoRegistry &registry,
+                                  EventView &event) noexcept {
+  // retcode为0(ok)或1(async)时视为成功
+  auto retcode = event.GetNumber<int>("retcode");
+  registry.Complete(event.GetNumber<uint64_t>("echo"),
+                    retcode == 0 || retcode == 1 ? onebot11::ApiStatus::kOk
+                                                 : onebot11::ApiStatus::kFailed,
+                    event.Raw("data"));
+}
+
+inline bool Bot::EventProcess(EventView &event) noexcept {
+  if (event.Contains("retcode")) {
+    CompleteResponse(*echo_registry_, event);
     return false;
-  } else if (event.contains("message")) {
-    QId user_id = event["user_id"].get<QId>();
-    if (event.contains("group_id")) {
-      GId group_id = event["group_id"].get<GId>();
+  } else if (event.Contains("message")) {
+    QId user_id = event.GetNumber<QId>("user_id");
+    if (event.Contains("group_id")) {
+      GId group_id = event.GetNumber<GId>("group_id");
       if (api_bot_.IsNeedMessage(group_id, user_id))
-        api_bot_.FeedMessage(group_id, user_id,
-                             event["message"].get<std::string>());
+        api_bot_.FeedMessage(group_id, user_id, std::string(event.Message()));
     } else {
       if (api_bot_.IsNeedMessage(0, user_id))
-        api_bot_.FeedMessage(0, user_id, event["message"].get<std::string>());
+        api_bot_.FeedMessage(0, user_id, std::string(event.Message()));
     }
     if (api_bot_.IsSomeOneNeedMessage(user_id))
-      api_bot_.FeedMessageTo(user_id, event["message"].get<std::string>());
+      api_bot_.FeedMessageTo(user_id, std::string(event.Message()));
   }
   return true;
 }
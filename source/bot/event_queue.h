@@ -0,0 +1,213 @@
+#ifndef MIGANGBOT_BOT_EVENT_QUEUE_H_
+#define MIGANGBOT_BOT_EVENT_QUEUE_H_
+
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <co/co.h>
+
+#include "logger/logger.h"
+#include "metrics/metrics.h"
+#include "type.h"
+
+namespace white {
+
+// 过载时按 心跳 -> 全消息处理 -> 事件本身 的顺序丢弃，api响应从不进入队列
+enum class FrameKind { kResponse, kHeartbeat, kEvent };
+
+namespace frame {
+
+// 只在原始帧上做子串查找，消息正文里的引号会被转义，不会误判
+inline FrameKind PeekKind(const std::string_view &frame) noexcept {
+  if (frame.find("\"post_type\"") == std::string_view::npos)
+    return frame.find("\"retcode\"") != std::string_view::npos
+               ? FrameKind::kResponse
+               : FrameKind::kEvent;
+  if (frame.find("\"heartbeat\"") != std::string_view::npos &&
+      frame.find("\"meta_event\"") != std::string_view::npos)
+    return FrameKind::kHeartbeat;
+  return FrameKind::kEvent;
+}
+
+inline uint64_t PeekId(const std::string_view &frame,
+                       const std::string_view &key) noexcept {
+  auto pos = frame.find(key);
+  if (pos == std::string_view::npos) return 0;
+  pos += key.size();
+  while (pos < frame.size() && (frame[pos] == ' ' || frame[pos] == ':')) ++pos;
+  uint64_t id = 0;
+  while (pos < frame.size() && std::isdigit(frame[pos]))
+    id = id * 10 + (frame[pos++] - '0');
+  return id;
+}
+
+// 同一个群(私聊则同一个人)的事件总是落到同一条通道上，以保证分发顺序
+inline uint64_t PeekOrderKey(const std::string_view &frame) noexcept {
+  auto group_id = PeekId(frame, "\"group_id\"");
+  if (group_id) return group_id;
+  return PeekId(frame, "\"user_id\"");
+}
+
+}  // namespace frame
+
+// 每条通道由一个协程按入队顺序取出事件并交给handler。
+// 顺序保证只到分发为止：同一order key的事件按到达顺序完成匹配并提交给服务，
+// 但服务在隔离舱的协程中执行，前一个事件的服务挂起(等待api响应、
+// WaitForNextMessage等)后，后一个事件的服务可能先执行完毕。
+// 通道不等待服务结束，否则等待下一条消息的服务会阻塞自己所在的群
+class EventQueue {
+ public:
+  // shed_all_msg为true时，该事件不再分发给全消息处理服务
+  using Handler = std::function<void(std::string &&, bool)>;
+
+  EventQueue(const std::size_t capacity, const std::size_t workers);
+  ~EventQueue() { Stop(); }
+
+ public:
+  void Start(Handler &&handler);
+
+  // 返回false表示帧因过载被丢弃
+  bool Push(std::string &&frame, const FrameKind kind);
+
+  void Stop();
+
+  std::size_t Depth() const noexcept {
+    return depth_.load(std::memory_order_relaxed);
+  }
+
+ public:
+  EventQueue(const EventQueue &) = delete;
+  EventQueue &operator=(const EventQueue &) = delete;
+
+ private:
+  struct Item {
+    std::string frame;
+    bool shed_all_msg;
+  };
+
+  struct Lane {
+    std::mutex mutex;
+    std::deque<Item> items;
+    co::Event event;
+  };
+
+  void Work(Lane &lane);
+
+ private:
+  const std::size_t capacity_;
+  const std::size_t heartbeat_watermark_;
+  const std::size_t shed_watermark_;
+
+  std::vector<std::unique_ptr<Lane>> lanes_;
+  Handler handler_;
+
+  std::atomic<std::size_t> depth_;
+  std::atomic<bool> running_;
+  std::atomic<bool> stop_;
+  co::WaitGroup wg_;
+
+  metrics::Metric &depth_metric_;
+  metrics::Metric &enqueued_;
+  metrics::Metric &dropped_heartbeat_;
+  metrics::Metric &shed_all_msg_;
+  metrics::Metric &dropped_;
+};
+
+inline EventQueue::EventQueue(const std::size_t capacity,
+                              const std::size_t workers)
+    : capacity_(capacity),
+      heartbeat_watermark_(capacity / 2),
+      shed_watermark_(capacity - capacity / 4),
+      depth_(0),
+      running_(false),
+      stop_(false),
+      depth_metric_(metrics::GetMetric("event_queue.depth")),
+      enqueued_(metrics::GetMetric("event_queue.enqueued")),
+      dropped_heartbeat_(metrics::GetMetric("event_queue.dropped_heartbeat")),
+      shed_all_msg_(metrics::GetMetric("event_queue.shed_all_msg")),
+      dropped_(metrics::GetMetric("event_queue.dropped")) {
+  for (std::size_t i = 0; i < workers; ++i)
+    lanes_.push_back(std::make_unique<Lane>());
+}
+
+inline void EventQueue::Start(Handler &&handler) {
+  if (running_.exchange(true)) return;
+  handler_ = std::move(handler);
+  wg_.add(lanes_.size());
+  for (auto &lane : lanes_) go([this, &lane = *lane] { Work(lane); });
+}
+
+inline bool EventQueue::Push(std::string &&frame, const FrameKind kind) {
+  if (stop_.load(std::memory_order_acquire)) return false;
+  auto depth = depth_.load(std::memory_order_relaxed);
+  if (kind == FrameKind::kHeartbeat && depth >= heartbeat_watermark_) {
+    dropped_heartbeat_.Add();
+    return false;
+  }
+  if (depth >= capacity_) {
+    dropped_.Add();
+    LOG_DEBUG("事件队列已满({})，丢弃事件", depth);
+    return false;
+  }
+  bool shed_all_msg = depth >= shed_watermark_;
+  if (shed_all_msg) shed_all_msg_.Add();
+
+  auto &lane = *lanes_[frame::PeekOrderKey(frame) % lanes_.size()];
+  {
+    std::lock_guard<std::mutex> locker(lane.mutex);
+    lane.items.push_back({std::move(frame), shed_all_msg});
+  }
+  depth_.fetch_add(1, std::memory_order_relaxed);
+  depth_metric_.Add();
+  enqueued_.Add();
+  lane.event.signal();
+  return true;
+}
+
+inline void EventQueue::Work(Lane &lane) {
+  Item item;
+  while (!stop_.load(std::memory_order_acquire)) {
+    {
+      std::unique_lock<std::mutex> locker(lane.mutex);
+      if (lane.items.empty()) {
+        locker.unlock();
+        lane.event.wait(1000);
+        continue;
+      }
+      item = std::move(lane.items.front());
+      lane.items.pop_front();
+    }
+    depth_.fetch_sub(1, std::memory_order_relaxed);
+    depth_metric_.Sub();
+    handler_(std::move(item.frame), item.shed_all_msg);
+  }
+  wg_.done();
+}
+
+inline void EventQueue::Stop() {
+  if (stop_.exchange(true, std::memory_order_acq_rel)) return;
+  std::size_t left = 0;
+  for (auto &lane : lanes_) {
+    {
+      std::lock_guard<std::mutex> locker(lane->mutex);
+      left += lane->items.size();
+      lane->items.clear();
+    }
+    lane->event.signal();
+  }
+  depth_metric_.Sub(left);
+  if (running_.load()) wg_.wait();
+}
+
+}  // namespace white
+
+#endif
@@ -6,29 +6,39 @@
 #include <exception>
 #include <functional>
 #include <future>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <queue>
-#include <random>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 
 #include <co/co.h>
-#include <oneapi/tbb/concurrent_unordered_map.h>
 
+#include "api/onebot_11/api_frame.h"
 #include "api/onebot_11/api_impl.h"
+#include "bot/onebot_11/echo_registry.h"
 #include "bot/onebot_11/future_wrapper.h"
 #include "bot/onebot_11/desired_value.h"
+#include "bot/onebot_11/info_cache.h"
 #include "event/event.h"
 #include "logger/logger.h"
+#include "message/cq_code.h"
+#include "metrics/metrics.h"
 #include "type.h"
 #include "closure.h"
+#include "co_task.h"
+#include "tools/single_flight.h"
 
 namespace white {
 namespace onebot11 {
 
 class ApiBot;
 
-using ClosureForPlugin = Closure<const Event &, onebot11::ApiBot &>;
+// 第三个参数在插件执行期间保持存活，用于服务的并发限制
+using ClosureForPlugin =
+    Closure<const Event &, onebot11::ApiBot &, std::shared_ptr<void>>;
 
 template <typename F>
 class FunctionForPlugin : public ClosureForPlugin {
@@ -36,44 +46,121 @@ class FunctionForPlugin : public ClosureForPlugin {
   FunctionForPlugin(F &&func) : func_(std::forward<F>(func)) {}
   virtual ~FunctionForPlugin() = default;
 
-  virtual void Run(const Event &event, onebot11::ApiBot &bot) const {
-    func_(event, bot);
+  virtual void Run(const Event &event, onebot11::ApiBot &bot,
+                   std::shared_ptr<void> guard) const {
+    using Result = std::invoke_result_t<F &, const Event &, ApiBot &>;
+    if constexpr (IsTask<Result>::value)
+      Hold(func_, event, bot, std::move(guard)).Detach();
+    else
+      func_(event, bot);
+  }
+
+ private:
+  // 插件返回Task时，事件在第一次挂起后就会被释放，这里复制一份存在协程帧里，
+  // guard也随协程帧一直持有到Task结束
+  static Task<> Hold(const std::remove_reference_t<F> &func, Event event,
+                     onebot11::ApiBot &bot, std::shared_ptr<void> guard) {
+    co_await func(event, bot);
   }
 
  private:
   std::remove_reference_t<F> func_;
 };
 
+// 未解码的响应，data为响应中data字段的原始文本
+struct RawResponse {
+  ApiStatus status = ApiStatus::kCancelled;
+  std::string data;
+};
+
+// 不缓存响应的动作使用的空回调
+struct NoStore {
+  template <typename T>
+  void operator()(const T &) const noexcept {}
+};
+
+// 各动作等待响应的期限，发送消息应很快得到回应，列表类的接口可能较慢
+inline int64_t ActionTimeoutMs(const std::string_view &action) noexcept {
+  if (action.starts_with("send_")) return 15000;
+  if (action.ends_with("_list")) return 60000;
+  return 30000;
+}
+
+// 每个动作的计数，latency_us为成功响应的耗时之和
+struct ApiMetrics {
+  metrics::Metric &ok;
+  metrics::Metric &failed;
+  metrics::Metric &timeout;
+  metrics::Metric &latency_us;
+
+  static ApiMetrics &Of(const std::string_view &action) {
+    static std::mutex mutex;
+    static std::map<std::string, std::unique_ptr<ApiMetrics>, std::less<>> all;
+    std::lock_guard<std::mutex> locker(mutex);
+    auto it = all.find(action);
+    if (it == all.end()) it = all.emplace(action, nullptr).first;
+    auto &ret = it->second;
+    if (!ret) {
+      auto prefix = fmt::format("api.{}", action);
+      ret.reset(new ApiMetrics{metrics::GetMetric(prefix + ".ok"),
+                               metrics::GetMetric(prefix + ".failed"),
+                               metrics::GetMetric(prefix + ".timeout"),
+                               metrics::GetMetric(prefix + ".latency_us")});
+    }
+    return *ret;
+  }
+
+  void Record(const ApiStatus status,
+              const std::chrono::steady_clock::time_point start) noexcept {
+    switch (status) {
+      case ApiStatus::kOk:
+        ok.Add();
+        latency_us.Add(std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count());
+        break;
+      case ApiStatus::kFailed:
+        failed.Add();
+        break;
+      case ApiStatus::kTimeout:
+        timeout.Add();
+        break;
+      case ApiStatus::kCancelled:
+        break;
+    }
+  }
+};
+
 class ApiBot {
  public:
   template <typename Str>
-  CoFutureWrapper<MessageID> send_private_msg(const QId user_id, Str &&message,
-                                              bool auto_escape = false);
+  ApiFuture<MessageID> send_private_msg(const QId user_id, Str &&message,
+                                        bool auto_escape = false);
 
   template <typename Str>
-  CoFutureWrapper<MessageID> send_group_msg(const GId group_id, Str &&message,
-                                            bool auto_escape = false);
+  ApiFuture<MessageID> send_group_msg(const GId group_id, Str &&message,
+                                      bool auto_escape = false);
 
   template <typename Type, typename Str, typename ID>
-  CoFutureWrapper<MessageID> send_msg(Type &&type, Str &&message, ID &&id,
-                                      bool auto_escape = false);
+  ApiFuture<MessageID> send_msg(Type &&type, Str &&message, ID &&id,
+                                bool auto_escape = false);
 
   template <typename Str>
-  CoFutureWrapper<MessageID> send(const Event &event, Str &&message,
-                                  bool at_sender = false,
-                                  bool auto_escape = false);
+  ApiFuture<MessageID> send(const Event &event, Str &&message,
+                            bool at_sender = false, bool auto_escape = false);
 
-  CoFutureWrapper<GroupInfo> get_group_info(const GId group_id,
-                                            bool no_cache = false);
+  // 以下get_*与进行中的相同请求共享响应(见SendShared)，群信息相关的先查缓存。
+  // Cancel只让本调用方不再等待，不会取消其他调用方仍在等待的请求
+  ApiFuture<GroupInfo> get_group_info(const GId group_id,
+                                      bool no_cache = false);
 
-  CoFutureWrapper<std::vector<GroupInfo>> get_group_list(bool no_cache = false);
+  ApiFuture<std::vector<GroupInfo>> get_group_list(bool no_cache = false);
 
-  CoFutureWrapper<GroupMemberInfo> get_group_member_info(const GId gid,
-                                                         const QId uid,
-                                                         bool no_cache = false);
+  ApiFuture<GroupMemberInfo> get_group_member_info(const GId gid, const QId uid,
+                                                   bool no_cache = false);
 
-  CoFutureWrapper<UserInfo> get_stranger_info(const QId user_id,
-                                              bool no_cache = false);
+  ApiFuture<UserInfo> get_stranger_info(const QId user_id,
+                                        bool no_cache = false);
 
   void delete_msg(const MsgId msg_id);
 
@@ -85,17 +172,37 @@ class ApiBot {
   void set_group_leave(const GId group_id, bool is_dismiss = false);
 
   template <typename Ret, typename JsonData>
-  CoFutureWrapper<Ret> SendRaw(JsonData &&data) {
-    auto ret = Echo<Ret>(data);
+  ApiFuture<Ret> SendRaw(JsonData &&data) {
+    uint64_t echo_code = 0;
+    auto ret = Echo<Ret>(data["action"].template get_ref<const std::string &>(),
+                         &echo_code);
+    if (echo_code) data["echo"] = echo_code;
     notify_->Run(data.dump());
     return ret;
-  };
+  }
+
+  void SendRaw(const Json &data) { notify_->Run(data.dump()); }
 
-  void SendRaw(Json &&data) { notify_->Run(data.dump()); };
+  void SendRaw(const std::string &str) { notify_->Run(str); }
+
+  // 发出api_impl写好的帧，echo直接追加在帧尾；
+  // 成功解析出响应后以其调用store，用于写入缓存
+  template <typename Ret, typename Store = NoStore>
+  ApiFuture<Ret> SendFrame(ApiFrame &frame, Store &&store = {}) {
+    uint64_t echo_code = 0;
+    auto ret =
+        Echo<Ret>(frame.Action(), &echo_code, std::forward<Store>(store));
+    notify_->Run(frame.Finish(echo_code));
+    return ret;
+  }
 
-  void SendRaw(Json &data) { notify_->Run(data.dump()); };
+  void SendFrame(ApiFrame &frame) { notify_->Run(frame.Finish()); }
 
-  void SendRaw(std::string &&str) { notify_->Run(std::move(str)); };
+  // 只读动作使用：与进行中的相同请求(动作与参数都相同)共享同一个响应，
+  // 各调用方分别解码。共享的请求没有属于单个调用方的echo：Cancel只让本调用方
+  // 不再等待，请求由期限统一回收；后加入的调用方最迟在发起者的期限得到结果
+  template <typename Ret, typename Store = NoStore>
+  ApiFuture<Ret> SendShared(ApiFrame &frame, Store &&store = {});
 
  public:
   std::string WaitForNextMessage(const Event &event);
@@ -106,6 +213,9 @@ class ApiBot {
 
   bool IsNeedMessage(GId group_id, QId user_id) const;
 
+  // 群列表、群信息与群成员信息的缓存，由EventHandler按通知失效
+  InfoCache &Cache() noexcept { return *info_cache_; }
+
   template <typename Str>
   void FeedMessageTo(QId user_id, Str &&message);
 
@@ -114,27 +224,28 @@ class ApiBot {
 
  public:
   template <typename Notify>
-  ApiBot(Notify &&notify,
-         tbb::concurrent_unordered_map<
-             std::time_t, std::function<void(const Json &)>> &echo_function)
+  ApiBot(Notify &&notify, std::shared_ptr<EchoRegistry> echo_registry)
       : notify_(new FunctionForNotify(std::forward<Notify>(notify))),
-        echo_function_(echo_function),
-        u_(-10000, 10000) {}
+        echo_registry_(std::move(echo_registry)),
+        info_cache_(std::make_shared<InfoCache>()),
+        flight_("api") {}
 
   ~ApiBot() { delete notify_; }
 
  private:
-  template <typename T>
-  void EchoFunction(const std::weak_ptr<co_promise<T>> &weak_p,
-                    const Json &value) const;
+  template <typename T, typename Store>
+  static void EchoFunction(
+      const std::weak_ptr<co_promise<ApiResult<T>>> &weak_p,
+      const ApiStatus status, const std::string_view &data, const Store &store);
 
-  template <typename F>
-  inline void SetEchoFunction(const std::time_t echo_code, F &&func) {
-    echo_function_[echo_code] = std::forward<F>(func);
-  }
+  // 注册等待响应的回调，echo_code为0表示注册失败，此时返回的future已失败
+  template <typename T, typename Store = NoStore>
+  ApiFuture<T> Echo(const std::string_view &action, uint64_t *echo_code,
+                    Store &&store = {});
 
+  // 命中缓存时直接返回已完成的ApiFuture
   template <typename T>
-  CoFutureWrapper<T> Echo(Json &msg);
+  static ApiFuture<T> Ready(const std::string_view &action, T &&value);
 
  private:
   template <bool Is_Approve, typename Str>
@@ -142,11 +253,10 @@ class ApiBot {
 
  private:
   const ClosureNotify *const notify_;
-  tbb::concurrent_unordered_map<std::time_t, std::function<void(const Json &)>>
-      &echo_function_;
-
-  std::mt19937 random_engine_;
-  std::uniform_int_distribution<std::time_t> u_;
+  const std::shared_ptr<EchoRegistry> echo_registry_;
+  // 响应回调中持有，ApiBot析构后仍可安全写入
+  const std::shared_ptr<InfoCache> info_cache_;
+  SingleFlight<RawResponse> flight_;
 
   std::unordered_map<
       GId, std::unordered_map<
@@ -232,80 +342,124 @@ inline void ApiBot::FeedMessage(GId group_id, QId user_id, Str &&message) {
     someone_group_message_.erase(group_id);
 }
 
-template <typename T>
-inline void ApiBot::EchoFunction(const std::weak_ptr<co_promise<T>> &weak_p,
-                                 const Json &value) const {
+template <typename T, typename Store>
+inline void ApiBot::EchoFunction(
+    const std::weak_ptr<co_promise<ApiResult<T>>> &weak_p,
+    const ApiStatus status, const std::string_view &data, const Store &store) {
   auto shared_p = weak_p.lock();
   if (!shared_p) return;
-  try {
-    if (value.is_null()) {
-      shared_p->set_value(DefaultValue<T>());
-      return;
+  ApiResult<T> result{status};
+  if (status == ApiStatus::kOk && !data.empty() && data != "null") {
+    if (DecodeValue(data, result.value)) {
+      store(result.value);
+    } else {
+      LOG_ERROR("无法解析的api响应: {}", data);
+      result = {ApiStatus::kFailed};
     }
-    shared_p->set_value(DesiredValue<T>(value));
-  } catch (const std::exception &e) {
-    LOG_ERROR("Exception In EchoFunction: {}", e.what());
   }
+  shared_p->set_value(std::move(result));
 }
 
 template <typename T>
-inline CoFutureWrapper<T> ApiBot::Echo(Json &msg) {
-  static auto timestamp_micro = []() {
-    return std::chrono::time_point_cast<std::chrono::microseconds>(
-               std::chrono::high_resolution_clock::now())
-        .time_since_epoch()
-        .count();
-  };
-  std::time_t echo_code =
-      timestamp_micro() +
-      u_(random_engine_) *
-          10000;  // 用纳秒会导致接受的和发送的不一致，姑且用微秒吧
-  msg["echo"] = echo_code;  // 多线程下降低冲突的可能性，加个随机数
-  auto promise = std::make_shared<co_promise<T>>();
-  SetEchoFunction(echo_code,
-                  [this, weak_p = std::weak_ptr(promise)](const Json &value) {
-                    EchoFunction(weak_p, value);
-                  });
-  return CoFutureWrapper{std::move(promise)};
+inline ApiFuture<T> ApiBot::Ready(const std::string_view &action, T &&value) {
+  auto promise = std::make_shared<co_promise<ApiResult<T>>>();
+  promise->set_value({ApiStatus::kOk, std::move(value)});
+  return ApiFuture<T>{std::move(promise), {}, EchoRegistry::NowMs(),
+                      ApiMetrics::Of(action).timeout};
+}
+
+template <typename T, typename Store>
+inline ApiFuture<T> ApiBot::Echo(const std::string_view &action,
+                                 uint64_t *echo_code, Store &&store) {
+  auto &metrics = ApiMetrics::Of(action);
+  auto deadline_ms = EchoRegistry::NowMs() + ActionTimeoutMs(action);
+  auto promise = std::make_shared<co_promise<ApiResult<T>>>();
+  *echo_code = echo_registry_->Register(
+      [weak_p = std::weak_ptr(promise), &metrics,
+       start = std::chrono::steady_clock::now(),
+       store = std::forward<Store>(store)](const ApiStatus status,
+                                           const std::string_view &data) {
+        metrics.Record(status, start);
+        EchoFunction(weak_p, status, data, store);
+      },
+      deadline_ms);
+  if (!*echo_code) {
+    LOG_ERROR("等待响应的api请求过多，echo槽位已满");
+    promise->set_value({ApiStatus::kFailed});
+    return ApiFuture<T>{std::move(promise), {}, deadline_ms, metrics.timeout};
+  }
+  return ApiFuture<T>{std::move(promise),
+                      EchoTicket(echo_registry_, *echo_code), deadline_ms,
+                      metrics.timeout};
+}
+
+template <typename Ret, typename Store>
+inline ApiFuture<Ret> ApiBot::SendShared(ApiFrame &frame, Store &&store) {
+  auto &metrics = ApiMetrics::Of(frame.Action());
+  auto deadline_ms = EchoRegistry::NowMs() + ActionTimeoutMs(frame.Action());
+  auto raw = flight_.Do(std::string(frame.Identity()), [&] {
+    auto promise = std::make_shared<co_promise<RawResponse>>();
+    auto ret = promise->get_future();
+    // 期限到达时Sweep以kTimeout完成，共享的请求总会结束
+    auto echo_code = echo_registry_->Register(
+        [promise, &metrics, start = std::chrono::steady_clock::now()](
+            const ApiStatus status, const std::string_view &data) {
+          metrics.Record(status, start);
+          promise->set_value({status, std::string(data)});
+        },
+        deadline_ms);
+    if (!echo_code) {
+      // 与Echo相同，注册失败时不发出请求
+      LOG_ERROR("等待响应的api请求过多，echo槽位已满");
+      promise->set_value({ApiStatus::kFailed});
+      return ret;
+    }
+    notify_->Run(frame.Finish(echo_code));
+    return ret;
+  });
+  auto promise = std::make_shared<co_promise<ApiResult<Ret>>>();
+  std::move(raw).on_value([weak_p = std::weak_ptr(promise),
+                           store = std::forward<Store>(store)](
+                              RawResponse &&response) {
+    EchoFunction(weak_p, response.status, response.data, store);
+  });
+  return ApiFuture<Ret>{std::move(promise), {}, deadline_ms, metrics.timeout};
 }
 
 template <typename Str>
-inline CoFutureWrapper<MessageID> ApiBot::send_private_msg(
+inline ApiFuture<MessageID> ApiBot::send_private_msg(
     const uint64_t user_id, Str &&message, bool auto_escape) {
-  Json msg = api_impl::send_private_msg(user_id, std::forward<Str>(message),
-                                        auto_escape);
-  return SendRaw<MessageID>(msg);
+  auto &frame = api_impl::send_private_msg(user_id, message, auto_escape);
+  return SendFrame<MessageID>(frame);
 }
 
 template <typename Str>
-inline CoFutureWrapper<MessageID> ApiBot::send_group_msg(const GId group_id,
-                                                         Str &&message,
-                                                         bool auto_escape) {
-  Json msg = api_impl::send_group_msg(group_id, std::forward<Str>(message),
-                                      auto_escape);
-  return SendRaw<MessageID>(msg);
+inline ApiFuture<MessageID> ApiBot::send_group_msg(const GId group_id,
+                                                   Str &&message,
+                                                   bool auto_escape) {
+  auto &frame = api_impl::send_group_msg(group_id, message, auto_escape);
+  return SendFrame<MessageID>(frame);
 }
 
 template <typename Type, typename Str, typename ID>
-inline CoFutureWrapper<MessageID> ApiBot::send_msg(Type &&type, Str &&message,
-                                                   ID &&id, bool auto_escape) {
-  Json msg =
-      api_impl::send_msg(std::forward<Type>(type), std::forward<Str>(message),
-                         std::forward<ID>(id), auto_escape);
-  return SendRaw<MessageID>(msg);
+inline ApiFuture<MessageID> ApiBot::send_msg(Type &&type, Str &&message,
+                                             ID &&id, bool auto_escape) {
+  auto &frame = api_impl::send_msg(type, message, id, auto_escape);
+  return SendFrame<MessageID>(frame);
 }
 
 template <typename Str>
-inline CoFutureWrapper<MessageID> ApiBot::send(const Event &event,
-                                               Str &&message, bool at_sender,
-                                               bool auto_escape) {
-  Json msg;
+inline ApiFuture<MessageID> ApiBot::send(const Event &event, Str &&message,
+                                         bool at_sender, bool auto_escape) {
   if (event.value("message_type", "private") == "group") {
     if (at_sender)
       return send_group_msg(
           event["group_id"].get<GId>(),
-          fmt::format("[CQ:at,qq={}] {}", event["user_id"].get<QId>(),
-                      std::forward<Str>(message)),
+          message::Builder()
+              .At(event["user_id"].get<QId>())
+              .Raw(" ")
+              .Raw(message)
+              .Build(),
           auto_escape);
     else
       return send_group_msg(event["group_id"].get<GId>(),
@@ -315,33 +469,53 @@ inline CoFutureWrapper<MessageID> ApiBot::send(const Event &event,
                           std::forward<Str>(message));
 }
 
-inline CoFutureWrapper<GroupInfo> ApiBot::get_group_info(const GId group_id,
-                                                         bool no_cache) {
-  Json msg = api_impl::get_group_info(group_id, no_cache);
-  return SendRaw<GroupInfo>(msg);
+inline ApiFuture<GroupInfo> ApiBot::get_group_info(const GId group_id,
+                                                   bool no_cache) {
+  if (!no_cache)
+    if (auto info = info_cache_->GetGroupInfo(group_id))
+      return Ready("get_group_info", std::move(*info));
+  auto &frame = api_impl::get_group_info(group_id, no_cache);
+  return SendShared<GroupInfo>(
+      frame, [cache = info_cache_, generation = info_cache_->Generation()](
+                 const GroupInfo &info) {
+        cache->PutGroupInfo(info, generation);
+      });
 }
 
-inline CoFutureWrapper<std::vector<GroupInfo>> ApiBot::get_group_list(
+inline ApiFuture<std::vector<GroupInfo>> ApiBot::get_group_list(
     bool no_cache) {
-  Json msg = api_impl::get_group_list(no_cache);
-  return SendRaw<std::vector<GroupInfo>>(msg);
+  if (!no_cache)
+    if (auto groups = info_cache_->GetGroupList())
+      return Ready("get_group_list", std::move(*groups));
+  auto &frame = api_impl::get_group_list(no_cache);
+  return SendShared<std::vector<GroupInfo>>(
+      frame, [cache = info_cache_, generation = info_cache_->Generation()](
+                 const std::vector<GroupInfo> &groups) {
+        cache->PutGroupList(groups, generation);
+      });
 }
 
-inline CoFutureWrapper<GroupMemberInfo> ApiBot::get_group_member_info(
+inline ApiFuture<GroupMemberInfo> ApiBot::get_group_member_info(
     const GId gid, const QId uid, bool no_cache) {
-  auto msg = api_impl::get_group_member_info(gid, uid, no_cache);
-  return SendRaw<GroupMemberInfo>(msg);
+  if (!no_cache)
+    if (auto info = info_cache_->GetMemberInfo(gid, uid))
+      return Ready("get_group_member_info", std::move(*info));
+  auto &frame = api_impl::get_group_member_info(gid, uid, no_cache);
+  return SendShared<GroupMemberInfo>(
+      frame, [cache = info_cache_, generation = info_cache_->Generation()](
+                 const GroupMemberInfo &info) {
+        cache->PutMemberInfo(info, generation);
+      });
 }
 
-inline CoFutureWrapper<UserInfo> ApiBot::get_stranger_info(const QId user_id,
-                                                           bool no_cache) {
-  auto msg = api_impl::get_stranger_info(user_id);
-  return SendRaw<UserInfo>(msg);
+inline ApiFuture<UserInfo> ApiBot::get_stranger_info(const QId user_id,
+                                                     bool no_cache) {
+  auto &frame = api_impl::get_stranger_info(user_id, no_cache);
+  return SendShared<UserInfo>(frame);
 }
 
 inline void ApiBot::delete_msg(MsgId msg_id) {
-  Json msg = api_impl::delete_msg(msg_id);
-  SendRaw(msg);
+  SendFrame(api_impl::delete_msg(msg_id));
 }
 
 template <bool Is_Approve, typename Str>
@@ -349,13 +523,11 @@ inline void ApiBot::HandleAddRequestImpl(const Event &event, Str &&reason) {
   auto flag = event["flag"].get<std::string>();
   auto request_type = event["request_type"].get<std::string>();
   if (request_type == "friend") {
-    auto msg = api_impl::set_friend_add_request(flag, Is_Approve);
-    SendRaw(msg);
+    SendFrame(api_impl::set_friend_add_request(flag, Is_Approve));
   } else if (request_type == "group" &&
              event["sub_type"].get<std::string>() == "invite") {
-    auto msg = api_impl::set_group_add_request(
-        flag, "invite", std::forward<Str>(reason), Is_Approve);
-    SendRaw(msg);
+    SendFrame(
+        api_impl::set_group_add_request(flag, "invite", reason, Is_Approve));
   }
 }
 
@@ -369,8 +541,7 @@ inline void ApiBot::approve(const Event &event) {
 }
 
 inline void ApiBot::set_group_leave(const GId group_id, bool is_dismiss) {
-  auto msg = api_impl::set_group_leave(group_id, is_dismiss);
-  SendRaw(msg);
+  SendFrame(api_impl::set_group_leave(group_id, is_dismiss));
 }
 
 }  // namespace onebot11
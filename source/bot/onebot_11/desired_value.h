@@ -1,49 +1,249 @@
 #ifndef MIGANGBOT_BOT_ONEBOT_11_DESIRED_VALUE_H_
 #define MIGANGBOT_BOT_ONEBOT_11_DESIRED_VALUE_H_
 
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <limits>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
+#include "event/event_view.h"
 #include "type.h"
 
 namespace white {
 namespace onebot11 {
+
+// api响应中data部分的类型化解码。按T在编译期选出字段表，
+// 顺序扫描一遍原始文本，遇到表中的键就直接写入对应成员，
+// 不构造Json；未知的键整体跳过，缺少的字段保持默认值
+
+namespace decode_detail {
+
+template <typename T, typename M>
+struct Field {
+  std::string_view key;
+  M T::*member;
+};
+
+template <typename T, typename M>
+constexpr Field<T, M> MakeField(const std::string_view key, M T::*member) {
+  return {key, member};
+}
+
+}  // namespace decode_detail
+
+// 每个可解码的结构体的字段表
+template <typename T>
+struct Schema;
+
+template <>
+struct Schema<MessageID> {
+  static constexpr auto fields = std::make_tuple(
+      decode_detail::MakeField("message_id", &MessageID::message_id));
+};
+
+template <>
+struct Schema<GroupInfo> {
+  static constexpr auto fields = std::make_tuple(
+      decode_detail::MakeField("group_id", &GroupInfo::group_id),
+      decode_detail::MakeField("group_name", &GroupInfo::group_name),
+      decode_detail::MakeField("member_count", &GroupInfo::member_count),
+      decode_detail::MakeField("max_member_count",
+                               &GroupInfo::max_member_count));
+};
+
+template <>
+struct Schema<UserInfo> {
+  static constexpr auto fields = std::make_tuple(
+      decode_detail::MakeField("user_id", &UserInfo::user_id),
+      decode_detail::MakeField("nickname", &UserInfo::nickname),
+      decode_detail::MakeField("sex", &UserInfo::sex),
+      decode_detail::MakeField("age", &UserInfo::age));
+};
+
+template <>
+struct Schema<GroupMemberInfo> {
+  using M = GroupMemberInfo;
+  static constexpr auto fields = std::make_tuple(
+      decode_detail::MakeField("group_id", &M::group_id),
+      decode_detail::MakeField("user_id", &M::user_id),
+      decode_detail::MakeField("nickname", &M::nickname),
+      decode_detail::MakeField("card", &M::card),
+      decode_detail::MakeField("sex", &M::sex),
+      decode_detail::MakeField("age", &M::age),
+      decode_detail::MakeField("area", &M::area),
+      decode_detail::MakeField("join_time", &M::join_time),
+      decode_detail::MakeField("last_sent_time", &M::last_sent_time),
+      decode_detail::MakeField("level", &M::level),
+      decode_detail::MakeField("role", &M::role),
+      decode_detail::MakeField("unfriendly", &M::unfriendly),
+      decode_detail::MakeField("title", &M::title),
+      decode_detail::MakeField("title_expire_time", &M::title_expire_time),
+      decode_detail::MakeField("card_changeable", &M::card_changeable));
+};
+
+template <typename T>
+inline bool DecodeValue(const std::string_view &data, T &out);
+
+namespace decode_detail {
+
+template <typename T>
+struct IsVector : std::false_type {};
+
+template <typename T>
+struct IsVector<std::vector<T>> : std::true_type {};
+
+// 单个值，value为原始文本
+inline bool Assign(const std::string_view &value, std::string &out) {
+  if (value == "null") return true;
+  // 有的实现把level等字段写成数字，按原文保存
+  if (value.size() < 2 || value.front() != '"') {
+    out.assign(value);
+    return true;
+  }
+  auto content = value.substr(1, value.size() - 2);
+  if (content.find('\\') == std::string_view::npos)
+    out.assign(content);
+  else
+    out = json_scan::Unescape(content);
+  return true;
+}
+
+inline bool Assign(const std::string_view &value, bool &out) {
+  out = value == "true" || value == "1";
+  return true;
+}
+
+template <typename N>
+inline std::enable_if_t<std::is_arithmetic_v<N>, bool> Assign(
+    std::string_view value, N &out) {
+  // 有的实现把数字写成字符串
+  if (value.size() >= 2 && value.front() == '"')
+    value = value.substr(1, value.size() - 2);
+  if (value == "null") return true;
+  const auto begin = value.data(), end = value.data() + value.size();
+  if constexpr (std::is_integral_v<N>) {
+    N integer;
+    auto [ptr, ec] = std::from_chars(begin, end, integer);
+    if (ec == std::errc() && ptr == end) {
+      out = integer;
+      return true;
+    }
+    // 有的实现把整数写成1.0、1e3这样的浮点数，值为整数时照常接受；
+    // 有小数部分或超出范围时只跳过该字段，保持默认值
+    double real;
+    auto [real_ptr, real_ec] = std::from_chars(begin, end, real);
+    if (real_ptr != end) return false;
+    const double upper = std::ldexp(1.0, std::numeric_limits<N>::digits);
+    const double lower = std::is_signed_v<N> ? -upper : 0.0;
+    if (real_ec == std::errc() && std::trunc(real) == real && real >= lower &&
+        real < upper)
+      out = static_cast<N>(real);
+    return true;
+  } else {
+    auto [ptr, ec] = std::from_chars(begin, end, out);
+    return ec == std::errc() && ptr == end;
+  }
+}
+
+// 遍历对象的每个键值对，func返回false时停止并返回false
+template <typename Func>
+inline bool ForEachMember(const std::string_view &s, Func &&func) {
+  using namespace json_scan;
+  auto i = SkipSpace(s, 0);
+  if (i >= s.size() || s[i] != '{') return false;
+  i = SkipSpace(s, i + 1);
+  if (i < s.size() && s[i] == '}') return true;
+  while (i < s.size()) {
+    if (s[i] != '"') return false;
+    auto key_end = SkipString(s, i);
+    if (key_end == npos) return false;
+    auto key = s.substr(i + 1, key_end - i - 2);
+    i = SkipSpace(s, key_end);
+    if (i >= s.size() || s[i] != ':') return false;
+    i = SkipSpace(s, i + 1);
+    auto value_end = SkipValue(s, i);
+    if (value_end == npos) return false;
+    if (!func(key, s.substr(i, value_end - i))) return false;
+    i = SkipSpace(s, value_end);
+    if (i >= s.size()) return false;
+    if (s[i] == '}') return true;
+    if (s[i] != ',') return false;
+    i = SkipSpace(s, i + 1);
+  }
+  return false;
+}
+
+// 遍历数组的每个元素
+template <typename Func>
+inline bool ForEachElement(const std::string_view &s, Func &&func) {
+  using namespace json_scan;
+  auto i = SkipSpace(s, 0);
+  if (i >= s.size() || s[i] != '[') return false;
+  i = SkipSpace(s, i + 1);
+  if (i < s.size() && s[i] == ']') return true;
+  while (i < s.size()) {
+    auto value_end = SkipValue(s, i);
+    if (value_end == npos) return false;
+    if (!func(s.substr(i, value_end - i))) return false;
+    i = SkipSpace(s, value_end);
+    if (i >= s.size()) return false;
+    if (s[i] == ']') return true;
+    if (s[i] != ',') return false;
+    i = SkipSpace(s, i + 1);
+  }
+  return false;
+}
+
 template <typename T>
-inline T DesiredValue(const Json &value) {
-  if constexpr (std::is_same<T, MessageID>::value) {
-    return {value["message_id"].get<MsgId>()};
-  } else if constexpr (std::is_same<T, GroupInfo>::value) {
-    return {
-        value["group_id"].get<GId>(), value["group_name"].get<std::string>(),
-        value["member_count"].get<int>(), value["max_member_count"].get<int>()};
-  } else if constexpr (std::is_same<T, UserInfo>::value) {
-    return {value["user_id"].get<QId>(), value["nickname"].get<std::string>(),
-            value["sex"].get<std::string>(), value["age"].get<int32_t>()};
-  } else if constexpr (std::is_same<T, std::vector<GroupInfo>>::value) {
-    std::vector<GroupInfo> v;
-    for (std::size_t i = 0; i < value.size(); ++i)
-      v.push_back({value[i]["group_id"].get<GId>(),
-                   value[i]["group_name"].get<std::string>(),
-                   value[i]["member_count"].get<int>(),
-                   value[i]["max_member_count"].get<int>()});
-    return v;
-  } else if constexpr (std::is_same<T, GroupMemberInfo>::value)
-    return {value["group_id"].get<GId>(),
-            value["user_id"].get<QId>(),
-            value["nickname"].get<std::string>(),
-            value["card"].get<std::string>(),
-            value["sex"].get<std::string>(),
-            value["age"].get<int>(),
-            value["area"].get<std::string>(),
-            value["join_time"].get<int>(),
-            value["last_sent_time"].get<int>(),
-            value["level"].get<std::string>(),
-            value["role"].get<std::string>(),
-            value["unfriendly"].get<bool>(),
-            value["title"].get<std::string>(),
-            value["title_expire_time"].get<int>(),
-            value["card_changeable"].get<bool>()};
+inline bool DecodeObject(const std::string_view &data, T &out) {
+  return ForEachMember(data, [&out](const std::string_view &key,
+                                    const std::string_view &value) {
+    bool ok = true;
+    std::apply(
+        [&](const auto &...field) {
+          // 字段表中的键互不相同，至多命中一个
+          ((key == field.key ? (ok = Assign(value, out.*field.member), true)
+                             : false) ||
+           ...);
+        },
+        Schema<T>::fields);
+    return ok;
+  });
 }
+
+template <typename T>
+inline bool DecodeArray(const std::string_view &data, std::vector<T> &out) {
+  out.clear();
+  // 预估元素个数，避免大群列表反复扩容
+  std::size_t objects = 0;
+  for (auto ch : data) objects += ch == '{';
+  out.reserve(objects);
+  return ForEachElement(data, [&out](const std::string_view &value) {
+    out.emplace_back();
+    return DecodeValue(value, out.back());
+  });
+}
+
+}  // namespace decode_detail
+
+template <typename T>
+inline bool DecodeValue(const std::string_view &data, T &out) {
+  if constexpr (std::is_same_v<T, Json>) {
+    out = Json::parse(data, nullptr, false);
+    return !out.is_discarded();
+  } else if constexpr (decode_detail::IsVector<T>::value) {
+    return decode_detail::DecodeArray(data, out);
+  } else {
+    return decode_detail::DecodeObject(data, out);
+  }
+}
+
 }  // namespace onebot11
 }  // namespace white
 
-#endif
\ No newline at end of file
+#endif
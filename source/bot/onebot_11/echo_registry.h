@@ -0,0 +1,256 @@
+#ifndef MIGANGBOT_BOT_ONEBOT_11_ECHO_REGISTRY_H_
+#define MIGANGBOT_BOT_ONEBOT_11_ECHO_REGISTRY_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "metrics/metrics.h"
+
+namespace white {
+namespace onebot11 {
+
+enum class ApiStatus : uint8_t {
+  kOk,
+  // 对端返回了失败的retcode，或响应无法解析
+  kFailed,
+  // 超过该动作的期限仍未收到响应
+  kTimeout,
+  // 连接关闭或调用方不再等待
+  kCancelled
+};
+
+// data为响应中data字段的原始json文本
+using EchoCallback =
+    std::function<void(const ApiStatus, const std::string_view &)>;
+
+// 等待api响应的回调表。echo由递增的序号与槽位拼成：
+// [序号:33][槽位:16][分片:4]，不超过2^53以免在对端被当作浮点数损失精度。
+// 分片由序号决定，槽位直接索引分片内的slab，注册与完成都无需哈希；
+// 槽位中保存完整的echo，过期的响应不会命中被复用的槽位。
+// 每一项带有期限，Sweep定期以kTimeout移除已过期、无人回应的项
+class EchoRegistry {
+ public:
+  static constexpr uint64_t kShardBits = 4;
+  static constexpr uint64_t kSlotBits = 16;
+  static constexpr uint64_t kSeqBits = 33;
+
+  EchoRegistry() : pending_(metrics::GetMetric("echo.pending")) {}
+
+  ~EchoRegistry() { Clear(); }
+
+ public:
+  static int64_t NowMs() noexcept {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // deadline_ms为steady clock下的毫秒时刻，返回0表示该分片的槽位已满
+  uint64_t Register(EchoCallback &&callback, const int64_t deadline_ms);
+
+  // 取出并调用回调，echo未注册或已移除时返回false
+  bool Complete(const uint64_t echo, const ApiStatus status,
+                const std::string_view &data);
+
+  // 超时或不再等待时移除，不调用回调
+  bool Cancel(const uint64_t echo);
+
+  // 以kTimeout移除所有已过期的项，返回移除的个数
+  std::size_t Sweep(const int64_t now_ms = NowMs());
+
+  // 连接关闭时以kCancelled移除全部回调，唤醒等待者
+  void Clear();
+
+  std::size_t Size() const noexcept {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr uint64_t kShards = uint64_t{1} << kShardBits;
+  static constexpr uint64_t kMaxSlots = uint64_t{1} << kSlotBits;
+
+  struct Slot {
+    uint64_t echo = 0;
+    int64_t deadline_ms = 0;
+    EchoCallback callback;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free;
+  };
+
+  static Shard &ShardOf(std::array<Shard, kShards> &shards,
+                        const uint64_t echo) noexcept {
+    return shards[echo & (kShards - 1)];
+  }
+
+  static uint32_t SlotOf(const uint64_t echo) noexcept {
+    return (echo >> kShardBits) & (kMaxSlots - 1);
+  }
+
+  // 在锁内取出回调并释放槽位
+  bool Take(const uint64_t echo, EchoCallback *callback);
+
+  // 释放所有满足pred的槽位，回调以status在锁外执行
+  template <typename Pred>
+  std::size_t TakeAll(Pred &&pred, const ApiStatus status);
+
+ private:
+  std::atomic<uint64_t> seq_{0};
+  std::atomic<std::size_t> size_{0};
+  std::array<Shard, kShards> shards_;
+  metrics::Metric &pending_;
+};
+
+inline uint64_t EchoRegistry::Register(EchoCallback &&callback,
+                                       const int64_t deadline_ms) {
+  // 序号从1开始，echo不会为0
+  auto seq =
+      (seq_.fetch_add(1, std::memory_order_relaxed) + 1) &
+      ((uint64_t{1} << kSeqBits) - 1);
+  if (!seq) seq = 1;
+  auto &shard = shards_[seq & (kShards - 1)];
+  uint64_t echo;
+  {
+    std::lock_guard<std::mutex> locker(shard.mutex);
+    uint32_t slot;
+    if (!shard.free.empty()) {
+      slot = shard.free.back();
+      shard.free.pop_back();
+    } else if (shard.slots.size() < kMaxSlots) {
+      slot = shard.slots.size();
+      shard.slots.emplace_back();
+    } else {
+      return 0;
+    }
+    echo = (seq << (kSlotBits + kShardBits)) |
+           (uint64_t{slot} << kShardBits) | (seq & (kShards - 1));
+    shard.slots[slot].echo = echo;
+    shard.slots[slot].deadline_ms = deadline_ms;
+    shard.slots[slot].callback = std::move(callback);
+  }
+  size_.fetch_add(1, std::memory_order_relaxed);
+  pending_.Add();
+  return echo;
+}
+
+inline bool EchoRegistry::Take(const uint64_t echo, EchoCallback *callback) {
+  if (!echo) return false;
+  auto &shard = ShardOf(shards_, echo);
+  auto index = SlotOf(echo);
+  {
+    std::lock_guard<std::mutex> locker(shard.mutex);
+    if (index >= shard.slots.size() || shard.slots[index].echo != echo)
+      return false;
+    auto &slot = shard.slots[index];
+    if (callback) *callback = std::move(slot.callback);
+    slot.callback = nullptr;
+    slot.echo = 0;
+    shard.free.push_back(index);
+  }
+  size_.fetch_sub(1, std::memory_order_relaxed);
+  pending_.Sub();
+  return true;
+}
+
+inline bool EchoRegistry::Complete(const uint64_t echo,
+                                   const ApiStatus status,
+                                   const std::string_view &data) {
+  EchoCallback callback;
+  if (!Take(echo, &callback)) return false;
+  // 回调在锁外执行
+  if (callback) callback(status, data);
+  return true;
+}
+
+inline bool EchoRegistry::Cancel(const uint64_t echo) {
+  return Take(echo, nullptr);
+}
+
+template <typename Pred>
+inline std::size_t EchoRegistry::TakeAll(Pred &&pred, const ApiStatus status) {
+  std::vector<EchoCallback> callbacks;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> locker(shard.mutex);
+    for (uint32_t i = 0; i < shard.slots.size(); ++i) {
+      auto &slot = shard.slots[i];
+      if (!slot.echo || !pred(slot)) continue;
+      callbacks.push_back(std::move(slot.callback));
+      slot.callback = nullptr;
+      slot.echo = 0;
+      shard.free.push_back(i);
+    }
+  }
+  size_.fetch_sub(callbacks.size(), std::memory_order_relaxed);
+  pending_.Sub(callbacks.size());
+  for (auto &callback : callbacks)
+    if (callback) callback(status, "");
+  return callbacks.size();
+}
+
+inline std::size_t EchoRegistry::Sweep(const int64_t now_ms) {
+  return TakeAll(
+      [now_ms](const Slot &slot) { return slot.deadline_ms <= now_ms; },
+      ApiStatus::kTimeout);
+}
+
+inline void EchoRegistry::Clear() {
+  TakeAll([](const Slot &) { return true; }, ApiStatus::kCancelled);
+}
+
+// 持有一次注册，析构或超时时移除，保证回调表不会残留无人等待的项
+class EchoTicket {
+ public:
+  EchoTicket() = default;
+
+  EchoTicket(std::weak_ptr<EchoRegistry> registry, const uint64_t echo)
+      : registry_(std::move(registry)), echo_(echo) {}
+
+  EchoTicket(EchoTicket &&rhs) noexcept
+      : registry_(std::move(rhs.registry_)), echo_(rhs.echo_) {
+    rhs.echo_ = 0;
+  }
+
+  EchoTicket &operator=(EchoTicket &&rhs) noexcept {
+    if (&rhs != this) {
+      Release();
+      registry_ = std::move(rhs.registry_);
+      echo_ = rhs.echo_;
+      rhs.echo_ = 0;
+    }
+    return *this;
+  }
+
+  EchoTicket(const EchoTicket &) = delete;
+  EchoTicket &operator=(const EchoTicket &) = delete;
+
+  ~EchoTicket() { Release(); }
+
+  // 返回true表示确实移除了仍在等待的项
+  bool Release() {
+    if (!echo_) return false;
+    auto registry = registry_.lock();
+    auto removed = registry && registry->Cancel(echo_);
+    echo_ = 0;
+    return removed;
+  }
+
+ private:
+  std::weak_ptr<EchoRegistry> registry_;
+  uint64_t echo_ = 0;
+};
+
+}  // namespace onebot11
+}  // namespace white
+
+#endif
@@ -6,6 +6,8 @@
 #include "co_future.h"
 #include "type.h"
 #include "bot/onebot_11/default_value.h"
+#include "bot/onebot_11/echo_registry.h"
+#include "metrics/metrics.h"
 
 namespace white {
 namespace onebot11 {
@@ -57,6 +59,77 @@ class CoFutureWrapper {
   co_future<T> future_;
 };
 
+template <typename T>
+struct ApiResult {
+  ApiStatus status = ApiStatus::kCancelled;
+  // 非kOk时为DefaultValue
+  T value = DefaultValue<T>();
+
+  bool Ok() const noexcept { return status == ApiStatus::kOk; }
+
+  explicit operator bool() const noexcept { return Ok(); }
+
+  T &operator*() noexcept { return value; }
+  const T &operator*() const noexcept { return value; }
+  T *operator->() noexcept { return &value; }
+  const T *operator->() const noexcept { return &value; }
+};
+
+// ApiBot动作的返回值。Wait区分成功、失败、超时与取消，
+// 默认等到该动作的期限为止；get保持旧的语义，只返回值
+template <typename T>
+class ApiFuture {
+ public:
+  ApiFuture(std::shared_ptr<co_promise<ApiResult<T>>> &&p, EchoTicket &&ticket,
+            const int64_t deadline_ms, metrics::Metric &timeout_metric)
+      : promise_(std::move(p)),
+        future_(std::move(promise_->get_future())),
+        ticket_(std::move(ticket)),
+        deadline_ms_(deadline_ms),
+        timeout_metric_(timeout_metric) {}
+
+  ApiResult<T> Wait() {
+    auto remain = deadline_ms_ - EchoRegistry::NowMs();
+    return Wait(remain > 0 ? remain : 0);
+  }
+
+  ApiResult<T> Wait(uint32 ms) {
+    if (cancelled_ && !future_.ready()) return {ApiStatus::kCancelled};
+    if (future_.wait_for(ms) == co_future_status::timeout) {
+      // 超时后立即回收echo，之后到达的响应会被丢弃
+      if (ticket_.Release()) timeout_metric_.Add();
+      return {ApiStatus::kTimeout};
+    }
+    return future_.get();
+  }
+
+  T get() { return Wait().value; }
+
+  T get(uint32 ms) { return Wait(ms).value; }
+
+  // 不再等待响应，立即回收echo，之后的Wait不再阻塞，得到kCancelled。
+  // 与其他调用方共享的请求(见ApiBot::SendShared)没有自己的echo，
+  // 只是本调用方不再等待，请求本身继续，其他调用方不受影响
+  void Cancel() {
+    ticket_.Release();
+    cancelled_ = true;
+  }
+
+  // 在Task中co_await，期限由EchoRegistry::Sweep保证，超时得到kTimeout；
+  // ApiFuture本身需存活到恢复为止，直接co_await临时对象即可
+  co_future_awaiter<ApiResult<T>> operator co_await() && {
+    return co_future_awaiter<ApiResult<T>>(std::move(future_));
+  }
+
+ private:
+  std::shared_ptr<co_promise<ApiResult<T>>> promise_;
+  co_future<ApiResult<T>> future_;
+  EchoTicket ticket_;
+  int64_t deadline_ms_;
+  metrics::Metric &timeout_metric_;
+  bool cancelled_ = false;
+};
+
 }  // namespace onebot11
 }  // namespace white
 #endif
\ No newline at end of file
@@ -0,0 +1,292 @@
+#ifndef MIGANGBOT_BOT_ONEBOT_11_INFO_CACHE_H_
+#define MIGANGBOT_BOT_ONEBOT_11_INFO_CACHE_H_
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bot/onebot_11/echo_registry.h"
+#include "metrics/metrics.h"
+#include "type.h"
+
+namespace white {
+namespace onebot11 {
+
+// 每个bot的群列表、群信息与群成员信息缓存。
+// 各项按TTL过期，群成员变动、管理员变动、群名片变动等通知到达时立即失效；
+// 失效前已发出的请求，其响应不会再写回缓存，避免旧数据覆盖失效。
+// 失效按群(群信息、整群成员)与成员分别记录，其他群的请求不受影响
+class InfoCache {
+ public:
+  static constexpr int64_t kGroupListTtlMs = 5 * 60 * 1000;
+  static constexpr int64_t kGroupInfoTtlMs = 10 * 60 * 1000;
+  static constexpr int64_t kMemberInfoTtlMs = 5 * 60 * 1000;
+  // 成员信息的条目上限，超过时整体清空
+  static constexpr std::size_t kMaxMembers = 65536;
+  // 失效记录的上限，超过时清空记录，并拒绝此前发出的所有请求的写回
+  static constexpr std::size_t kMaxStamps = 4096;
+
+  InfoCache()
+      : group_list_hit_(metrics::GetMetric("api.cache.group_list.hit")),
+        group_list_miss_(metrics::GetMetric("api.cache.group_list.miss")),
+        group_info_hit_(metrics::GetMetric("api.cache.group_info.hit")),
+        group_info_miss_(metrics::GetMetric("api.cache.group_info.miss")),
+        member_info_hit_(metrics::GetMetric("api.cache.member_info.hit")),
+        member_info_miss_(metrics::GetMetric("api.cache.member_info.miss")) {}
+
+ public:
+  std::optional<std::vector<GroupInfo>> GetGroupList();
+
+  std::optional<GroupInfo> GetGroupInfo(const GId group_id);
+
+  std::optional<GroupMemberInfo> GetMemberInfo(const GId group_id,
+                                               const QId user_id);
+
+  // 请求发出时取得的代数，响应到达时只有对应的项在此之后未失效才写入
+  uint64_t Generation() const {
+    std::lock_guard<std::mutex> locker(mutex_);
+    return generation_;
+  }
+
+  void PutGroupList(const std::vector<GroupInfo> &groups,
+                    const uint64_t generation);
+
+  void PutGroupInfo(const GroupInfo &info, const uint64_t generation);
+
+  void PutMemberInfo(const GroupMemberInfo &info, const uint64_t generation);
+
+  // 按通知类型失效相关的项
+  void OnNotice(const std::string_view &notice_type,
+                const std::string_view &sub_type, const GId group_id,
+                const QId user_id, const QId self_id);
+
+  void Clear();
+
+ private:
+  template <typename T>
+  struct Entry {
+    T value;
+    int64_t expire_ms;
+  };
+
+  template <typename T>
+  static bool Fresh(const Entry<T> &entry, const int64_t now_ms) noexcept {
+    return entry.expire_ms > now_ms;
+  }
+
+  // 各群的失效代数，info对应群信息，members对应整群的成员信息
+  struct GroupStamp {
+    uint64_t info = 0;
+    uint64_t members = 0;
+  };
+
+  // 以下均需持有mutex_
+  void DropGroup(const GId group_id);
+
+  void DropMember(const GId group_id, const QId user_id);
+
+  // 代数为generation的请求发出后，对应的项是否已失效
+  bool GroupInfoStale(const GId group_id, const uint64_t generation) const;
+
+  bool MemberStale(const GId group_id, const QId user_id,
+                   const uint64_t generation) const;
+
+  // 推进代数并返回，作为本次失效的代数
+  uint64_t Stamp();
+
+ private:
+  mutable std::mutex mutex_;
+  uint64_t generation_ = 0;
+  // 代数小于floor_的请求一律不写回
+  uint64_t floor_ = 0;
+  uint64_t group_list_stamp_ = 0;
+  std::unordered_map<GId, GroupStamp> group_stamp_;
+  std::unordered_map<GId, std::unordered_map<QId, uint64_t>> member_stamp_;
+  std::size_t stamp_count_ = 0;
+
+  std::optional<Entry<std::vector<GroupInfo>>> group_list_;
+  std::unordered_map<GId, Entry<GroupInfo>> group_info_;
+  std::unordered_map<GId, std::unordered_map<QId, Entry<GroupMemberInfo>>>
+      member_info_;
+  std::size_t member_count_ = 0;
+
+  metrics::Metric &group_list_hit_;
+  metrics::Metric &group_list_miss_;
+  metrics::Metric &group_info_hit_;
+  metrics::Metric &group_info_miss_;
+  metrics::Metric &member_info_hit_;
+  metrics::Metric &member_info_miss_;
+};
+
+inline std::optional<std::vector<GroupInfo>> InfoCache::GetGroupList() {
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    if (group_list_ && Fresh(*group_list_, EchoRegistry::NowMs())) {
+      group_list_hit_.Add();
+      return group_list_->value;
+    }
+  }
+  group_list_miss_.Add();
+  return std::nullopt;
+}
+
+inline std::optional<GroupInfo> InfoCache::GetGroupInfo(const GId group_id) {
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    auto it = group_info_.find(group_id);
+    if (it != group_info_.end() && Fresh(it->second, EchoRegistry::NowMs())) {
+      group_info_hit_.Add();
+      return it->second.value;
+    }
+  }
+  group_info_miss_.Add();
+  return std::nullopt;
+}
+
+inline std::optional<GroupMemberInfo> InfoCache::GetMemberInfo(
+    const GId group_id, const QId user_id) {
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    auto group_it = member_info_.find(group_id);
+    if (group_it != member_info_.end()) {
+      auto it = group_it->second.find(user_id);
+      if (it != group_it->second.end() &&
+          Fresh(it->second, EchoRegistry::NowMs())) {
+        member_info_hit_.Add();
+        return it->second.value;
+      }
+    }
+  }
+  member_info_miss_.Add();
+  return std::nullopt;
+}
+
+inline void InfoCache::PutGroupList(const std::vector<GroupInfo> &groups,
+                                    const uint64_t generation) {
+  auto now_ms = EchoRegistry::NowMs();
+  std::lock_guard<std::mutex> locker(mutex_);
+  if (generation < floor_ || generation < group_list_stamp_) return;
+  group_list_ = {groups, now_ms + kGroupListTtlMs};
+  // 群列表中的每一项与get_group_info的结果相同，顺便填充
+  for (const auto &group : groups)
+    if (!GroupInfoStale(group.group_id, generation))
+      group_info_[group.group_id] = {group, now_ms + kGroupInfoTtlMs};
+}
+
+inline void InfoCache::PutGroupInfo(const GroupInfo &info,
+                                    const uint64_t generation) {
+  auto now_ms = EchoRegistry::NowMs();
+  std::lock_guard<std::mutex> locker(mutex_);
+  if (GroupInfoStale(info.group_id, generation)) return;
+  group_info_[info.group_id] = {info, now_ms + kGroupInfoTtlMs};
+}
+
+inline void InfoCache::PutMemberInfo(const GroupMemberInfo &info,
+                                     const uint64_t generation) {
+  auto now_ms = EchoRegistry::NowMs();
+  std::lock_guard<std::mutex> locker(mutex_);
+  if (MemberStale(info.group_id, info.user_id, generation)) return;
+  if (member_count_ >= kMaxMembers) {
+    member_info_.clear();
+    member_count_ = 0;
+  }
+  auto [it, inserted] = member_info_[info.group_id].insert_or_assign(
+      info.user_id, Entry<GroupMemberInfo>{info, now_ms + kMemberInfoTtlMs});
+  if (inserted) ++member_count_;
+}
+
+inline void InfoCache::OnNotice(const std::string_view &notice_type,
+                                const std::string_view &sub_type,
+                                const GId group_id, const QId user_id,
+                                const QId self_id) {
+  std::lock_guard<std::mutex> locker(mutex_);
+  if (notice_type == "group_increase" || notice_type == "group_decrease") {
+    // 人数变了，群列表与群信息都不再准确
+    group_list_stamp_ = Stamp();
+    group_list_.reset();
+    if (user_id == self_id || sub_type == "kick_me")
+      DropGroup(group_id);
+    else {
+      group_stamp_[group_id].info = group_list_stamp_;
+      group_info_.erase(group_id);
+      DropMember(group_id, user_id);
+    }
+  } else if (notice_type == "group_admin" || notice_type == "group_card") {
+    DropMember(group_id, user_id);
+  }
+}
+
+inline void InfoCache::Clear() {
+  std::lock_guard<std::mutex> locker(mutex_);
+  floor_ = ++generation_;
+  group_list_stamp_ = 0;
+  group_stamp_.clear();
+  member_stamp_.clear();
+  stamp_count_ = 0;
+  group_list_.reset();
+  group_info_.clear();
+  member_info_.clear();
+  member_count_ = 0;
+}
+
+inline void InfoCache::DropGroup(const GId group_id) {
+  auto generation = Stamp();
+  auto &stamp = group_stamp_[group_id];
+  stamp.info = stamp.members = generation;
+  group_info_.erase(group_id);
+  if (auto it = member_info_.find(group_id); it != member_info_.end()) {
+    member_count_ -= it->second.size();
+    member_info_.erase(it);
+  }
+}
+
+inline void InfoCache::DropMember(const GId group_id, const QId user_id) {
+  auto generation = Stamp();
+  auto [stamp, inserted] =
+      member_stamp_[group_id].insert_or_assign(user_id, generation);
+  if (inserted) ++stamp_count_;
+  auto it = member_info_.find(group_id);
+  if (it == member_info_.end()) return;
+  member_count_ -= it->second.erase(user_id);
+  if (it->second.empty()) member_info_.erase(it);
+}
+
+inline bool InfoCache::GroupInfoStale(const GId group_id,
+                                      const uint64_t generation) const {
+  if (generation < floor_) return true;
+  auto it = group_stamp_.find(group_id);
+  return it != group_stamp_.end() && generation < it->second.info;
+}
+
+inline bool InfoCache::MemberStale(const GId group_id, const QId user_id,
+                                   const uint64_t generation) const {
+  if (generation < floor_) return true;
+  if (auto it = group_stamp_.find(group_id);
+      it != group_stamp_.end() && generation < it->second.members)
+    return true;
+  auto group_it = member_stamp_.find(group_id);
+  if (group_it == member_stamp_.end()) return false;
+  auto it = group_it->second.find(user_id);
+  return it != group_it->second.end() && generation < it->second;
+}
+
+inline uint64_t InfoCache::Stamp() {
+  if (group_stamp_.size() + stamp_count_ >= kMaxStamps) {
+    // 记录过多时退化为整体失效：此前发出的请求都不再写回
+    floor_ = generation_ + 1;
+    group_list_stamp_ = 0;
+    group_stamp_.clear();
+    member_stamp_.clear();
+    stamp_count_ = 0;
+  }
+  return ++generation_;
+}
+
+}  // namespace onebot11
+}  // namespace white
+
+#endif
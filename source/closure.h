@@ -22,7 +22,8 @@ class Closure {
   virtual void Run(Params...) const = 0;
 };
 
-using ClosureNotify = Closure<std::string &&>;
+// 发送的内容在Run返回前已被复制，调用方可以复用缓冲区
+using ClosureNotify = Closure<const std::string &>;
 
 template <typename F>
 class FunctionForNotify : public ClosureNotify {
@@ -30,7 +31,7 @@ class FunctionForNotify : public ClosureNotify {
   FunctionForNotify(F &&func) : func_(std::forward<F>(func)) {}
   virtual ~FunctionForNotify() = default;
 
-  virtual void Run(std::string &&str) const { func_(std::move(str)); }
+  virtual void Run(const std::string &str) const { func_(str); }
 
  private:
   std::remove_reference_t<F> func_;
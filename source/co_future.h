@@ -2,7 +2,18 @@
 #define MIGANGBOT_CO_FUTURE_H_
 
 #include <co/co.h>
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
 
 namespace white {
 
@@ -18,7 +29,33 @@ struct shared_state {
   co::Event event_;
   T value_;
   bool is_complete_;
+  std::mutex mutex_;
+  // 完成时在set_value的线程上调用，供when_all/when_any组合使用
+  std::vector<std::function<void()>> callbacks_;
   shared_state(bool is_complete) : is_complete_(is_complete) {}
+
+  void complete() {
+    std::vector<std::function<void()>> callbacks;
+    {
+      std::lock_guard<std::mutex> locker(mutex_);
+      is_complete_ = true;
+      callbacks.swap(callbacks_);
+    }
+    event_.signal();
+    for (auto &callback : callbacks) callback();
+  }
+
+  // 已完成时立即在当前线程调用
+  void on_complete(std::function<void()> &&callback) {
+    {
+      std::lock_guard<std::mutex> locker(mutex_);
+      if (!is_complete_) {
+        callbacks_.push_back(std::move(callback));
+        return;
+      }
+    }
+    callback();
+  }
 };
 
 template <typename T>
@@ -42,6 +79,29 @@ class co_future {
     return co_future_status::timeout;
   }
 
+  bool ready() const {
+    std::lock_guard<std::mutex> locker(state_->mutex_);
+    return state_->is_complete_;
+  }
+
+  // 完成后调用func，不阻塞；func在set_value的线程上执行，应尽量轻量
+  template <typename F>
+  void on_ready(F &&func) {
+    state_->on_complete(std::forward<F>(func));
+  }
+
+  // 完成后以结果的右值调用func(T &&)并交出本future，之后不能再使用。
+  // 回调只引用状态本身而不持有它，组合多个future时不会与状态形成环：
+  // 结果永远不会到达且promise已释放时，回调随状态一起释放
+  template <typename F>
+  void on_value(F &&func) && {
+    auto state = state_.get();
+    state_->on_complete([state, func = std::forward<F>(func)]() mutable {
+      func(std::move(state->value_));
+    });
+    state_.reset();
+  }
+
   co_future(const co_future &) = delete;
   co_future &operator=(const co_future &) = delete;
 
@@ -85,31 +145,136 @@ class co_promise {
 
   void set_value(const T &value) {
     state_->value_ = value;
-    state_->is_complete_ = true;
-    state_->event_.signal();
+    state_->complete();
   }
 
   void set_value(T &value) {
     state_->value_ = value;
-    state_->is_complete_ = true;
-    state_->event_.signal();
+    state_->complete();
   }
 
   void set_value(T &&value) {
     state_->value_ = std::move(value);
-    state_->is_complete_ = true;
-    state_->event_.signal();
+    state_->complete();
   }
 
   void set_value() {
-    state_->is_complete_ = true;
-    state_->event_.signal();
+    state_->complete();
   }
 
  private:
   std::shared_ptr<shared_state<T>> state_;
 };
 
+// 在C++20协程中co_await一个co_future，挂起时不占用协程栈；
+// 完成后通过go()在cocoyaxi的调度器上恢复
+template <typename T>
+class co_future_awaiter {
+ public:
+  explicit co_future_awaiter(co_future<T> &&future)
+      : future_(std::move(future)) {}
+
+  bool await_ready() const { return future_.ready(); }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    // 回调可能在其他线程上立即执行并恢复协程，此后不能再访问this
+    future_.on_ready([handle] { go([handle] { handle.resume(); }); });
+  }
+
+  T await_resume() { return future_.get(); }
+
+ private:
+  co_future<T> future_;
+};
+
+template <typename T>
+inline co_future_awaiter<T> operator co_await(co_future<T> &&future) {
+  return co_future_awaiter<T>(std::move(future));
+}
+
+// 全部完成后按原顺序给出所有结果
+template <typename T>
+inline co_future<std::vector<T>> when_all(std::vector<co_future<T>> futures) {
+  struct Context {
+    // 各回调写入不同的元素，optional避免vector<bool>共用同一个字
+    std::vector<std::optional<T>> values;
+    std::atomic<std::size_t> remain;
+    co_promise<std::vector<T>> promise;
+  };
+  auto context = std::make_shared<Context>();
+  auto ret = context->promise.get_future();
+  if (futures.empty()) {
+    context->promise.set_value(std::vector<T>{});
+    return ret;
+  }
+  context->values.resize(futures.size());
+  context->remain = futures.size();
+  for (std::size_t i = 0; i < futures.size(); ++i)
+    std::move(futures[i]).on_value([context, i](T &&value) {
+      context->values[i] = std::move(value);
+      if (context->remain.fetch_sub(1) != 1) return;
+      std::vector<T> values;
+      values.reserve(context->values.size());
+      for (auto &value : context->values) values.push_back(std::move(*value));
+      context->promise.set_value(std::move(values));
+    });
+  return ret;
+}
+
+// 任意一个完成即给出其下标与结果，其余的结果被丢弃
+template <typename T>
+inline co_future<std::pair<std::size_t, T>> when_any(
+    std::vector<co_future<T>> futures) {
+  struct Context {
+    std::atomic<bool> done{false};
+    co_promise<std::pair<std::size_t, T>> promise;
+  };
+  auto context = std::make_shared<Context>();
+  auto ret = context->promise.get_future();
+  for (std::size_t i = 0; i < futures.size(); ++i)
+    std::move(futures[i]).on_value([context, i](T &&value) {
+      if (context->done.exchange(true)) return;
+      context->promise.set_value(std::make_pair(i, std::move(value)));
+    });
+  return ret;
+}
+
+// 对[first, last)中的每个元素在协程中调用func，同时最多运行limit个，
+// 全部完成后返回；func抛出的第一个异常在此重新抛出
+template <typename RandomIt, typename F>
+inline void parallel_for_each(RandomIt first, RandomIt last,
+                              const std::size_t limit, F &&func) {
+  const std::size_t size = std::distance(first, last);
+  if (size == 0) return;
+  const std::size_t workers = std::max<std::size_t>(1, std::min(limit, size));
+  std::atomic<std::size_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  co::WaitGroup wg;
+  wg.add(workers);
+  for (std::size_t w = 0; w < workers; ++w)
+    go([&] {
+      for (auto i = next.fetch_add(1); i < size; i = next.fetch_add(1)) {
+        try {
+          func(*(first + i));
+        } catch (...) {
+          std::lock_guard<std::mutex> locker(error_mutex);
+          if (!error) error = std::current_exception();
+        }
+      }
+      wg.done();
+    });
+  wg.wait();
+  if (error) std::rethrow_exception(error);
+}
+
+template <typename Range, typename F>
+inline void parallel_for_each(Range &range, const std::size_t limit,
+                              F &&func) {
+  parallel_for_each(std::begin(range), std::end(range), limit,
+                    std::forward<F>(func));
+}
+
 }  // namespace white
 
 #endif
\ No newline at end of file
@@ -0,0 +1,181 @@
+#ifndef MIGANGBOT_CO_TASK_H_
+#define MIGANGBOT_CO_TASK_H_
+
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "co_future.h"
+#include "logger/logger.h"
+
+namespace white {
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+class TaskPromiseBase {
+ public:
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> handle) noexcept {
+      auto &promise = handle.promise();
+      if (promise.continuation_) return promise.continuation_;
+      if (promise.detached_) handle.destroy();
+      return std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+
+  void unhandled_exception() noexcept {
+    if (detached_) {
+      // 没有人等待结果，只能记录下来
+      try {
+        throw;
+      } catch (const std::exception &e) {
+        LOG_ERROR("Exception Happened: {}", e.what());
+      } catch (...) {
+        LOG_ERROR("Exception Happened");
+      }
+      return;
+    }
+    exception_ = std::current_exception();
+  }
+
+ protected:
+  void Rethrow() const {
+    if (exception_) std::rethrow_exception(exception_);
+  }
+
+ private:
+  template <typename>
+  friend class white::Task;
+
+  std::coroutine_handle<> continuation_;
+  std::exception_ptr exception_;
+  bool detached_ = false;
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase {
+ public:
+  Task<T> get_return_object() noexcept;
+
+  template <typename U>
+  void return_value(U &&value) {
+    value_.template emplace<1>(std::forward<U>(value));
+  }
+
+  T Result() {
+    Rethrow();
+    return std::move(std::get<1>(value_));
+  }
+
+ private:
+  std::variant<std::monostate, T> value_;
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase {
+ public:
+  Task<void> get_return_object() noexcept;
+
+  void return_void() const noexcept {}
+
+  void Result() const { Rethrow(); }
+};
+
+}  // namespace detail
+
+// 无栈协程，挂起时只保留协程帧。co_await一个co_future(如aiorequests::Get)
+// 或ApiBot的api即可挂起，完成后在cocoyaxi调度器上继续执行，
+// 因此在Task中仍可调用co::sleep等原有的阻塞接口。
+// Task是惰性的：被co_await或Detach后才开始执行
+template <typename T>
+class [[nodiscard]] Task {
+ public:
+  using promise_type = detail::TaskPromise<T>;
+
+  explicit Task(std::coroutine_handle<promise_type> handle) noexcept
+      : handle_(handle) {}
+
+  Task(Task &&rhs) noexcept : handle_(std::exchange(rhs.handle_, {})) {}
+
+  Task &operator=(Task &&rhs) noexcept {
+    if (&rhs != this) {
+      if (handle_) handle_.destroy();
+      handle_ = std::exchange(rhs.handle_, {});
+    }
+    return *this;
+  }
+
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+
+  ~Task() {
+    if (handle_) handle_.destroy();
+  }
+
+ public:
+  auto operator co_await() && noexcept {
+    struct Awaiter {
+      std::coroutine_handle<promise_type> handle;
+
+      bool await_ready() const noexcept { return false; }
+
+      std::coroutine_handle<> await_suspend(
+          std::coroutine_handle<> continuation) noexcept {
+        handle.promise().continuation_ = continuation;
+        return handle;
+      }
+
+      T await_resume() { return handle.promise().Result(); }
+    };
+    return Awaiter{handle_};
+  }
+
+  // 在当前线程上开始执行，执行完毕后自行销毁，异常只记录日志
+  void Detach() && {
+    auto handle = std::exchange(handle_, {});
+    handle.promise().detached_ = true;
+    handle.resume();
+  }
+
+ private:
+  std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+template <typename T>
+inline Task<T> TaskPromise<T>::get_return_object() noexcept {
+  return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+  return Task<void>(
+      std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+}  // namespace detail
+
+template <typename>
+struct IsTask : std::false_type {};
+
+template <typename T>
+struct IsTask<Task<T>> : std::true_type {};
+
+}  // namespace white
+
+#endif
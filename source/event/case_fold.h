@@ -0,0 +1,154 @@
+#ifndef MIGANGBOT_EVENT_CASE_FOLD_H_
+#define MIGANGBOT_EVENT_CASE_FOLD_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace white {
+namespace case_fold {
+
+// 简单大小写折叠，覆盖ASCII、拉丁字母补充、希腊字母、西里尔字母和全角字母，
+// 折叠前后UTF-8编码长度不变，因此命令长度仍可按原文的字节数计算
+inline uint32_t FoldCodePoint(const uint32_t cp) noexcept {
+  if (cp < 0x80) return cp >= 'A' && cp <= 'Z' ? cp + 0x20 : cp;
+  if (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) return cp + 0x20;
+  if (cp >= 0x391 && cp <= 0x3A9 && cp != 0x3A2) return cp + 0x20;
+  if (cp >= 0x400 && cp <= 0x40F) return cp + 0x50;
+  if (cp >= 0x410 && cp <= 0x42F) return cp + 0x20;
+  if (cp >= 0xFF21 && cp <= 0xFF3A) return cp + 0x20;
+  return cp;
+}
+
+// 折叠s开头的一个字符，返回其字节数，folded写入同样长度的折叠结果；
+// 非法或被截断的字节按单字节原样输出
+inline std::size_t FoldChar(const std::string_view &s,
+                            unsigned char *folded) noexcept {
+  auto byte = [&s](std::size_t i) { return static_cast<unsigned char>(s[i]); };
+  auto c = byte(0);
+  folded[0] = c;
+  if (c < 0x80) {
+    if (c >= 'A' && c <= 'Z') folded[0] = c + 0x20;
+    return 1;
+  }
+  std::size_t size = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+  if (size == 1 || size > s.size()) return 1;
+  for (std::size_t i = 1; i < size; ++i) {
+    if ((byte(i) & 0xC0) != 0x80) return 1;
+    folded[i] = byte(i);
+  }
+  if (size == 2) {
+    auto cp = FoldCodePoint(((c & 0x1F) << 6) | (byte(1) & 0x3F));
+    folded[0] = 0xC0 | (cp >> 6);
+    folded[1] = 0x80 | (cp & 0x3F);
+  } else if (size == 3) {
+    auto cp = FoldCodePoint(((c & 0x0F) << 12) | ((byte(1) & 0x3F) << 6) |
+                            (byte(2) & 0x3F));
+    folded[0] = 0xE0 | (cp >> 12);
+    folded[1] = 0x80 | ((cp >> 6) & 0x3F);
+    folded[2] = 0x80 | (cp & 0x3F);
+  }
+  return size;
+}
+
+// 结束于s末尾的那个字符的起始位置
+inline std::size_t LastCharStart(const std::string_view &s) noexcept {
+  auto start = s.size() - 1;
+  for (int i = 0; i < 3 && start > 0; ++i) {
+    if ((static_cast<unsigned char>(s[start]) & 0xC0) != 0x80) break;
+    --start;
+  }
+  // 起始字节声明的长度必须正好覆盖到末尾
+  unsigned char folded[4];
+  if (start + FoldChar(s.substr(start), folded) != s.size())
+    return s.size() - 1;
+  return start;
+}
+
+// ASCII之外，只有以这些字节开头的字符可能被FoldCodePoint改变；
+// 0xC0、0xC1与0xE0是超长编码，也可能解出需要折叠的码位
+inline bool MayFoldLead(const unsigned char c) noexcept {
+  switch (c) {
+    case 0xC0:
+    case 0xC1:
+    case 0xC3:
+    case 0xCE:
+    case 0xD0:
+    case 0xE0:
+    case 0xEF:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// 按字节顺序回调折叠后的字节，回调返回false时停止。
+// 不会被折叠的字节逐个原样输出，与按字符折叠的结果相同
+template <typename F>
+inline void ForEachByte(const std::string_view &s, F &&func) {
+  unsigned char folded[4];
+  for (std::size_t pos = 0; pos < s.size();) {
+    auto c = static_cast<unsigned char>(s[pos]);
+    if (c < 0x80 || !MayFoldLead(c)) {
+      if (!func(c >= 'A' && c <= 'Z' ? static_cast<unsigned char>(c + 0x20)
+                                     : c))
+        return;
+      ++pos;
+      continue;
+    }
+    auto size = FoldChar(s.substr(pos), folded);
+    for (std::size_t i = 0; i < size; ++i)
+      if (!func(folded[i])) return;
+    pos += size;
+  }
+}
+
+// 从末尾开始逆序回调折叠后的字节
+template <typename F>
+inline void ForEachByteReverse(std::string_view s, F &&func) {
+  unsigned char folded[4];
+  while (!s.empty()) {
+    auto c = static_cast<unsigned char>(s.back());
+    if (c < 0x80) {
+      if (!func(c >= 'A' && c <= 'Z' ? static_cast<unsigned char>(c + 0x20)
+                                     : c))
+        return;
+      s.remove_suffix(1);
+      continue;
+    }
+    // 末尾的续字节之前是不会被折叠的起始字节时，这一段全部原样输出；
+    // 这段即使不是合法字符，逐字节退回时也总是落在同一个起始字节上
+    auto lead = s.size() - 1;
+    for (int i = 0; i < 3 && lead > 0; ++i) {
+      if ((static_cast<unsigned char>(s[lead]) & 0xC0) != 0x80) break;
+      --lead;
+    }
+    if (auto ch = static_cast<unsigned char>(s[lead]);
+        ch >= 0xC0 && !MayFoldLead(ch)) {
+      for (auto i = s.size(); i > lead; --i)
+        if (!func(static_cast<unsigned char>(s[i - 1]))) return;
+      s.remove_suffix(s.size() - lead);
+      continue;
+    }
+    auto start = LastCharStart(s);
+    auto size = FoldChar(s.substr(start), folded);
+    for (std::size_t i = size; i > 0; --i)
+      if (!func(folded[i - 1])) return;
+    s.remove_suffix(s.size() - start);
+  }
+}
+
+inline std::string Fold(const std::string_view &s) {
+  std::string ret;
+  ret.reserve(s.size());
+  ForEachByte(s, [&ret](unsigned char ch) {
+    ret.push_back(ch);
+    return true;
+  });
+  return ret;
+}
+
+}  // namespace case_fold
+}  // namespace white
+
+#endif
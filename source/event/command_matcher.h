@@ -0,0 +1,213 @@
+#ifndef MIGANGBOT_EVENT_COMMAND_MATCHER_H_
+#define MIGANGBOT_EVENT_COMMAND_MATCHER_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "event/case_fold.h"
+#include "event/trie.h"
+#include "event/type.h"
+#include "service/triggered_service.h"
+
+namespace white {
+
+// 一次查找的结果，指针指向CommandMatcher内部，在下次注册前有效
+struct CommandMatch {
+  const std::shared_ptr<TriggeredService> *fullmatch = nullptr;
+  const std::shared_ptr<TriggeredService> *prefix = nullptr;
+  const std::shared_ptr<TriggeredService> *suffix = nullptr;
+  // 前缀为正，后缀为负
+  int prefix_size = 0;
+  int suffix_size = 0;
+  // 第i位为1表示第i个正则的字面量命中，需要运行正则确认；64个以后的总是运行
+  uint64_t regex_candidates = 0;
+
+  bool IsRegexCandidate(const std::size_t index) const noexcept {
+    return index >= 64 || (regex_candidates >> index) & 1;
+  }
+};
+
+// 命令查找与正则预筛选。全匹配查哈希表，前缀与后缀分别在正向与逆向Trie上
+// 从消息两端锚定查找，走不下去就停，不必扫描整条消息；
+// 只有正则的必需字面量需要整条扫描，编入一个Aho-Corasick自动机，
+// 处于根状态时跳过不可能开始任何字面量的字节。
+// 与Trie一致，按case_fold忽略大小写，全匹配区分大小写
+class CommandMatcher {
+ public:
+  // 与已注册的命令重复时返回false
+  bool AddFullmatch(const std::string &command,
+                    const std::shared_ptr<TriggeredService> &service);
+
+  bool AddPrefix(const std::string &command,
+                 const std::shared_ptr<TriggeredService> &service);
+
+  bool AddSuffix(const std::string &command,
+                 const std::shared_ptr<TriggeredService> &service);
+
+  // literals为空表示该正则无法预筛选，总是作为候选
+  void AddRegex(const std::size_t index,
+                const std::vector<std::string> &literals);
+
+  // 所有正则注册完成后调用。构建之前所有正则都是候选
+  void Build();
+
+  bool Built() const noexcept { return built_; }
+
+  CommandMatch Match(const std::string_view &message) const noexcept;
+
+  std::size_t FullmatchSize() const noexcept { return fullmatch_.size(); }
+  std::size_t PrefixSize() const noexcept { return prefix_.Size(); }
+  std::size_t SuffixSize() const noexcept { return suffix_.Size(); }
+
+ private:
+  struct Literal {
+    std::string key;
+    // 正则的下标
+    uint32_t index;
+  };
+
+  int Step(const int state, const unsigned char ch) const noexcept {
+    return next_[state * class_count_ + class_of_[ch]];
+  }
+
+  uint64_t ScanLiterals(const std::string_view &message) const noexcept;
+
+ private:
+  bool built_ = false;
+  uint64_t always_regex_ = 0;
+
+  StringMap<std::shared_ptr<TriggeredService>> fullmatch_;
+  std::size_t max_fullmatch_size_ = 0;
+  Trie prefix_;
+  Trie suffix_;
+
+  std::vector<Literal> literals_;
+
+  // 字面量自动机为稠密跳转表，状态i读入字节ch后转到
+  // next_[i * class_count_ + class_of_[ch]]，不需要沿fail链回退；
+  // 字面量中没有出现的字节同属第0类，表的宽度只与字面量用到的字节数有关
+  std::array<uint16_t, 256> class_of_{};
+  int class_count_ = 1;
+  std::vector<int> next_;
+  // 到达该状态时命中的正则，含沿fail链的全部输出
+  std::vector<uint64_t> hits_;
+};
+
+inline bool CommandMatcher::AddFullmatch(
+    const std::string &command,
+    const std::shared_ptr<TriggeredService> &service) {
+  if (!fullmatch_.emplace(command, service).second) return false;
+  max_fullmatch_size_ = std::max(max_fullmatch_size_, command.size());
+  return true;
+}
+
+inline bool CommandMatcher::AddPrefix(
+    const std::string &command,
+    const std::shared_ptr<TriggeredService> &service) {
+  return prefix_.Insert(command, service);
+}
+
+inline bool CommandMatcher::AddSuffix(
+    const std::string &command,
+    const std::shared_ptr<TriggeredService> &service) {
+  return suffix_.InsertFromBack(command, service);
+}
+
+inline void CommandMatcher::AddRegex(const std::size_t index,
+                                     const std::vector<std::string> &literals) {
+  if (index >= 64) return;
+  built_ = false;
+  if (literals.empty()) {
+    always_regex_ |= uint64_t{1} << index;
+    return;
+  }
+  for (const auto &literal : literals)
+    if (!literal.empty())
+      literals_.push_back({literal, static_cast<uint32_t>(index)});
+}
+
+inline void CommandMatcher::Build() {
+  // 先用map建出普通trie，再按bfs顺序展开成稠密跳转表
+  std::vector<std::map<unsigned char, int>> childs(1);
+  hits_.assign(1, 0);
+  class_of_.fill(0);
+  class_count_ = 1;
+  for (const auto &literal : literals_) {
+    int node = 0;
+    for (auto ch : case_fold::Fold(literal.key)) {
+      auto label = static_cast<unsigned char>(ch);
+      if (!class_of_[label]) class_of_[label] = class_count_++;
+      auto it = childs[node].find(label);
+      if (it == childs[node].end()) {
+        it = childs[node].emplace(label, childs.size()).first;
+        childs.emplace_back();
+        hits_.push_back(0);
+      }
+      node = it->second;
+    }
+    hits_[node] |= uint64_t{1} << literal.index;
+  }
+
+  // bfs计算fail链，没有的边取fail节点的同一条边，输出并入fail节点的输出
+  const auto size = childs.size();
+  next_.assign(size * class_count_, 0);
+  std::vector<int> fail(size, 0);
+  std::queue<int> queue;
+  for (auto [label, target] : childs[0]) {
+    next_[class_of_[label]] = target;
+    queue.push(target);
+  }
+  while (!queue.empty()) {
+    auto node = queue.front();
+    queue.pop();
+    hits_[node] |= hits_[fail[node]];
+    auto row = next_.begin() + node * class_count_;
+    std::copy_n(next_.begin() + fail[node] * class_count_, class_count_, row);
+    for (auto [label, target] : childs[node]) {
+      fail[target] = next_[fail[node] * class_count_ + class_of_[label]];
+      row[class_of_[label]] = target;
+      queue.push(target);
+    }
+  }
+  built_ = true;
+}
+
+inline uint64_t CommandMatcher::ScanLiterals(
+    const std::string_view &message) const noexcept {
+  uint64_t hits = 0;
+  int state = 0;
+  case_fold::ForEachByte(message, [&](unsigned char ch) {
+    // 根状态下读入第0类字节仍停在根，不必查表
+    if (!state && !class_of_[ch]) return true;
+    state = Step(state, ch);
+    hits |= hits_[state];
+    return true;
+  });
+  return hits;
+}
+
+inline CommandMatch CommandMatcher::Match(
+    const std::string_view &message) const noexcept {
+  CommandMatch match;
+  if (message.size() <= max_fullmatch_size_)
+    if (auto it = fullmatch_.find(message); it != fullmatch_.end())
+      match.fullmatch = &it->second;
+  if (const auto &service = prefix_.LongestPrefix(message, match.prefix_size))
+    match.prefix = &service;
+  if (const auto &service = suffix_.LongestSuffix(message, match.suffix_size))
+    match.suffix = &service;
+  match.regex_candidates =
+      built_ ? always_regex_ | ScanLiterals(message) : ~uint64_t{0};
+  return match;
+}
+
+}  // namespace white
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef MIGANGBOT_EVENT_DECODED_EVENT_H_
+#define MIGANGBOT_EVENT_DECODED_EVENT_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "event/event.h"
+#include "event/event_view.h"
+#include "global_config.h"
+#include "logger/logger.h"
+#include "message/cq_code.h"
+#include "permission/permission.h"
+#include "service/enable_matrix.h"
+#include "type.h"
+
+namespace white {
+
+enum class PostType : uint8_t { kUnknown, kMessage, kNotice, kRequest, kMeta };
+
+enum class MessageType : uint8_t { kUnknown, kPrivate, kGroup };
+
+// onebot11标准中的通知类型，go-cqhttp等扩展的类型为kOther
+enum class NoticeType : uint8_t {
+  kUnknown,
+  kGroupUpload,
+  kGroupAdmin,
+  kGroupDecrease,
+  kGroupIncrease,
+  kGroupBan,
+  kFriendAdd,
+  kGroupRecall,
+  kFriendRecall,
+  kNotify,
+  kOther
+};
+
+enum class RequestType : uint8_t { kUnknown, kFriend, kGroup };
+
+enum class MetaEventType : uint8_t { kUnknown, kLifecycle, kHeartbeat };
+
+namespace decode {
+
+inline PostType ToPostType(const std::string_view &s) noexcept {
+  if (s == "message") return PostType::kMessage;
+  if (s == "notice") return PostType::kNotice;
+  if (s == "request") return PostType::kRequest;
+  if (s == "meta_event") return PostType::kMeta;
+  return PostType::kUnknown;
+}
+
+inline MessageType ToMessageType(const std::string_view &s) noexcept {
+  if (s == "group") return MessageType::kGroup;
+  if (s == "private") return MessageType::kPrivate;
+  return MessageType::kUnknown;
+}
+
+inline NoticeType ToNoticeType(const std::string_view &s) noexcept {
+  if (s.empty()) return NoticeType::kUnknown;
+  if (s == "group_upload") return NoticeType::kGroupUpload;
+  if (s == "group_admin") return NoticeType::kGroupAdmin;
+  if (s == "group_decrease") return NoticeType::kGroupDecrease;
+  if (s == "group_increase") return NoticeType::kGroupIncrease;
+  if (s == "group_ban") return NoticeType::kGroupBan;
+  if (s == "friend_add") return NoticeType::kFriendAdd;
+  if (s == "group_recall") return NoticeType::kGroupRecall;
+  if (s == "friend_recall") return NoticeType::kFriendRecall;
+  if (s == "notify") return NoticeType::kNotify;
+  return NoticeType::kOther;
+}
+
+inline RequestType ToRequestType(const std::string_view &s) noexcept {
+  if (s == "friend") return RequestType::kFriend;
+  if (s == "group") return RequestType::kGroup;
+  return RequestType::kUnknown;
+}
+
+inline MetaEventType ToMetaEventType(const std::string_view &s) noexcept {
+  if (s == "lifecycle") return MetaEventType::kLifecycle;
+  if (s == "heartbeat") return MetaEventType::kHeartbeat;
+  return MetaEventType::kUnknown;
+}
+
+}  // namespace decode
+
+// 分发热路径上使用的事件，由EventView解码一次，字符串均指向原始帧，
+// 完整的Json只有插件真正需要时才通过Share构造
+struct DecodedEvent {
+  explicit DecodedEvent(EventView &event_view);
+
+  // 所有匹配的服务共享的只读Event，to_me时含__to_me__和去掉@后的message；
+  // command_size非0时返回额外带__command_size__的副本，前缀与后缀各至多一份。
+  // 惰性视图能接受完整解析器拒绝的帧，此时返回nullptr，事件应被丢弃
+  std::shared_ptr<const Event> Share(const int command_size = 0) const;
+
+  // 本群在matrix中的启用状态，第一次调用时查询，之后各服务只做位测试
+  const EnableMatrix::GroupView &Group(const EnableMatrix &matrix) const;
+
+  EventView &view;
+
+  PostType post_type = PostType::kUnknown;
+  MessageType message_type = MessageType::kUnknown;
+  NoticeType notice_type = NoticeType::kUnknown;
+  RequestType request_type = RequestType::kUnknown;
+  MetaEventType meta_event_type = MetaEventType::kUnknown;
+
+  // notice_type/request_type的原始字符串，用于查找注册的服务
+  std::string_view type_name;
+  std::string_view sub_type;
+
+  QId self_id = 0;
+  QId user_id = 0;
+  GId group_id = 0;
+  bool has_group = false;
+
+  // 已去掉开头的@bot或bot名字
+  std::string_view message;
+  int permission = permission::NORMAL;
+  bool to_me = false;
+
+ private:
+  void DecodeMessage();
+
+  mutable std::shared_ptr<const Event> shared_;
+  mutable std::shared_ptr<const Event> prefix_shared_;
+  mutable std::shared_ptr<const Event> suffix_shared_;
+  mutable bool discarded_ = false;
+  mutable EnableMatrix::GroupView group_;
+};
+
+inline DecodedEvent::DecodedEvent(EventView &event_view) : view(event_view) {
+  post_type = decode::ToPostType(view.GetString("post_type"));
+  self_id = view.GetNumber<QId>("self_id");
+  user_id = view.GetNumber<QId>("user_id");
+  has_group = view.Contains("group_id");
+  group_id = view.GetNumber<GId>("group_id");
+  sub_type = view.GetString("sub_type");
+  switch (post_type) {
+    case PostType::kMessage:
+      DecodeMessage();
+      break;
+    case PostType::kNotice:
+      type_name = view.GetString("notice_type");
+      notice_type = decode::ToNoticeType(type_name);
+      break;
+    case PostType::kRequest:
+      type_name = view.GetString("request_type");
+      request_type = decode::ToRequestType(type_name);
+      break;
+    case PostType::kMeta:
+      meta_event_type =
+          decode::ToMetaEventType(view.GetString("meta_event_type"));
+      break;
+    default:
+      break;
+  }
+}
+
+inline void DecodedEvent::DecodeMessage() {
+  message_type = decode::ToMessageType(view.GetString("message_type"));
+  permission = permission::GetUserPermission(view);
+  message = view.Message();
+  // 绝大多数消息不以at开头，不必切分
+  if (message.starts_with("[CQ:at,")) {
+    message::Tokenizer tokenizer(message);
+    auto first = tokenizer.Next();
+    if (first && first->Number<QId>("qq") == self_id) {
+      message = tokenizer.Rest();
+      message.remove_prefix(
+          std::min(message.find_first_not_of(' '), message.size()));
+      to_me = true;
+    }
+  } else if (message.starts_with(config::BOT_NAME)) {
+    message.remove_prefix(config::BOT_NAME.size());
+    to_me = true;
+  }
+}
+
+inline std::shared_ptr<const Event> DecodedEvent::Share(
+    const int command_size) const {
+  if (discarded_) return nullptr;
+  if (!shared_) {
+    auto event = view.Parse();
+    if (event.is_discarded()) {
+      LOG_ERROR("无法解析的事件: {}", view.Raw());
+      discarded_ = true;
+      return nullptr;
+    }
+    if (to_me) {
+      event["__to_me__"] = true;
+      event["message"] = std::string(message);
+    }
+    shared_ = std::make_shared<const Event>(std::move(event));
+  }
+  if (!command_size) return shared_;
+  // 一条消息只会有一个最长前缀和一个最长后缀
+  auto &annotated = command_size > 0 ? prefix_shared_ : suffix_shared_;
+  if (!annotated) {
+    Event event = *shared_;
+    event["__command_size__"] = command_size;
+    annotated = std::make_shared<const Event>(std::move(event));
+  }
+  return annotated;
+}
+
+inline const EnableMatrix::GroupView &DecodedEvent::Group(
+    const EnableMatrix &matrix) const {
+  if (group_.Matrix() != &matrix) group_ = matrix.Group(group_id);
+  return group_;
+}
+
+}  // namespace white
+
+#endif
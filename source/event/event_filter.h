@@ -4,17 +4,17 @@
 #include <nlohmann/json.hpp>
 
 #include "event/event.h"
+#include "event/decoded_event.h"
 
 namespace white {
 
 class EventFilter {
  public:
-  const bool Filter(const Event &event) const noexcept {
-    if (event.contains("post_type"))
-      if (event.value("message_type", "") == "private" &&
-          event.value("sub_type", "") == "group")
-        return false;
-    if (event.contains("retcode")) return false;
+  const bool Filter(const DecodedEvent &event) const noexcept {
+    if (event.post_type == PostType::kUnknown) return false;
+    if (event.message_type == MessageType::kPrivate &&
+        event.sub_type == "group")
+      return false;
     return true;
   }
 };
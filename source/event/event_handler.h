@@ -11,11 +11,12 @@
 #include <vector>
 
 #include <co/co.h>
-#include <jpcre2.hpp>
 #include <nlohmann/json.hpp>
 
 #include "bot/onebot_11/api_bot.h"
+#include "event/command_matcher.h"
 #include "event/event_filter.h"
+#include "event/decoded_event.h"
 #include "event/regex_matcher.h"
 #include "event/trie.h"
 #include "event/type.h"
@@ -49,7 +50,11 @@ class EventHandler {
   bool RegisterRegex(const std::initializer_list<std::string> &patterns,
                      std::shared_ptr<TriggeredService> service);
 
-  bool Handle(Event &event, onebot11::ApiBot &bot) noexcept;
+  // 在InitModuleList()之后调用，把已注册的命令编入CommandMatcher
+  void Compile();
+
+  bool Handle(const DecodedEvent &event, onebot11::ApiBot &bot,
+              bool shed_all_msg = false) noexcept;
 
  public:
   EventHandler(const EventHandler &) = delete;
@@ -62,24 +67,15 @@ class EventHandler {
   ~EventHandler() {}
 
  private:
-  std::unordered_map<std::string, std::shared_ptr<TriggeredService>>
-      command_fullmatch_;
-  Trie command_prefix_;
-  Trie command_suffix_;
-
   std::vector<RegexMatcher> command_regex_;
 
+  CommandMatcher matcher_;
+
   std::vector<std::shared_ptr<TriggeredService>> all_msg_handler_;
 
-  std::unordered_map<
-      std::string,
-      std::unordered_map<std::string,
-                         std::vector<std::shared_ptr<TriggeredService>>>>
+  StringMap<StringMap<std::vector<std::shared_ptr<TriggeredService>>>>
       notice_handler_;
-  std::unordered_map<
-      std::string,
-      std::unordered_map<std::string,
-                         std::vector<std::shared_ptr<TriggeredService>>>>
+  StringMap<StringMap<std::vector<std::shared_ptr<TriggeredService>>>>
       request_handler_;
 
   std::unique_ptr<EventFilter> filter_;
@@ -89,21 +85,16 @@ inline bool EventHandler::RegisterCommand(
     const int command_type, const std::string &command,
     std::shared_ptr<TriggeredService> service) {
   switch (command_type) {
-    case FULLMATCH:
-      return command_fullmatch_.emplace(command, service).second;
-      break;
     case PREFIX:
-      return command_prefix_.Insert(command, service);
-      break;
+      return matcher_.AddPrefix(command, service);
     case SUFFIX:
-      return command_suffix_.InsertFromBack(command, service);
-      break;
+      return matcher_.AddSuffix(command, service);
     case ALLMSG:
       all_msg_handler_.push_back(service);
-      return true;
       break;
+    case FULLMATCH:
     default:
-      return command_fullmatch_.emplace(command, service).second;
+      return matcher_.AddFullmatch(command, service);
   }
   return true;
 }
@@ -126,203 +117,141 @@ inline bool EventHandler::RegisterRegex(
     const std::initializer_list<std::string> &patterns,
     std::shared_ptr<TriggeredService> service) {
   command_regex_.push_back(RegexMatcher(patterns, service));
+  matcher_.AddRegex(command_regex_.size() - 1,
+                    command_regex_.back().GetLiterals());
   return true;
 }
 
-inline bool EventHandler::Handle(Event &event, onebot11::ApiBot &bot) noexcept {
+inline void EventHandler::Compile() {
+  matcher_.Build();
+  LOG_INFO("命令匹配器已构建: 全匹配{}个, 前缀{}个, 后缀{}个, 正则{}个",
+           matcher_.FullmatchSize(), matcher_.PrefixSize(),
+           matcher_.SuffixSize(), command_regex_.size());
+}
+
+// shed_all_msg: 事件队列过载时跳过全消息处理服务
+// 只有存在匹配的服务时才会构造完整的Event
+inline bool EventHandler::Handle(const DecodedEvent &event,
+                                 onebot11::ApiBot &bot,
+                                 bool shed_all_msg) noexcept {
   if (!filter_->Filter(event)) return false;
-  if (event.contains("post_type")) {
-    auto post_type = event["post_type"].get<std::string>();
-    switch (post_type[3]) {
-      // message
-      case 's': {
-        auto msg = event["message"].get<std::string_view>();
-        auto message_type = event["message_type"].get<std::string>()[0];
-        auto perm = permission::GetUserPermission(event);
-        switch (message_type) {
-          case 'p':
-            if (event["sub_type"].get<std::string>()[0] == 'f')
-              LOG_INFO("Bot[{}]收到来自好友[{}({})]的消息: {}",
-                       event["self_id"].get<QId>(),
-                       event["sender"].value("nickname", ""),
-                       event["sender"].value("user_id", 0), msg);
-            break;
-          case 'g':
-            if (event["anonymous"] != nullptr)
-              LOG_INFO("Bot[{}]收到来自群[{}]的匿名消息: {}",
-                       event["self_id"].get<QId>(),
-                       event["group_id"].get<GId>(), msg);
-            else
-              LOG_INFO("Bot[{}]收到来自群[{}]成员[{}({})]的消息: {}",
-                       event["self_id"].get<QId>(),
-                       event["group_id"].get<GId>(),
-                       event["sender"].value("nickname", ""),
-                       event["sender"].value("user_id", 0), msg);
-            break;
-          default:
-            break;
-        }
-        // pre_propose
-        if (msg.starts_with("[CQ:at")) {
-          // auto at_id_start = msg.find_first_of('=') + 1;
-          auto at_id_start = std::min(static_cast<std::size_t>(10), msg.size());
-          auto at_id_end = std::min(msg.find_first_of(']'), msg.size());
-          auto at_id = msg.substr(at_id_start, at_id_end - at_id_start);
-          if (at_id == std::to_string(event["self_id"].get<QId>())) {
-            msg = msg.substr(msg.find_first_of(']') + 1);
-            msg = msg.substr(msg.find_first_not_of(' '));
-            event["__to_me__"] = true;
-            event["message"] = msg;
+  // 所有服务共享同一个只读Event，不再逐个深拷贝
+  // 经过服务的隔离舱执行，超出并发与排队上限时拒绝
+  auto run = [&event, &bot](const std::shared_ptr<TriggeredService> &service,
+                            const int command_size = 0) {
+    auto shared = event.Share(command_size);
+    if (!shared) return;
+    auto &bulkhead = service->GetBulkhead();
+    auto admit = bulkhead.Submit(
+        [&service, shared, &bot](Bulkhead::Permit permit) {
+          service->Run(*shared, bot, std::move(permit));
+        });
+    if (admit != Bulkhead::Admit::kRejected) return;
+    LOG_WARN("服务[{}]繁忙，已拒绝本次调用", service->GetServiceName());
+    if (event.post_type == PostType::kMessage &&
+        !bulkhead.RejectReply().empty())
+      bot.send(*shared, bulkhead.RejectReply());
+  };
+  switch (event.post_type) {
+    case PostType::kMessage: {
+      switch (event.message_type) {
+        case MessageType::kPrivate:
+          if (event.sub_type == "friend") {
+            auto sender = event.view.GetObject("sender");
+            LOG_INFO("Bot[{}]收到来自好友[{}({})]的消息: {}", event.self_id,
+                     sender.GetUnescaped("nickname"),
+                     sender.GetNumber<QId>("user_id"), event.view.Message());
           }
-        } else if (msg.starts_with(config::BOT_NAME)) {
-          event["__to_me__"] = true;
-          msg.remove_prefix(config::BOT_NAME.size());
-          event["message"] = msg;
-        }
-        std::string message{msg};
-        switch (message_type) {
-          case 'g': {
-            auto group_id = event["group_id"].get<GId>();
-
-            // command match
-            if (command_fullmatch_.count(message)) {
-              const auto &service = command_fullmatch_.at(message);
-              if (service->CheckIsEnable(group_id) &&
-                  service->CheckPerm(perm) &&
-                  service->CheckToMe(event.contains("__to_me__")))
-                go([&service, event, &bot] { service->Run(event, bot); });
-            }
-            {
-              const auto &service =
-                  command_prefix_.LongestPrefix(message, event);
-              if (service && service->CheckIsEnable(group_id) &&
-                  service->CheckPerm(perm) &&
-                  service->CheckToMe(event.contains("__to_me__")))
-                go([&service, event, &bot] { service->Run(event, bot); });
-            }
-            {
-              const auto &service =
-                  command_suffix_.LongestSuffix(message, event);
-              if (service && service->CheckIsEnable(group_id) &&
-                  service->CheckPerm(perm) &&
-                  service->CheckToMe(event.contains("__to_me__")))
-                go([&service, event, &bot] { service->Run(event, bot); });
-            }
-
-            // regex match
-            for (auto &regex_matcher : command_regex_) {
-              if (regex_matcher.Check(message)) {
-                const auto &service = regex_matcher.GetService();
-                if (service->CheckIsEnable(group_id) &&
-                    service->CheckPerm(perm))
-                  go([&service, event, &bot] { service->Run(event, bot); });
-              }
-            }
+          break;
+        case MessageType::kGroup:
+          if (!event.view.IsNull("anonymous")) {
+            LOG_INFO("Bot[{}]收到来自群[{}]的匿名消息: {}", event.self_id,
+                     event.group_id, event.view.Message());
+          } else {
+            auto sender = event.view.GetObject("sender");
+            LOG_INFO("Bot[{}]收到来自群[{}]成员[{}({})]的消息: {}",
+                     event.self_id, event.group_id,
+                     sender.GetUnescaped("nickname"),
+                     sender.GetNumber<QId>("user_id"), event.view.Message());
+          }
+          break;
+        default:
+          return true;
+      }
 
-            // match all
-            for (const auto &service : all_msg_handler_)
-              if (service->CheckIsEnable(group_id) && service->CheckPerm(perm))
-                go([&service, event, &bot] { service->Run(event, bot); });
-          } break;
-          case 'p': {
-            // commmand match
-            if (command_fullmatch_.count(message)) {
-              const auto &service = command_fullmatch_.at(message);
-              if (service->CheckPerm(perm))
-                go([&service, event, &bot] { service->Run(event, bot); });
-            }
-            {
-              const auto &service =
-                  command_prefix_.LongestPrefix(message, event);
-              if (service && service->CheckPerm(perm))
-                go([&service, event, &bot] { service->Run(event, bot); });
-            }
-            {
-              const auto &service =
-                  command_suffix_.LongestSuffix(message, event);
-              if (service && service->CheckPerm(perm))
-                go([&service, event, &bot] { service->Run(event, bot); });
-            }
+      // command match, 同时得到全部命令与正则的候选
+      auto match = matcher_.Match(event.message);
+      if (match.fullmatch && (*match.fullmatch)->Check(event, true))
+        run(*match.fullmatch);
+      if (match.prefix && (*match.prefix)->Check(event, true))
+        run(*match.prefix, match.prefix_size);
+      if (match.suffix && (*match.suffix)->Check(event, true))
+        run(*match.suffix, match.suffix_size);
 
-            // regex_match
-            for (auto &regex_matcher : command_regex_) {
-              if (regex_matcher.Check(message)) {
-                const auto &service = regex_matcher.GetService();
-                if (service->CheckPerm(perm))
-                  go([&service, event, &bot] { service->Run(event, bot); });
-              }
-            }
+      // regex match, 只确认字面量命中的正则
+      for (std::size_t i = 0; i < command_regex_.size(); ++i) {
+        auto &regex_matcher = command_regex_[i];
+        if (!regex_matcher.GetService()->Check(event)) continue;
+        if (!match.IsRegexCandidate(i))
+          regex_matcher.Skip();
+        else if (regex_matcher.Check(event.message))
+          run(regex_matcher.GetService());
+      }
 
-            // match all
-            for (const auto &service : all_msg_handler_)
-              if (service->CheckPerm(perm))
-                go([&service, event, &bot] { service->Run(event, bot); });
-          } break;
-          default:
+      // match all
+      if (shed_all_msg) break;
+      for (const auto &service : all_msg_handler_)
+        if (service->Check(event)) run(service);
+    } break;
+    case PostType::kNotice: {
+      LOG_INFO("Bot[{}] 收到一个通知事件: {}.{}", event.self_id,
+               event.type_name, event.sub_type);
+      if (event.has_group)
+        bot.Cache().OnNotice(event.type_name, event.sub_type, event.group_id,
+                             event.user_id, event.self_id);
+      auto dispatch = [&](const auto &services) {
+        for (const auto &service : services)
+          if (!event.has_group || service->CheckIsEnable(event))
+            run(service);
+      };
+      auto it = notice_handler_.find(event.type_name);
+      if (it == notice_handler_.end()) break;
+      if (auto sub_it = it->second.find(event.sub_type);
+          sub_it != it->second.end())
+        dispatch(sub_it->second);
+      if (!event.sub_type.empty())
+        if (auto sub_it = it->second.find(""); sub_it != it->second.end())
+          dispatch(sub_it->second);
+    } break;
+    case PostType::kRequest: {
+      LOG_INFO("Bot[{}] 收到一个请求事件: {}.{}", event.self_id,
+               event.type_name, event.sub_type);
+      auto it = request_handler_.find(event.type_name);
+      if (it == request_handler_.end()) break;
+      if (auto sub_it = it->second.find(event.sub_type);
+          sub_it != it->second.end())
+        for (const auto &service : sub_it->second)
+          if (!event.has_group || service->CheckIsEnable(event))
+            run(service);
+    } break;
+    case PostType::kMeta: {
+      if (event.meta_event_type == MetaEventType::kLifecycle) {
+        switch (FirstChar(event.sub_type)) {
+          case 'e':
+          case 'c':
+            LOG_INFO("Bot[{}]已成功建立连接", event.self_id);
+            break;
+          case 'd':
+            LOG_INFO("Bot[{}]已断开连接", event.self_id);
             break;
         }
-      } break;
-      // notice
-      case 'i': {
-        auto notice_type = event.value("notice_type", "");
-        auto sub_type = event.value("sub_type", "");
-        LOG_INFO("Bot[{}] 收到一个通知事件: {}.{}", event["self_id"].get<QId>(),
-                 notice_type, sub_type);
-        if (notice_handler_.count(notice_type) &&
-            notice_handler_.at(notice_type).count(sub_type)) {
-          for (const auto &service :
-               notice_handler_.at(notice_type).at(sub_type))
-            if (!event.contains("group_id") ||
-                service->CheckIsEnable(event["group_id"].get<GId>()))
-              go([&service, event, &bot]() { service->Run(event, bot); });
-        }
-        if (!sub_type.empty()) {
-          if (notice_handler_.count(notice_type) &&
-              notice_handler_.at(notice_type).count("")) {
-            for (const auto &service : notice_handler_.at(notice_type).at(""))
-              if (!event.contains("group_id") ||
-                  service->CheckIsEnable(event["group_id"].get<GId>()))
-                go([&service, event, &bot]() { service->Run(event, bot); });
-          }
-        }
-      } break;
-      // request
-      case 'u': {
-        auto request_type = event.value("request_type", "");
-        auto sub_type = event.value("sub_type", "");
-        LOG_INFO("Bot[{}] 收到一个请求事件: {}.{}", event["self_id"].get<QId>(),
-                 request_type, sub_type);
-        if (request_handler_.count(request_type) &&
-            request_handler_.at(request_type).count(sub_type)) {
-          for (const auto &service :
-               request_handler_.at(request_type).at(sub_type))
-            if (!event.contains("group_id") ||
-                service->CheckIsEnable(event["group_id"].get<GId>()))
-              go([&service, event, &bot]() { service->Run(event, bot); });
-        }
-      } break;
-      // meta_event
-      case 'a': {
-        auto meta_event_type = event["meta_event_type"].get<std::string>();
-        if (meta_event_type[0] == 'l') {
-          auto sub_type = event["sub_type"].get<std::string>();
-          switch (sub_type[0]) {
-            case 'e':
-            case 'c':
-              LOG_INFO("Bot[{}]已成功建立连接", event["self_id"].get<QId>());
-              break;
-            case 'd':
-              LOG_INFO("Bot[{}]已断开连接", event["self_id"].get<QId>());
-              break;
-          }
-        } else {
-          LOG_DEBUG("Bot[{}]与[{}]收到一次心跳连接",
-                    event["self_id"].get<QId>(), event["time"].get<int64_t>());
-        }
-      } break;
-      default:
-        break;
-    }
+      } else {
+        LOG_DEBUG("Bot[{}]与[{}]收到一次心跳连接", event.self_id,
+                  event.view.GetNumber<int64_t>("time"));
+      }
+    } break;
+    default:
+      break;
   }
   return true;
 }
@@ -0,0 +1,362 @@
+#ifndef MIGANGBOT_EVENT_EVENT_VIEW_H_
+#define MIGANGBOT_EVENT_EVENT_VIEW_H_
+
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <nlohmann/json.hpp>
+
+#include "event/event.h"
+#include "logger/logger.h"
+
+namespace white {
+
+namespace json_scan {
+
+constexpr auto npos = std::string_view::npos;
+
+inline std::size_t SkipSpace(const std::string_view &s, std::size_t i) {
+  while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i]))) ++i;
+  return i;
+}
+
+// s[i]必须为'"'，返回闭合引号之后的位置
+inline std::size_t SkipString(const std::string_view &s, std::size_t i) {
+  for (++i; i < s.size(); ++i) {
+    if (s[i] == '\\')
+      ++i;
+    else if (s[i] == '"')
+      return i + 1;
+  }
+  return npos;
+}
+
+inline std::size_t SkipValue(const std::string_view &s, std::size_t i) {
+  if (i >= s.size()) return npos;
+  switch (s[i]) {
+    case '"':
+      return SkipString(s, i);
+    case '{':
+    case '[': {
+      int depth = 0;
+      while (i < s.size()) {
+        switch (s[i]) {
+          case '"':
+            i = SkipString(s, i);
+            if (i == npos) return npos;
+            continue;
+          case '{':
+          case '[':
+            ++depth;
+            break;
+          case '}':
+          case ']':
+            if (--depth == 0) return i + 1;
+            break;
+        }
+        ++i;
+      }
+      return npos;
+    }
+    default:
+      while (i < s.size() && s[i] != ',' && s[i] != '}' && s[i] != ']' &&
+             !std::isspace(static_cast<unsigned char>(s[i])))
+        ++i;
+      return i;
+  }
+}
+
+inline void AppendUTF8(std::string &out, uint32_t cp) {
+  if (cp < 0x80) {
+    out.push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
+
+inline uint32_t ParseHex4(const std::string_view &s, std::size_t i) {
+  uint32_t cp = 0;
+  if (i + 4 > s.size()) return 0;
+  std::from_chars(s.data() + i, s.data() + i + 4, cp, 16);
+  return cp;
+}
+
+// 解码json字符串内容(不含两侧引号)
+inline std::string Unescape(const std::string_view &s) {
+  std::string out;
+  out.reserve(s.size());
+  for (std::size_t i = 0; i < s.size(); ++i) {
+    if (s[i] != '\\' || i + 1 == s.size()) {
+      out.push_back(s[i]);
+      continue;
+    }
+    switch (s[++i]) {
+      case 'n':
+        out.push_back('\n');
+        break;
+      case 't':
+        out.push_back('\t');
+        break;
+      case 'r':
+        out.push_back('\r');
+        break;
+      case 'b':
+        out.push_back('\b');
+        break;
+      case 'f':
+        out.push_back('\f');
+        break;
+      case 'u': {
+        if (i + 4 >= s.size()) return out;
+        uint32_t cp = ParseHex4(s, i + 1);
+        i += 4;
+        if (cp >= 0xD800 && cp < 0xDC00 && i + 6 < s.size() &&
+            s[i + 1] == '\\' && s[i + 2] == 'u') {
+          uint32_t low = ParseHex4(s, i + 3);
+          if (low >= 0xDC00 && low < 0xE000) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            i += 6;
+          }
+        }
+        AppendUTF8(out, cp);
+      } break;
+      default:
+        out.push_back(s[i]);
+    }
+  }
+  return out;
+}
+
+}  // namespace json_scan
+
+inline char FirstChar(const std::string_view &view) noexcept {
+  return view.empty() ? '\0' : view.front();
+}
+
+// 只扫描一层的json对象视图，不拷贝也不建树。
+// 前kMaxFields个字段记录下来直接查找，之后的字段在查找时线性扫描
+class JsonObjectView {
+ public:
+  JsonObjectView() : valid_(false), size_(0) {}
+  explicit JsonObjectView(const std::string_view &object) { Scan(object); }
+
+ public:
+  bool Valid() const noexcept { return valid_; }
+
+  bool Contains(const std::string_view &key) const noexcept {
+    std::string_view value;
+    return Find(key, value);
+  }
+
+  // 原始的值文本，不存在时为空
+  std::string_view Raw(const std::string_view &key) const noexcept {
+    std::string_view value;
+    Find(key, value);
+    return value;
+  }
+
+  bool IsNull(const std::string_view &key) const noexcept {
+    auto value = Raw(key);
+    return value.empty() || value == "null";
+  }
+
+  // 字符串值(未反转义)，适用于post_type等不含转义的字段
+  std::string_view GetString(const std::string_view &key) const noexcept {
+    auto value = Raw(key);
+    if (value.size() < 2 || value.front() != '"') return {};
+    return value.substr(1, value.size() - 2);
+  }
+
+  std::string GetUnescaped(const std::string_view &key) const {
+    auto value = GetString(key);
+    if (value.find('\\') == std::string_view::npos) return std::string(value);
+    return json_scan::Unescape(value);
+  }
+
+  template <typename T = uint64_t>
+  T GetNumber(const std::string_view &key, T default_value = 0) const noexcept {
+    auto value = Raw(key);
+    T ret = default_value;
+    std::from_chars(value.data(), value.data() + value.size(), ret);
+    return ret;
+  }
+
+  bool GetBool(const std::string_view &key) const noexcept {
+    return Raw(key) == "true";
+  }
+
+  JsonObjectView GetObject(const std::string_view &key) const noexcept {
+    auto value = Raw(key);
+    if (value.empty() || value.front() != '{') return {};
+    return JsonObjectView(value);
+  }
+
+ private:
+  using Field = std::pair<std::string_view, std::string_view>;
+  static constexpr std::size_t kMaxFields = 32;
+
+  bool Find(const std::string_view &key,
+            std::string_view &value) const noexcept {
+    for (std::size_t i = 0; i < size_; ++i)
+      if (fields_[i].first == key) {
+        value = fields_[i].second;
+        return true;
+      }
+    return !rest_.empty() && FindInRest(key, value);
+  }
+
+  // rest_已在Scan中校验过格式
+  bool FindInRest(const std::string_view &key,
+                  std::string_view &value) const noexcept {
+    using namespace json_scan;
+    for (std::size_t i = 0; i < rest_.size();) {
+      auto key_end = SkipString(rest_, i);
+      auto field_key = rest_.substr(i + 1, key_end - i - 2);
+      i = SkipSpace(rest_, SkipSpace(rest_, key_end) + 1);
+      auto value_end = SkipValue(rest_, i);
+      if (field_key == key) {
+        value = rest_.substr(i, value_end - i);
+        return true;
+      }
+      // 跳过','
+      i = SkipSpace(rest_, SkipSpace(rest_, value_end) + 1);
+    }
+    return false;
+  }
+
+  void Scan(const std::string_view &s) noexcept {
+    using namespace json_scan;
+    valid_ = false;
+    size_ = 0;
+    std::size_t rest_begin = npos;
+    auto i = SkipSpace(s, 0);
+    if (i >= s.size() || s[i] != '{') return;
+    i = SkipSpace(s, i + 1);
+    if (i < s.size() && s[i] == '}') {
+      valid_ = true;
+      return;
+    }
+    while (i < s.size()) {
+      if (s[i] != '"') return;
+      if (size_ == kMaxFields && rest_begin == npos) rest_begin = i;
+      auto key_end = SkipString(s, i);
+      if (key_end == npos) return;
+      auto key = s.substr(i + 1, key_end - i - 2);
+      i = SkipSpace(s, key_end);
+      if (i >= s.size() || s[i] != ':') return;
+      i = SkipSpace(s, i + 1);
+      auto value_end = SkipValue(s, i);
+      if (value_end == npos) return;
+      if (size_ < kMaxFields)
+        fields_[size_++] = {key, s.substr(i, value_end - i)};
+      i = SkipSpace(s, value_end);
+      if (i >= s.size()) return;
+      if (s[i] == '}') {
+        valid_ = true;
+        if (rest_begin != npos) {
+          rest_ = s.substr(rest_begin, i - rest_begin);
+          static std::atomic<bool> warned{false};
+          if (!warned.exchange(true))
+            LOG_WARN("json对象的字段超过{}个，其余字段在查找时线性扫描: {}",
+                     kMaxFields, s.substr(0, 200));
+        }
+        return;
+      }
+      if (s[i] != ',') return;
+      i = SkipSpace(s, i + 1);
+    }
+  }
+
+ private:
+  bool valid_;
+  std::size_t size_;
+  std::array<Field, kMaxFields> fields_;
+  // 超出kMaxFields的字段，从第一个键开始，不含右括号
+  std::string_view rest_;
+};
+
+// 持有原始帧的事件视图，分发只读取需要的字段，
+// 只有真正有服务需要运行时才构造完整的Event
+class EventView {
+ public:
+  explicit EventView(std::string &&raw)
+      : raw_(std::move(raw)), root_(raw_), message_decoded_(false) {}
+
+ public:
+  const std::string &Raw() const noexcept { return raw_; }
+
+  const JsonObjectView &Root() const noexcept { return root_; }
+
+  bool Valid() const noexcept { return root_.Valid(); }
+
+  bool Contains(const std::string_view &key) const noexcept {
+    return root_.Contains(key);
+  }
+
+  std::string_view Raw(const std::string_view &key) const noexcept {
+    return root_.Raw(key);
+  }
+
+  bool IsNull(const std::string_view &key) const noexcept {
+    return root_.IsNull(key);
+  }
+
+  std::string_view GetString(const std::string_view &key) const noexcept {
+    return root_.GetString(key);
+  }
+
+  template <typename T = uint64_t>
+  T GetNumber(const std::string_view &key, T default_value = 0) const noexcept {
+    return root_.GetNumber<T>(key, default_value);
+  }
+
+  JsonObjectView GetObject(const std::string_view &key) const noexcept {
+    return root_.GetObject(key);
+  }
+
+  // 反转义后的message，只有含转义字符时才会分配
+  std::string_view Message() {
+    auto message = root_.GetString("message");
+    if (message.find('\\') == std::string_view::npos) return message;
+    if (!message_decoded_) {
+      message_ = json_scan::Unescape(message);
+      message_decoded_ = true;
+    }
+    return message_;
+  }
+
+  // 每次调用都重新解析，由调用方缓存
+  Event Parse() const { return Event::parse(raw_, nullptr, false); }
+
+ public:
+  EventView(const EventView &) = delete;
+  EventView &operator=(const EventView &) = delete;
+
+ private:
+  const std::string raw_;
+  const JsonObjectView root_;
+
+  bool message_decoded_;
+  std::string message_;
+};
+
+}  // namespace white
+
+#endif
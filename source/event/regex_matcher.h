@@ -1,41 +1,394 @@
 #ifndef MIGANGBOT_EVENT_EVENT_REGEX_MATCHER_H_
 #define MIGANGBOT_EVENT_EVENT_REGEX_MATCHER_H_
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
 #include <initializer_list>
+#include <memory>
+#include <string>
 #include <string_view>
 #include <vector>
 
-#include <jpcre2.hpp>
+#ifndef PCRE2_CODE_UNIT_WIDTH
+#define PCRE2_CODE_UNIT_WIDTH 8
+#endif
+#include <pcre2.h>
 
 #include "event/type.h"
+#include "logger/logger.h"
+#include "metrics/metrics.h"
 #include "service/triggered_service.h"
 
 namespace white {
 
-using jp = jpcre2::select<char>;
+namespace regex_literal {
 
+using Literals = std::vector<std::string>;
+
+// 量词的最小重复次数为0时返回true，pos移到量词之后
+inline bool SkipQuantifier(const std::string_view &p, std::size_t &pos,
+                           bool &has_quantifier) {
+  has_quantifier = false;
+  if (pos >= p.size()) return false;
+  bool optional = false;
+  switch (p[pos]) {
+    case '?':
+    case '*':
+      optional = true;
+      [[fallthrough]];
+    case '+':
+      ++pos;
+      break;
+    case '{': {
+      auto close = p.find('}', pos);
+      if (close == std::string_view::npos ||
+          !std::isdigit(static_cast<unsigned char>(p[pos + 1])))
+        return false;
+      optional = p[pos + 1] == '0' &&
+                 (p[pos + 2] == ',' || p[pos + 2] == '}');
+      pos = close + 1;
+    } break;
+    default:
+      return false;
+  }
+  has_quantifier = true;
+  // 懒惰/占有量词
+  if (pos < p.size() && (p[pos] == '?' || p[pos] == '+')) ++pos;
+  return optional;
+}
+
+// 返回与p[pos]配对的右括号位置
+inline std::size_t MatchParen(const std::string_view &p, std::size_t pos) {
+  int depth = 0;
+  for (; pos < p.size(); ++pos) {
+    if (p[pos] == '\\') {
+      ++pos;
+    } else if (p[pos] == '[') {
+      if (pos + 1 < p.size() && p[pos + 1] == ']') ++pos;
+      while (pos + 1 < p.size() && p[++pos] != ']')
+        if (p[pos] == '\\') ++pos;
+    } else if (p[pos] == '(') {
+      ++depth;
+    } else if (p[pos] == ')' && --depth == 0) {
+      return pos;
+    }
+  }
+  return std::string_view::npos;
+}
+
+// 在最外层按'|'切分
+inline std::vector<std::string_view> SplitAlternation(
+    const std::string_view &p) {
+  std::vector<std::string_view> branches;
+  std::size_t start = 0;
+  for (std::size_t pos = 0; pos < p.size(); ++pos) {
+    if (p[pos] == '\\') {
+      ++pos;
+    } else if (p[pos] == '(') {
+      auto close = MatchParen(p, pos);
+      if (close == std::string_view::npos) return {};
+      pos = close;
+    } else if (p[pos] == '[') {
+      if (pos + 1 < p.size() && p[pos + 1] == ']') ++pos;
+      while (pos + 1 < p.size() && p[++pos] != ']')
+        if (p[pos] == '\\') ++pos;
+    } else if (p[pos] == '|') {
+      branches.push_back(p.substr(start, pos - start));
+      start = pos + 1;
+    }
+  }
+  branches.push_back(p.substr(start));
+  return branches;
+}
+
+// 去掉末尾的一个(可能是多字节的)字符
+inline void PopChar(std::string &run) {
+  while (!run.empty() && (run.back() & 0xC0) == 0x80) run.pop_back();
+  if (!run.empty()) run.pop_back();
+}
+
+inline std::string Lower(std::string str) {
+  for (auto &ch : str) ch = std::tolower(static_cast<unsigned char>(ch));
+  return str;
+}
+
+inline Literals Extract(const std::string_view &pattern);
+
+// 单个分支中选出最长的必需字面量(或字面量分组)
+inline Literals ExtractBranch(const std::string_view &p) {
+  Literals best;
+  std::size_t best_size = 0;
+  std::string run;
+  auto commit = [&](Literals &&candidate) {
+    if (candidate.empty()) return;
+    std::size_t size = candidate.front().size();
+    for (const auto &literal : candidate)
+      size = std::min(size, literal.size());
+    if (size > best_size) {
+      best_size = size;
+      best = std::move(candidate);
+    }
+  };
+  auto flush = [&] {
+    if (!run.empty()) commit({Lower(std::move(run))});
+    run.clear();
+  };
+  bool has_quantifier;
+  for (std::size_t pos = 0; pos < p.size();) {
+    char ch = p[pos];
+    if (ch == '(') {
+      flush();
+      auto close = MatchParen(p, pos);
+      if (close == std::string_view::npos) return {};
+      auto inner = p.substr(pos + 1, close - pos - 1);
+      pos = close + 1;
+      bool optional = SkipQuantifier(p, pos, has_quantifier);
+      if (optional || inner.starts_with("?")) continue;
+      commit(Extract(inner));
+    } else if (ch == '[') {
+      flush();
+      if (pos + 1 < p.size() && p[pos + 1] == ']') ++pos;
+      while (pos + 1 < p.size() && p[++pos] != ']')
+        if (p[pos] == '\\') ++pos;
+      ++pos;
+      SkipQuantifier(p, pos, has_quantifier);
+    } else if (ch == '\\' && pos + 1 < p.size() &&
+               !std::isalnum(static_cast<unsigned char>(p[pos + 1]))) {
+      // 转义的标点是普通字符
+      run.push_back(p[pos + 1]);
+      pos += 2;
+      if (SkipQuantifier(p, pos, has_quantifier)) PopChar(run);
+      if (has_quantifier) flush();
+    } else if (ch == '\\' && pos + 1 < p.size() &&
+               std::isdigit(static_cast<unsigned char>(p[pos + 1])) &&
+               p[pos + 1] != '0') {
+      // 反向引用
+      flush();
+      for (++pos; pos < p.size() && std::isdigit(p[pos]);) ++pos;
+      SkipQuantifier(p, pos, has_quantifier);
+    } else if ((ch == '\\' && pos + 1 < p.size() &&
+                std::string_view{"dDwWsSbBAzZGhHvVRNntrfea"}.find(
+                    p[pos + 1]) != std::string_view::npos) ||
+               ch == '.' || ch == '^' || ch == '$') {
+      flush();
+      pos += ch == '\\' ? 2 : 1;
+      SkipQuantifier(p, pos, has_quantifier);
+    } else if (ch == '\\' ||
+               std::string_view{"*+?{}|)"}.find(ch) != std::string_view::npos) {
+      // \x \p \Q等较少见的写法不再继续分析，已得到的字面量仍然有效，
+      // 但前一个字符可能被{,n}之类的写法修饰
+      PopChar(run);
+      break;
+    } else {
+      run.push_back(ch);
+      ++pos;
+      // 多字节字符的量词作用于整个字符
+      while (pos < p.size() && (p[pos] & 0xC0) == 0x80) run.push_back(p[pos++]);
+      if (SkipQuantifier(p, pos, has_quantifier)) PopChar(run);
+      if (has_quantifier) flush();
+    }
+  }
+  flush();
+  return best;
+}
+
+// 返回正则能匹配时必然出现(忽略大小写)的字面量，出现其一即可；
+// 返回空表示无法提取，需要总是运行该正则
+inline Literals Extract(const std::string_view &pattern) {
+  // (*UTF)等动词和(?x)会改变整个pattern的解析方式
+  if (pattern.find("(*") != std::string_view::npos) return {};
+  for (auto pos = pattern.find("(?"); pos != std::string_view::npos;
+       pos = pattern.find("(?", pos + 2)) {
+    auto end = pattern.find_first_not_of(
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ-^", pos + 2);
+    if (pattern.substr(pos + 2, end - pos - 2).find('x') !=
+        std::string_view::npos)
+      return {};
+  }
+  auto branches = SplitAlternation(pattern);
+  if (branches.empty()) return {};
+  if (branches.size() == 1) return ExtractBranch(branches.front());
+  Literals literals;
+  for (const auto &branch : branches) {
+    auto branch_literals = ExtractBranch(branch);
+    if (branch_literals.empty()) return {};
+    for (auto &literal : branch_literals)
+      if (std::find(literals.begin(), literals.end(), literal) ==
+          literals.end())
+        literals.push_back(std::move(literal));
+  }
+  return literals;
+}
+
+}  // namespace regex_literal
+
+// 同一服务的多个pattern合并成一个分支重置的选择分支并JIT编译，
+// 用(*MARK)区分命中的是哪一个pattern。
+// 只在服务内合并而不跨服务合并：EventHandler先按群的启用状态与权限过滤服务，
+// 再运行其正则，跨服务合并后被禁用服务的pattern也要参与每次匹配。
+// 指标：hit按pattern统计；miss、skipped、time_us按服务统计，
+// 合并后一次匹配同时覆盖所有pattern，无法把耗时与未命中分摊到单个pattern
 class RegexMatcher {
  public:
   RegexMatcher(const std::initializer_list<std::string> &patterns,
-               std::shared_ptr<TriggeredService> service)
-      : service_(service) {
-    for (const auto &pattern : patterns)
-      regex_.push_back(jp::Regex(pattern, "mSi"));
-  }
+               std::shared_ptr<TriggeredService> service);
 
-  bool Check(const std::string &str) noexcept {
-    for (auto &re : regex_)
-      if (re.match(str)) return true;
-    return false;
-  }
+  RegexMatcher(RegexMatcher &&rhs) noexcept;
+
+  ~RegexMatcher();
+
+ public:
+  bool Check(const std::string_view &str) noexcept;
+
+  // 字面量预筛选未命中，未运行正则
+  void Skip() noexcept { skipped_.Add(); }
 
   const std::shared_ptr<TriggeredService> &GetService() const noexcept { return service_; }
 
+  // 任一pattern匹配时必然出现的小写字面量，为空表示无法预筛选
+  const regex_literal::Literals &GetLiterals() const noexcept {
+    return literals_;
+  }
+
+ public:
+  RegexMatcher(const RegexMatcher &) = delete;
+  RegexMatcher &operator=(const RegexMatcher &) = delete;
+
  private:
-  std::vector<jp::Regex> regex_;
+  static pcre2_code_8 *Compile(const std::string &pattern);
+
+  // 每个线程复用一块match_data，只需要知道是否匹配，不取捕获组
+  static pcre2_match_data_8 *GetMatchData();
+
+ private:
+  // 合并成功时只有一个元素，否则与pattern一一对应(编译失败的为nullptr)
+  std::vector<pcre2_code_8 *> codes_;
+  bool combined_;
+  regex_literal::Literals literals_;
   const std::shared_ptr<TriggeredService> service_;
+
+  std::vector<metrics::Metric *> hit_;
+  metrics::Metric &miss_;
+  metrics::Metric &skipped_;
+  metrics::Metric &time_us_;
 };
 
+inline RegexMatcher::RegexMatcher(
+    const std::initializer_list<std::string> &patterns,
+    std::shared_ptr<TriggeredService> service)
+    : combined_(false),
+      service_(service),
+      miss_(metrics::GetMetric("regex." + service_->GetServiceName() +
+                               ".miss")),
+      skipped_(metrics::GetMetric("regex." + service_->GetServiceName() +
+                                  ".skipped")),
+      time_us_(metrics::GetMetric("regex." + service_->GetServiceName() +
+                                  ".time_us")) {
+  bool always = false;
+  bool combinable = patterns.size() > 1;
+  std::string combined = "(?|";
+  for (const auto &pattern : patterns) {
+    auto index = std::to_string(codes_.size());
+    hit_.push_back(&metrics::GetMetric("regex." + service_->GetServiceName() +
+                                       "." + index + ".hit"));
+    codes_.push_back(Compile(pattern));
+    // \Q、注释和(*VERB)在拼接后可能吞掉右括号或失效
+    if (!codes_.back() || pattern.find("\\Q") != std::string::npos ||
+        pattern.find('#') != std::string::npos ||
+        pattern.find("(*") != std::string::npos)
+      combinable = false;
+    if (codes_.size() > 1) combined += '|';
+    combined += "(?:" + pattern + ")(*MARK:" + index + ")";
+
+    auto literals = regex_literal::Extract(pattern);
+    if (literals.empty()) always = true;
+    for (auto &literal : literals) literals_.push_back(std::move(literal));
+  }
+  if (always) literals_.clear();
+  if (!combinable) return;
+  combined += ')';
+  if (auto code = Compile(combined)) {
+    for (auto code : codes_) pcre2_code_free_8(code);
+    codes_.assign(1, code);
+    combined_ = true;
+  }
+}
+
+inline RegexMatcher::RegexMatcher(RegexMatcher &&rhs) noexcept
+    : codes_(std::move(rhs.codes_)),
+      combined_(rhs.combined_),
+      literals_(std::move(rhs.literals_)),
+      service_(rhs.service_),
+      hit_(std::move(rhs.hit_)),
+      miss_(rhs.miss_),
+      skipped_(rhs.skipped_),
+      time_us_(rhs.time_us_) {
+  rhs.codes_.clear();
+}
+
+inline RegexMatcher::~RegexMatcher() {
+  for (auto code : codes_)
+    if (code) pcre2_code_free_8(code);
+}
+
+inline pcre2_code_8 *RegexMatcher::Compile(const std::string &pattern) {
+  int error;
+  PCRE2_SIZE offset;
+  auto code = pcre2_compile_8(reinterpret_cast<PCRE2_SPTR8>(pattern.data()),
+                              pattern.size(), PCRE2_MULTILINE | PCRE2_CASELESS,
+                              &error, &offset, nullptr);
+  if (!code) {
+    PCRE2_UCHAR8 message[256];
+    pcre2_get_error_message_8(error, message, sizeof(message));
+    LOG_ERROR("正则[{}]编译失败: {} (位置{})", pattern,
+              reinterpret_cast<const char *>(message), offset);
+    return nullptr;
+  }
+  // JIT不可用时pcre2_match会退回解释执行
+  pcre2_jit_compile_8(code, PCRE2_JIT_COMPLETE);
+  return code;
+}
+
+inline pcre2_match_data_8 *RegexMatcher::GetMatchData() {
+  thread_local std::unique_ptr<pcre2_match_data_8,
+                               decltype(&pcre2_match_data_free_8)>
+      match_data(pcre2_match_data_create_8(1, nullptr),
+                 &pcre2_match_data_free_8);
+  return match_data.get();
+}
+
+inline bool RegexMatcher::Check(const std::string_view &str) noexcept {
+  auto start = std::chrono::steady_clock::now();
+  auto match_data = GetMatchData();
+  auto subject = reinterpret_cast<PCRE2_SPTR8>(str.data());
+  int matched = -1;
+  for (std::size_t i = 0; i < codes_.size() && matched < 0; ++i) {
+    if (!codes_[i]) continue;
+    // 返回0表示匹配成功但ovector不够存放捕获组
+    if (pcre2_match_8(codes_[i], subject, str.size(), 0, 0, match_data,
+                      nullptr) < 0)
+      continue;
+    matched = i;
+    if (!combined_) break;
+    if (auto mark = pcre2_get_mark_8(match_data)) {
+      auto name = reinterpret_cast<const char *>(mark);
+      std::from_chars(name, name + std::char_traits<char>::length(name),
+                      matched);
+    }
+  }
+  time_us_.Add(std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count());
+  if (matched < 0) {
+    miss_.Add();
+    return false;
+  }
+  if (static_cast<std::size_t>(matched) < hit_.size()) hit_[matched]->Add();
+  return true;
+}
+
 }  // namespace white
 
-#endif
\ No newline at end of file
+#endif
@@ -2,22 +2,25 @@
 #define MIGANGBOT_EVENT_TRIE_H_
 
 #include <algorithm>
-#include <cctype>
-#include <functional>
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
 #include <string_view>
-#include <type_traits>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <nlohmann/json.hpp>
 
 #include "bot/onebot_11/api_bot.h"
+#include "event/case_fold.h"
 #include "service/triggered_service.h"
 #include "event/type.h"
 
 namespace white {
 
+// 节点与边都存放在连续数组中，每个节点的出边按字节有序，查找时二分；
+// 键先做UTF-8大小写折叠再按字节存储
 class Trie {
  public:
   Trie();
@@ -30,139 +33,180 @@ class Trie {
   bool InsertFromBack(const std::string &key,
                       std::shared_ptr<TriggeredService> service) noexcept;
 
+  std::size_t Size() const noexcept { return keys_.size(); }
+
   const std::shared_ptr<TriggeredService> &ShortestPrefix(
-      const std::string &key, Event &event) const noexcept;
+      const std::string_view &key, int &command_size) const noexcept;
 
   const std::shared_ptr<TriggeredService> &LongestPrefix(
-      const std::string &key, Event &event) const noexcept;
+      const std::string_view &key, int &command_size) const noexcept;
 
   const std::shared_ptr<TriggeredService> &LongestSuffix(
-      const std::string &key, Event &event) const noexcept;
+      const std::string_view &key, int &command_size) const noexcept;
 
   const std::shared_ptr<TriggeredService> &ShortestSuffix(
-      const std::string &key, Event &event) const noexcept;
+      const std::string_view &key, int &command_size) const noexcept;
 
  private:
-  struct TrieNode {
-    std::unordered_map<char, std::unique_ptr<TrieNode>> childs_;
-    std::shared_ptr<TriggeredService> service_;
-    std::size_t command_size_;
+  struct Node {
+    uint32_t first_edge;
+    uint32_t edge_count;
+    // services_的下标，-1表示该节点不是某个键的结尾
+    int32_t service;
+    // 前缀为正，后缀为负
+    int command_size;
+  };
+
+  struct Entry {
+    std::shared_ptr<TriggeredService> service;
+    int command_size;
   };
 
  private:
-  template <bool Is_From_Back, typename It>
-  bool InsertImpl(It &&start, It &&end,
+  bool InsertImpl(std::string &&folded, const int command_size,
                   std::shared_ptr<TriggeredService> &&service) noexcept;
 
-  template <typename It>
-  const std::shared_ptr<TriggeredService> &ShortestSearchImpl(
-      It &&start, It &&end, Event &event) const noexcept;
+  // 注册只发生在启动时，每次插入后重新压平，查找期间结构不再变化
+  void Rebuild();
 
-  template <typename It>
-  const std::shared_ptr<TriggeredService> &LongestSearchImpl(
-      It &&start, It &&end, Event &event) const noexcept;
+  int Child(const Node &node, const unsigned char ch) const noexcept;
+
+  template <bool Is_Longest, bool Is_From_Back>
+  const std::shared_ptr<TriggeredService> &SearchImpl(
+      const std::string_view &key, int &command_size) const noexcept;
 
  private:
-  const std::unique_ptr<TrieNode> root_;
+  // 折叠(后缀为逆序)后的键
+  std::map<std::string, Entry> keys_;
+
+  std::vector<Node> nodes_;
+  std::vector<unsigned char> edge_label_;
+  std::vector<uint32_t> edge_target_;
+  std::vector<std::shared_ptr<TriggeredService>> services_;
+
   const std::shared_ptr<TriggeredService> empty_;
 };
 
-inline Trie::Trie() : root_(std::make_unique<TrieNode>()) {}
+inline Trie::Trie() { Rebuild(); }
 
 inline Trie::~Trie() {}
 
-template <bool Is_From_Back, typename It>
 inline bool Trie::InsertImpl(
-    It &&start, It &&end,
+    std::string &&folded, const int command_size,
     std::shared_ptr<TriggeredService> &&service) noexcept {
-  auto cur_node = root_.get();
-  auto command_size = end - start;
-  char ch;
-  while (start != end) {
-    ch = std::tolower(*start);
-    if (!cur_node->childs_.count(ch))
-      cur_node->childs_.emplace(ch, std::make_unique<TrieNode>());
-    cur_node = cur_node->childs_.at(ch).get();
-    ++start;
-  }
-  if (cur_node->service_) return false;
-  cur_node->service_ = std::move(service);
-  if constexpr (Is_From_Back)
-    cur_node->command_size_ = -command_size;
-  else
-    cur_node->command_size_ = command_size;
+  if (!keys_.emplace(std::move(folded), Entry{std::move(service), command_size})
+           .second)
+    return false;
+  Rebuild();
   return true;
 }
 
 inline bool Trie::Insert(const std::string &key,
                          std::shared_ptr<TriggeredService> service) noexcept {
-  return InsertImpl<false>(key.begin(), key.end(), std::move(service));
+  return InsertImpl(case_fold::Fold(key), key.size(), std::move(service));
 }
 
 inline bool Trie::InsertFromBack(
     const std::string &key,
     std::shared_ptr<TriggeredService> service) noexcept {
-  return InsertImpl<true>(key.rbegin(), key.rend(), std::move(service));
+  auto folded = case_fold::Fold(key);
+  std::reverse(folded.begin(), folded.end());
+  return InsertImpl(std::move(folded), -static_cast<int>(key.size()),
+                    std::move(service));
 }
 
-template <typename It>
-inline const std::shared_ptr<TriggeredService> &Trie::ShortestSearchImpl(
-    It &&start, It &&end, Event &event) const noexcept {
-  auto cur_node = root_.get();
-  char ch;
-  while (start != end) {
-    ch = std::tolower(*start);
-    if (!cur_node->childs_.count(ch)) return empty_;
-    cur_node = cur_node->childs_.at(ch).get();
-    if (cur_node->service_) {
-      event["__command_size__"] = cur_node->command_size_;
-      return cur_node->service_;
+inline void Trie::Rebuild() {
+  nodes_.assign(1, Node{0, 0, -1, 0});
+  edge_label_.clear();
+  edge_target_.clear();
+  services_.clear();
+  // keys_有序，同一前缀的键相邻，每个节点对应其中连续的一段；
+  // 按层展开，一个节点的出边一次性写入，因此连续且按字节有序
+  struct Pending {
+    uint32_t node;
+    std::map<std::string, Entry>::const_iterator begin, end;
+    std::size_t depth;
+  };
+  std::vector<Pending> queue{{0, keys_.begin(), keys_.end(), 0}};
+  for (std::size_t q = 0; q < queue.size(); ++q) {
+    auto [index, it, end, depth] = queue[q];
+    if (it != end && it->first.size() == depth) {
+      nodes_[index].service = services_.size();
+      nodes_[index].command_size = it->second.command_size;
+      services_.push_back(it->second.service);
+      ++it;
+    }
+    nodes_[index].first_edge = edge_label_.size();
+    while (it != end) {
+      auto label = static_cast<unsigned char>(it->first[depth]);
+      auto child_end = it;
+      while (child_end != end &&
+             static_cast<unsigned char>(child_end->first[depth]) == label)
+        ++child_end;
+      edge_label_.push_back(label);
+      edge_target_.push_back(nodes_.size());
+      queue.push_back({static_cast<uint32_t>(nodes_.size()), it, child_end,
+                       depth + 1});
+      nodes_.push_back(Node{0, 0, -1, 0});
+      it = child_end;
     }
-    ++start;
+    nodes_[index].edge_count = edge_label_.size() - nodes_[index].first_edge;
   }
-  return empty_;
 }
 
-inline const std::shared_ptr<TriggeredService> &Trie::ShortestPrefix(
-    const std::string &key, Event &event) const noexcept {
-  return ShortestSearchImpl(key.begin(), key.end(), event);
+inline int Trie::Child(const Node &node,
+                       const unsigned char ch) const noexcept {
+  auto begin = edge_label_.begin() + node.first_edge;
+  auto end = begin + node.edge_count;
+  auto it = std::lower_bound(begin, end, ch);
+  if (it == end || *it != ch) return -1;
+  return edge_target_[it - edge_label_.begin()];
 }
 
-inline const std::shared_ptr<TriggeredService> &Trie::ShortestSuffix(
-    const std::string &key, Event &event) const noexcept {
-  return ShortestSearchImpl(key.rbegin(), key.rend(), event);
+template <bool Is_Longest, bool Is_From_Back>
+inline const std::shared_ptr<TriggeredService> &Trie::SearchImpl(
+    const std::string_view &key, int &command_size) const noexcept {
+  const Node *cur = &nodes_[0];
+  const Node *found = nullptr;
+  auto step = [&](unsigned char ch) {
+    auto child = Child(*cur, ch);
+    if (child < 0) return false;
+    cur = &nodes_[child];
+    if (cur->service >= 0) {
+      found = cur;
+      if constexpr (!Is_Longest) return false;
+    }
+    return true;
+  };
+  if constexpr (Is_From_Back)
+    case_fold::ForEachByteReverse(key, step);
+  else
+    case_fold::ForEachByte(key, step);
+  if (!found) return empty_;
+  command_size = found->command_size;
+  return services_[found->service];
 }
 
-template <typename It>
-inline const std::shared_ptr<TriggeredService> &Trie::LongestSearchImpl(
-    It &&start, It &&end, Event &event) const noexcept {
-  auto cur_node = root_.get();
-  char ch;
-  TrieNode *pre{nullptr};
-  while (start != end) {
-    ch = std::tolower(*start);
-    if (!cur_node->childs_.count(ch)) break;
-    cur_node = cur_node->childs_.at(ch).get();
-    if (cur_node->service_) pre = cur_node;
-    ++start;
-  }
-  if (pre) {
-    event["__command_size__"] = pre->command_size_;
-    return pre->service_;
-  }
-  return empty_;
+inline const std::shared_ptr<TriggeredService> &Trie::ShortestPrefix(
+    const std::string_view &key, int &command_size) const noexcept {
+  return SearchImpl<false, false>(key, command_size);
+}
+
+inline const std::shared_ptr<TriggeredService> &Trie::ShortestSuffix(
+    const std::string_view &key, int &command_size) const noexcept {
+  return SearchImpl<false, true>(key, command_size);
 }
 
 inline const std::shared_ptr<TriggeredService> &Trie::LongestPrefix(
-    const std::string &key, Event &event) const noexcept {
-  return LongestSearchImpl(key.begin(), key.end(), event);
+    const std::string_view &key, int &command_size) const noexcept {
+  return SearchImpl<true, false>(key, command_size);
 }
 
 inline const std::shared_ptr<TriggeredService> &Trie::LongestSuffix(
-    const std::string &key, Event &event) const noexcept {
-  return LongestSearchImpl(key.rbegin(), key.rend(), event);
+    const std::string_view &key, int &command_size) const noexcept {
+  return SearchImpl<true, true>(key, command_size);
 }
 
 }  // namespace white
 
-#endif
\ No newline at end of file
+#endif
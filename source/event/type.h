@@ -1,6 +1,11 @@
 #ifndef MIGANGBOT_EVENT_TYPE_H_
 #define MIGANGBOT_EVENT_TYPE_H_
 
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
 #include "event/event.h"
 
 namespace white {
@@ -11,6 +16,18 @@ constexpr auto SUFFIX = 2;
 constexpr auto KEYWORD = 3;
 constexpr auto ALLMSG = 4;
 
+// 支持以string_view直接查找，避免构造临时的std::string
+struct StringHash {
+  using is_transparent = void;
+  std::size_t operator()(const std::string_view &s) const noexcept {
+    return std::hash<std::string_view>{}(s);
+  }
+};
+
+template <typename T>
+using StringMap =
+    std::unordered_map<std::string, T, StringHash, std::equal_to<>>;
+
 }  // namespace white
 
 #endif
\ No newline at end of file
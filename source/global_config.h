@@ -26,6 +26,23 @@ extern std::unordered_set<QId> WHITE_LIST;
 
 extern std::filesystem::path kAssetsDir;
 
+// 每个连接的事件队列长度与处理协程数
+extern std::size_t EVENT_QUEUE_SIZE;
+
+extern std::size_t EVENT_WORKERS;
+
+// 渲染线程数，0表示取CPU核数的一半
+extern std::size_t RENDER_WORKERS;
+
+// 渲染缓存的内存上限(MB)，0表示64MB；是否同时缓存到磁盘
+extern std::size_t RENDER_CACHE_MB;
+
+extern bool RENDER_CACHE_DISK;
+
+// 生成图片的发送方式：为空时内联为base64；为file时发送本地文件路径；
+// 否则为机器人http服务的地址，图片以<地址>/img/<哈希>.jpg的url发送
+extern std::string IMAGE_BASE_URL;
+
 inline std::filesystem::path AssetsPath(const std::string &path) {
   auto r_path = kAssetsDir / path;
   if(!std::filesystem::exists(r_path))
@@ -30,6 +30,12 @@ std::filesystem::path white::config::kServiceDir;
 std::string white::config::BOT_NAME;
 std::unordered_set<white::QId> white::config::SUPERUSERS;
 std::unordered_set<white::QId> white::config::WHITE_LIST;
+std::size_t white::config::EVENT_QUEUE_SIZE;
+std::size_t white::config::EVENT_WORKERS;
+std::size_t white::config::RENDER_WORKERS;
+std::size_t white::config::RENDER_CACHE_MB;
+bool white::config::RENDER_CACHE_DISK;
+std::string white::config::IMAGE_BASE_URL;
 
 constexpr auto kGlobalConfigExample =
     "Server:\n"
@@ -37,6 +43,10 @@ constexpr auto kGlobalConfigExample =
     "  Port: 8080\n"
     "  Log_path: logs/MigangBot.log     # the log path\n"
     "  Log_level: INFO\n"
+    "  # 图片的发送方式，留空则以base64内联在消息中(客户端在其他主机时使用)；\n"
+    "  # file表示发送本地文件路径(客户端与机器人在同一主机)；\n"
+    "  # 或填写客户端能访问到的本服务地址，如http://127.0.0.1:8080\n"
+    "  ImageBaseUrl: \"\"\n"
     "\n"
     "Bot:\n"
     "  Name: <YOUR_BOT_NAME>            # 机器人名字\n"
@@ -54,10 +64,22 @@ constexpr auto kGlobalConfigExample =
     "  Host: 127.0.0.1\n"
     "  Port: 6379\n"
     "\n"
+    "# 服务的并发限制，未列出的服务不受限制\n"
+    "Services: {}\n"
+    "#  天气:\n"
+    "#    MaxConcurrency: 2              # 同时执行的调用数\n"
+    "#    QueueLimit: 8                  # 超出后排队的调用数，再多则拒绝\n"
+    "#    RejectReply: 忙不过来了，请稍后再试  # 拒绝时的回复，留空则不回复\n"
+    "\n"
     "# 不懂就不改，0表示默认值\n"
     "Dev:\n"
     "  SqlPool: 5                       # 数据库连接池连接数\n"
-    "  RedisPool: 5                     # Redis连接池连接数";
+    "  RedisPool: 5                     # Redis连接池连接数\n"
+    "  EventQueue: 0                    # 每个连接的事件队列长度\n"
+    "  EventWorkers: 0                  # 每个连接处理事件的协程数\n"
+    "  RenderWorkers: 0                 # 图片渲染线程数\n"
+    "  RenderCacheMB: 0                 # 渲染缓存的内存上限(MB)\n"
+    "  RenderCacheDisk: false           # 渲染缓存是否同时写入磁盘";
 
 int main(int argc, char** argv) {
   hlog_disable();
@@ -133,6 +155,7 @@ int main(int argc, char** argv) {
       white::global_config["Dev"]["RedisPool"].as<std::size_t>());
   // 初始化模块
   white::module::InitModuleList();
+  white::EventHandler::GetInstance().Compile();
 
   // 加载全局配置
   white::config::BOT_NAME =
@@ -145,6 +168,24 @@ int main(int argc, char** argv) {
   for (std::size_t i = 0; i < whitelist_yaml_node.size(); ++i)
     white::config::WHITE_LIST.insert(whitelist_yaml_node[i].as<white::QId>());
 
+  white::config::EVENT_QUEUE_SIZE =
+      white::global_config["Dev"]["EventQueue"].as<std::size_t>(0);
+  if (white::config::EVENT_QUEUE_SIZE == 0)
+    white::config::EVENT_QUEUE_SIZE = 1024;
+  white::config::EVENT_WORKERS =
+      white::global_config["Dev"]["EventWorkers"].as<std::size_t>(0);
+  if (white::config::EVENT_WORKERS == 0) white::config::EVENT_WORKERS = 4;
+  white::config::RENDER_WORKERS =
+      white::global_config["Dev"]["RenderWorkers"].as<std::size_t>(0);
+  white::config::IMAGE_BASE_URL =
+      white::global_config["Server"]["ImageBaseUrl"].as<std::string>("");
+  while (white::config::IMAGE_BASE_URL.ends_with('/'))
+    white::config::IMAGE_BASE_URL.pop_back();
+  white::config::RENDER_CACHE_MB =
+      white::global_config["Dev"]["RenderCacheMB"].as<std::size_t>(0);
+  white::config::RENDER_CACHE_DISK =
+      white::global_config["Dev"]["RenderCacheDisk"].as<bool>(false);
+
   white::LOG_INFO("MigangBot已初始化");
   white::LOG_INFO("监听地址: {}:{}", address, port);
 
@@ -0,0 +1,234 @@
+#ifndef MIGANGBOT_MESSAGE_CQ_CODE_H_
+#define MIGANGBOT_MESSAGE_CQ_CODE_H_
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "message/escape.h"
+
+namespace white {
+namespace message {
+
+enum class SegmentType : uint8_t {
+  kText,
+  kAt,
+  kImage,
+  kReply,
+  kFace,
+  kRecord,
+  kJson,
+  kOther
+};
+
+inline SegmentType ToSegmentType(const std::string_view &name) noexcept {
+  if (name == "at") return SegmentType::kAt;
+  if (name == "image") return SegmentType::kImage;
+  if (name == "reply") return SegmentType::kReply;
+  if (name == "face") return SegmentType::kFace;
+  if (name == "record") return SegmentType::kRecord;
+  if (name == "json") return SegmentType::kJson;
+  return SegmentType::kOther;
+}
+
+// 消息中的一段，所有字符串都指向原始消息，保持转义后的形式，
+// 需要原文时再用Unescape解码；原始消息必须比Segment活得久
+struct Segment {
+  SegmentType type = SegmentType::kText;
+  // CQ码的类型名，纯文本时为空
+  std::string_view name;
+  // 纯文本时为文本内容，CQ码时为参数列表(k1=v1,k2=v2)
+  std::string_view data;
+
+  // 查找CQ码参数，不存在时返回nullopt
+  std::optional<std::string_view> Get(const std::string_view &key) const;
+
+  template <typename T = uint64_t>
+  T Number(const std::string_view &key, T default_value = 0) const;
+};
+
+inline std::optional<std::string_view> Segment::Get(
+    const std::string_view &key) const {
+  if (type == SegmentType::kText) return std::nullopt;
+  std::string_view rest = data;
+  while (!rest.empty()) {
+    auto end = std::min(rest.find(','), rest.size());
+    auto param = rest.substr(0, end);
+    if (param.size() > key.size() && param[key.size()] == '=' &&
+        param.starts_with(key))
+      return param.substr(key.size() + 1);
+    rest.remove_prefix(std::min(end + 1, rest.size()));
+  }
+  return std::nullopt;
+}
+
+template <typename T>
+inline T Segment::Number(const std::string_view &key, T default_value) const {
+  auto value = Get(key);
+  if (!value) return default_value;
+  T ret = default_value;
+  auto [ptr, ec] =
+      std::from_chars(value->data(), value->data() + value->size(), ret);
+  if (ec != std::errc() || ptr != value->data() + value->size())
+    return default_value;
+  return ret;
+}
+
+// 逐段切分CQ码字符串，不复制也不分配内存。
+// CQ码内的[ ] ,都已转义，第一个']'即为结束；没有闭合的"[CQ:"视为文本
+class Tokenizer {
+ public:
+  explicit Tokenizer(const std::string_view &message) noexcept
+      : rest_(message) {}
+
+  std::optional<Segment> Next() noexcept;
+
+  // 尚未切分的部分
+  std::string_view Rest() const noexcept { return rest_; }
+
+ private:
+  std::string_view rest_;
+};
+
+inline std::optional<Segment> Tokenizer::Next() noexcept {
+  if (rest_.empty()) return std::nullopt;
+  if (rest_.starts_with("[CQ:")) {
+    auto end = rest_.find(']');
+    if (end != std::string_view::npos) {
+      auto body = rest_.substr(4, end - 4);
+      auto comma = std::min(body.find(','), body.size());
+      Segment segment;
+      segment.name = body.substr(0, comma);
+      segment.type = ToSegmentType(segment.name);
+      segment.data = body.substr(std::min(comma + 1, body.size()));
+      rest_.remove_prefix(end + 1);
+      return segment;
+    }
+    Segment segment{SegmentType::kText, {}, rest_};
+    rest_ = {};
+    return segment;
+  }
+  // 跳过开头，避免把未闭合的"[CQ:"再次当作文本的起点
+  auto end = std::min(rest_.find("[CQ:", 1), rest_.size());
+  Segment segment{SegmentType::kText, {}, rest_.substr(0, end)};
+  rest_.remove_prefix(end);
+  return segment;
+}
+
+// 小容量的段列表，常见消息只有几段，不超过kInline时不在堆上分配
+class Segments {
+ public:
+  static constexpr std::size_t kInline = 8;
+
+  void push_back(const Segment &segment) {
+    if (heap_.empty() && size_ < kInline) {
+      inline_[size_++] = segment;
+      return;
+    }
+    if (heap_.empty()) heap_.assign(inline_.begin(), inline_.end());
+    heap_.push_back(segment);
+    ++size_;
+  }
+
+  const Segment *begin() const noexcept {
+    return heap_.empty() ? inline_.data() : heap_.data();
+  }
+  const Segment *end() const noexcept { return begin() + size_; }
+
+  const Segment &operator[](const std::size_t i) const noexcept {
+    return begin()[i];
+  }
+
+  std::size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+ private:
+  std::array<Segment, kInline> inline_;
+  std::vector<Segment> heap_;
+  std::size_t size_ = 0;
+};
+
+inline Segments Parse(const std::string_view &message) {
+  Segments segments;
+  Tokenizer tokenizer(message);
+  while (auto segment = tokenizer.Next()) segments.push_back(*segment);
+  return segments;
+}
+
+// 只保留文本段并反转义，追加到out
+inline void AppendPlainText(std::string &out, const std::string_view &message) {
+  Tokenizer tokenizer(message);
+  while (auto segment = tokenizer.Next())
+    if (segment->type == SegmentType::kText) UnescapeTo(out, segment->data);
+}
+
+// 按段拼接消息，全部写入同一个预留好的字符串；文本与参数在写入时转义
+class Builder {
+ public:
+  explicit Builder(const std::size_t reserve = 256) { buf_.reserve(reserve); }
+
+  Builder &Text(const std::string_view &text) {
+    EscapeTo(buf_, text, false);
+    return *this;
+  }
+
+  // 已是CQ码格式的内容，原样写入
+  Builder &Raw(const std::string_view &raw) {
+    buf_.append(raw);
+    return *this;
+  }
+
+  template <typename T>
+  Builder &At(const T qq) {
+    return Number("[CQ:at,qq=", qq);
+  }
+
+  template <typename T>
+  Builder &Reply(const T message_id) {
+    return Number("[CQ:reply,id=", message_id);
+  }
+
+  template <typename T>
+  Builder &Face(const T id) {
+    return Number("[CQ:face,id=", id);
+  }
+
+  Builder &Image(const std::string_view &file) {
+    buf_.append("[CQ:image,file=");
+    EscapeTo(buf_, file);
+    buf_.push_back(']');
+    return *this;
+  }
+
+  const std::string &Str() const noexcept { return buf_; }
+
+  // 取走拼好的消息，之后Builder为空
+  std::string Build() { return std::move(buf_); }
+
+ private:
+  // 只有一个整数参数的CQ码，head含到'='为止
+  template <typename T>
+  Builder &Number(const std::string_view &head, const T value) {
+    char digits[24];
+    auto [ptr, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+    buf_.append(head);
+    buf_.append(digits, ptr);
+    buf_.push_back(']');
+    return *this;
+  }
+
+ private:
+  std::string buf_;
+};
+
+}  // namespace message
+}  // namespace white
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef MIGANGBOT_MESSAGE_ESCAPE_H_
+#define MIGANGBOT_MESSAGE_ESCAPE_H_
+
+#include <cstddef>
+#include <cstring>
+
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace white {
+namespace message {
+
+// CQ码的转义: & [ ] 以及CQ码参数中的逗号。
+// 转义与反转义都只扫描一遍，没有需要处理的字符时直接整段复制；
+// xxxTo版本追加到调用方的缓冲区，反复使用同一个缓冲区时不再分配内存
+
+namespace escape_detail {
+
+constexpr auto npos = std::string_view::npos;
+
+inline bool IsSpecial(const char ch, const bool comma) noexcept {
+  return ch == '&' || ch == '[' || ch == ']' || (comma && ch == ',');
+}
+
+// 返回从pos开始第一个需要转义的字符位置，没有时返回npos
+inline std::size_t FindSpecial(const std::string_view &str, std::size_t pos,
+                               const bool comma) noexcept {
+  const auto *data = str.data();
+  const auto size = str.size();
+#if defined(__SSE2__)
+  const auto amp = _mm_set1_epi8('&');
+  const auto left = _mm_set1_epi8('[');
+  const auto right = _mm_set1_epi8(']');
+  // 不转义逗号时用'&'占位，比较结果不变
+  const auto sep = _mm_set1_epi8(comma ? ',' : '&');
+  for (; pos + 16 <= size; pos += 16) {
+    auto chunk =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+    auto hit = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, amp), _mm_cmpeq_epi8(chunk, left)),
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, right),
+                     _mm_cmpeq_epi8(chunk, sep)));
+    if (auto mask = _mm_movemask_epi8(hit)) return pos + __builtin_ctz(mask);
+  }
+#endif
+  for (; pos < size; ++pos)
+    if (IsSpecial(data[pos], comma)) return pos;
+  return npos;
+}
+
+// pos处为'&'，是CQ码转义时返回对应的字符，否则返回0
+inline char EntityAt(const std::string_view &str,
+                     const std::size_t pos) noexcept {
+  if (str.size() - pos < 5 || str[pos + 4] != ';') return 0;
+  const auto *p = str.data() + pos + 1;
+  if (p[0] == 'a') return p[1] == 'm' && p[2] == 'p' ? '&' : 0;
+  if (p[0] != '#') return 0;
+  if (p[1] == '9') return p[2] == '1' ? '[' : p[2] == '3' ? ']' : 0;
+  return p[1] == '4' && p[2] == '4' ? ',' : 0;
+}
+
+inline const char *Entity(const char ch) noexcept {
+  switch (ch) {
+    case '&':
+      return "&amp;";
+    case '[':
+      return "&#91;";
+    case ']':
+      return "&#93;";
+    default:
+      return "&#44;";
+  }
+}
+
+}  // namespace escape_detail
+
+// 将str转义后追加到out
+inline void EscapeTo(std::string &out, const std::string_view &str,
+                     const bool escape_comma = true) {
+  using namespace escape_detail;
+  auto pos = FindSpecial(str, 0, escape_comma);
+  if (pos == npos) {
+    out.append(str);
+    return;
+  }
+  // 每个转义多占4个字节，按少量转义预留，多数消息不需要再扩容
+  out.reserve(out.size() + str.size() + 16);
+  std::size_t start = 0;
+  do {
+    out.append(str.data() + start, pos - start);
+    out.append(Entity(str[pos]), 5);
+    start = pos + 1;
+    pos = FindSpecial(str, start, escape_comma);
+  } while (pos != npos);
+  out.append(str.data() + start, str.size() - start);
+}
+
+inline std::string Escape(const std::string_view &str,
+                          const bool escape_comma = true) {
+  std::string ret;
+  EscapeTo(ret, str, escape_comma);
+  return ret;
+}
+
+// 将str反转义后追加到out
+inline void UnescapeTo(std::string &out, const std::string_view &str) {
+  using namespace escape_detail;
+  out.reserve(out.size() + str.size());
+  std::size_t start = 0;
+  for (auto pos = str.find('&'); pos != npos; pos = str.find('&', pos)) {
+    if (auto ch = EntityAt(str, pos)) {
+      out.append(str.data() + start, pos - start);
+      out.push_back(ch);
+      start = pos += 5;
+    } else {
+      ++pos;
+    }
+  }
+  out.append(str.data() + start, str.size() - start);
+}
+
+inline std::string Unescape(const std::string_view &str) {
+  std::string ret;
+  UnescapeTo(ret, str);
+  return ret;
+}
+
+// 反转义只会缩短字符串，原地完成，不分配内存
+inline void UnescapeInPlace(std::string &str) noexcept {
+  using namespace escape_detail;
+  auto *data = str.data();
+  const auto size = str.size();
+  const std::string_view view{data, size};
+  auto read = view.find('&');
+  if (read == npos) return;
+  auto write = read;
+  while (read < size) {
+    if (data[read] == '&')
+      if (auto ch = EntityAt(view, read)) {
+        data[write++] = ch;
+        read += 5;
+        continue;
+      }
+    // 写入位置总在读取位置之前，尚未读取的部分不会被覆盖
+    auto end = view.find('&', read + 1);
+    if (end == npos) end = size;
+    std::memmove(data + write, data + read, end - read);
+    write += end - read;
+    read = end;
+  }
+  str.resize(write);
+}
+
+}  // namespace message
+}  // namespace white
+
+#endif
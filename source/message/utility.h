@@ -13,35 +13,22 @@
 #include <vector>
 
 #include <base64.h>
-#include <opencv2/imgproc/imgproc_c.h>
 #include <opencv2/core.hpp>
-#include <opencv2/freetype.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
 
+#include "co_future.h"
 #include "event/event.h"
 #include "global_config.h"
+#include "message/cq_code.h"
+#include "message/escape.h"
+#include "tools/font_service.h"
+#include "tools/image_store.h"
+#include "tools/render_cache.h"
 
 namespace white {
 namespace message {
 
-inline std::string Escape(const std::string &str,
-                          bool escape_comma = true) noexcept {
-  auto ret = std::regex_replace(str, std::regex("&"), "&amp;");
-  ret = std::regex_replace(ret, std::regex("["), "&#91;");
-  ret = std::regex_replace(ret, std::regex("]"), "&#93;");
-  if (escape_comma) ret = std::regex_replace(ret, std::regex(","), "&#44;");
-  return ret;
-}
-
-inline std::string Unescape(const std::string &str) noexcept {
-  auto ret = std::regex_replace(str, std::regex("&#44;"), ",");
-  ret = std::regex_replace(ret, std::regex("&#91;"), "[");
-  ret = std::regex_replace(ret, std::regex("&#93;"), "]");
-  ret = std::regex_replace(ret, std::regex("&amp;"), "&");
-  return ret;
-}
-
 inline std::vector<std::string> Split(const std::string_view &view,
                                       const std::string &delimiter) noexcept {
   std::size_t pos = 0;
@@ -55,18 +42,32 @@ inline std::vector<std::string> Split(const std::string_view &view,
 }
 
 inline std::string ExtraPlainText(const Event &event) noexcept {
-  auto msg_raw_str = event["message"].get<std::string>();
-  msg_raw_str = Unescape(msg_raw_str);
-  std::string_view view{msg_raw_str};
+  auto msg = event["message"].get<std::string>();
+  UnescapeInPlace(msg);
   if (event.contains("__command_size__")) {
     auto command_size = event["__command_size__"].get<short>();
-    if (command_size == 0) return std::string(view);
     if (command_size > 0)
-      view.remove_prefix(command_size);
-    else
-      view.remove_suffix(-command_size);
+      msg.erase(0, std::min<std::size_t>(command_size, msg.size()));
+    else if (command_size < 0)
+      msg.resize(msg.size() - std::min<std::size_t>(-command_size, msg.size()));
   }
-  return std::string(view);
+  return msg;
+}
+
+// 与ExtraPlainText相同，但去掉其中的CQ码，只保留文字
+inline std::string ExtraText(const Event &event) noexcept {
+  const auto &msg = event["message"].get_ref<const std::string &>();
+  std::string_view view{msg};
+  if (event.contains("__command_size__")) {
+    auto command_size = event["__command_size__"].get<short>();
+    if (command_size > 0)
+      view.remove_prefix(std::min<std::size_t>(command_size, view.size()));
+    else if (command_size < 0)
+      view.remove_suffix(std::min<std::size_t>(-command_size, view.size()));
+  }
+  std::string ret;
+  AppendPlainText(ret, view);
+  return ret;
 }
 
 inline void ExtraPlainText(std::string_view &str) noexcept {
@@ -111,38 +112,39 @@ inline std::string Strip(const std::string &str, char ch = ' ') noexcept {
 
 }  // namespace message
 
-// https://stackoverflow.com/questions/29772271/c-opencv-convert-mat-to-base64-and-vice-versa
-inline std::string ImageTobase64(const cv::Mat &image) {
+// 图片消息中file字段的内容，按config::IMAGE_BASE_URL内联为base64，
+// 或存入ImageStore后给出文件路径/http url，避免在websocket帧中传输整张图片
+inline std::string EncodeImage(const cv::Mat &image) {
   std::vector<uchar> buf;
   cv::imencode(".jpg", image, buf);
-  auto *enc_msg = reinterpret_cast<unsigned char *>(buf.data());
-  return "base64://" + base64_encode(enc_msg, buf.size());
+  if (!config::IMAGE_BASE_URL.empty()) {
+    auto &store = render::ImageStore::GetInstance();
+    auto hash = store.Put(buf);
+    if (!hash.empty()) {
+      if (config::IMAGE_BASE_URL == "file")
+        return "file://" + store.PathOf(hash).string();
+      return fmt::format("{}/img/{}.jpg", config::IMAGE_BASE_URL, hash);
+    }
+  }
+  return "base64://" + base64_encode(buf.data(), buf.size());
 }
 
-// https://docs.opencv.org/3.4/d9/dfa/classcv_1_1freetype_1_1FreeType2.html#af059d49b806b916ffdd6380b9eb2f59a
 inline std::string TextToImg(const std::string &text) {
-  int font_height = 24;
-  auto font_path =
+  static const auto kFontPath =
       config::kAssetsDir / "fonts" / "SourceHanSansHWSC-Regular.otf";
-  int img_height = 0, img_width = 0;
-  auto freetype2 = cv::freetype::createFreeType2();
-  freetype2->loadFontData(font_path, 0);
+  const int font_height = 24;
+  auto &fonts = render::FontService::ThreadLocal();
+  int img_width = 0;
   std::string line;
   std::istringstream iss(text);
   std::vector<std::string> lines;
   while (getline(iss, line)) {
-    if (text.empty()) {
-      img_height += font_height;
-    } else {
-      int baseline = 0;
-      cv::Size text_size =
-          freetype2->getTextSize(line, font_height, 1, &baseline);
-      img_width = std::max(img_width, text_size.width);
-    }
+    auto text_size = fonts.GetTextSize(kFontPath, line, font_height);
+    img_width = std::max(img_width, text_size.width);
     lines.push_back(line);
   }
   int border = 10;
-  img_height = lines.size() * font_height;
+  int img_height = lines.size() * font_height;
   int gap = 5;
   auto real_width = img_width + border * 4;
   auto real_height = img_height + border * 4 + gap * lines.size();
@@ -156,11 +158,24 @@ inline std::string TextToImg(const std::string &text) {
   cv::addWeighted(mask, alpha, roi, 1.0 - alpha, 0.0, roi);
   int start_y = border * 2;
   for (auto &line : lines) {
-    freetype2->putText(img, line, cv::Point{border * 2, start_y}, font_height,
-                       cv::Scalar(0, 0, 0), -1, CV_AA, false);
+    fonts.PutText(img, kFontPath, line, cv::Point{border * 2, start_y},
+                  font_height, cv::Scalar(0, 0, 0));
     start_y += font_height + gap;
   }
-  return ImageTobase64(img);
+  return EncodeImage(img);
+}
+
+// 在渲染线程池中生成图片，协程等待期间不占用调度线程；
+// 相同的文字直接返回缓存的结果，tmpl用于按类别失效
+inline co_future<std::string> TextToImgAsync(const std::string &text,
+                                             const std::string &tmpl = "text") {
+  return render::CachedRender(tmpl, text, [text] { return TextToImg(text); });
+}
+
+// 在渲染线程池中生成图片但不写入缓存，用于天气等几乎不会重复的文字，
+// 避免一次性的内容挤掉可以复用的缓存项
+inline co_future<std::string> TextToImgUncachedAsync(const std::string &text) {
+  return render::Submit([text] { return TextToImg(text); });
 }
 
 }  // namespace white
@@ -0,0 +1,82 @@
+#ifndef MIGANGBOT_METRICS_METRICS_H_
+#define MIGANGBOT_METRICS_METRICS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "type.h"
+
+namespace white {
+namespace metrics {
+
+// 计数器/仪表，热路径上请缓存引用，避免每次按名字查找
+class Metric {
+ public:
+  void Add(int64_t n = 1) noexcept {
+    value_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  void Sub(int64_t n = 1) noexcept {
+    value_.fetch_sub(n, std::memory_order_relaxed);
+  }
+
+  void Set(int64_t n) noexcept { value_.store(n, std::memory_order_relaxed); }
+
+  int64_t Get() const noexcept {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<int64_t> value_{0};
+};
+
+class Registry {
+ public:
+  static Registry &GetInstance() {
+    static Registry registry;
+    return registry;
+  }
+
+ public:
+  // 返回的引用在整个进程生命周期内有效
+  Metric &Get(const std::string &name) {
+    std::lock_guard<std::mutex> locker(mutex_);
+    auto &metric = metrics_[name];
+    if (!metric) metric = std::make_unique<Metric>();
+    return *metric;
+  }
+
+  Json ToJson() {
+    Json ret = Json::object();
+    std::lock_guard<std::mutex> locker(mutex_);
+    for (auto &[name, metric] : metrics_) ret[name] = metric->Get();
+    return ret;
+  }
+
+ public:
+  Registry(const Registry &) = delete;
+  Registry &operator=(const Registry &) = delete;
+  Registry(Registry &&) = delete;
+  Registry &operator=(Registry &&) = delete;
+
+ private:
+  Registry() {}
+  ~Registry() {}
+
+ private:
+  std::map<std::string, std::unique_ptr<Metric>> metrics_;
+  std::mutex mutex_;
+};
+
+inline Metric &GetMetric(const std::string &name) {
+  return Registry::GetInstance().Get(name);
+}
+
+}  // namespace metrics
+}  // namespace white
+
+#endif
@@ -3,6 +3,7 @@
 #include "modules/module_interface.h"
 
 #include <algorithm>
+#include <mutex>
 #include <regex>
 #include <string>
 #include <string_view>
@@ -13,6 +14,7 @@
 #include "Document.h"
 #include "Node.h"
 
+#include "co_future.h"
 #include "tools/aiorequests.h"
 #include "db/db.h"
 #include "event/type.h"
@@ -68,6 +70,9 @@ class BilibiliParser : public Module {
 
   std::string GetLiveSummary(const std::string &url, const GId group_id);
 
+  // 同时解析的链接个数
+  static constexpr std::size_t kParseConcurrency = 4;
+
   Json GetJson(const std::string &url);
 
  private:
@@ -124,13 +129,15 @@ inline std::string GetFromCache(const std::string &url) {
 }
 
 inline std::string GetRealUrl(const std::string &url) {
-  auto r = aiorequests::Get(url, 15).get();
+  auto r = aiorequests::SharedGet(url, 15).get();
+  if (!r) return url;
   if (HTTP_STATUS_IS_REDIRECT(r->status_code)) return r->GetHeader("location");
   return url;
 }
 
 inline Json BilibiliParser::GetJson(const std::string &url) {
-  auto r = aiorequests::Get(url, 15, header_).get();
+  // 同一链接被同时发到多个群时，缓存未命中的请求只发出一次
+  auto r = aiorequests::SharedGet(url, 15, header_).get();
   if (!r) return Json();
   return r->GetJson();
 }
@@ -342,15 +349,29 @@ inline void BilibiliParser::Parser(const Event &event, onebot11::ApiBot &bot) {
   };
   std::vector<std::string> url_list(url_list_set.begin(), url_list_set.end());
   auto group_id = event.contains("group_id") ? event["group_id"].get<GId>() : 0;
-  for (auto &url : url_list) {
+  // 短链接并发展开，展开后去重，再并发解析，每个结果解析完成后立即发出，
+  // 不等待最慢的一个
+  parallel_for_each(url_list, kParseConcurrency, [](std::string &url) {
     if (checkurl(url)) url = GetRealUrl(url);
-    if (IsInCache(url, group_id)) continue;
     url = message::RStrip(url);
+  });
+  std::sort(url_list.begin(), url_list.end());
+  url_list.erase(std::unique(url_list.begin(), url_list.end()),
+                 url_list.end());
+  std::vector<onebot11::ApiFuture<MessageID>> sent;
+  std::mutex sent_mutex;
+  parallel_for_each(url_list, kParseConcurrency, [&](const std::string &url) {
+    if (IsInCache(url, group_id)) return;
     LOG_DEBUG("BilibiliParser: 即将开始解析 {}", url);
     auto msg = ExtractDetails(url, group_id);
-    if (msg.empty()) continue;
-    auto ret = bot.send(event, msg).get();
-    if (ret.message_id == 0) {
+    if (msg.empty()) return;
+    auto future = bot.send(event, msg);
+    std::lock_guard<std::mutex> locker(sent_mutex);
+    sent.push_back(std::move(future));
+  });
+  for (auto &future : sent) {
+    auto ret = future.Wait();
+    if (!ret || ret->message_id == 0) {
       LOG_WARN("解析消息发送失败");
       bot.send(event, "由于风控等原因链接解析结果无法发送(如有误检测请忽略)",
                true);
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <mutex>
+#include <vector>
+
 #include "co/co.h"
+#include "co_future.h"
 #include "event/Registrar.h"
 #include "global_config.h"
 #include "modules/module/botmanage/botmanage.h"
@@ -27,32 +31,54 @@ class AutoCleanGroup : public Module {
   }
 
  private:
+  // 同时查询群成员信息的个数
+  static constexpr std::size_t kQueryConcurrency = 8;
+
   void DoClean(const Event &event, onebot11::ApiBot &bot);
 };
 
 inline void AutoCleanGroup::DoClean(const Event &event, onebot11::ApiBot &bot) {
-  auto group_list = bot.get_group_list().get();
+  auto group_list = bot.get_group_list().Wait();
+  if (!group_list) {
+    for (auto &white : config::SUPERUSERS)
+      bot.send_private_msg(white, "获取群列表失败，已取消自动清理");
+    return;
+  }
   auto self_id = event["self_id"].get<QId>();
   unsigned int count = 0;
   for (auto &white : config::SUPERUSERS)
     bot.send_private_msg(white, "已开始自动清理");
-  for (auto &group : group_list) {
+  // 并发查询各群的活跃时间，退群仍逐个进行
+  std::vector<GId> inactive_groups;
+  std::mutex inactive_mutex;
+  auto query = [&](const GroupInfo &group) {
     auto group_id = group.group_id;
-    auto self_info = bot.get_group_member_info(group_id, self_id).get();
-    if (datetime::GetTimeStampS() - self_info.last_sent_time >=
+    // 获取失败时last_sent_time为0，不能据此判断为不活跃；
+    // 缓存中的last_sent_time可能已过时，需直接查询
+    auto self_info = bot.get_group_member_info(group_id, self_id, true).Wait();
+    if (!self_info) {
+      LOG_WARN("获取群{}的成员信息失败，跳过", group_id);
+      return;
+    }
+    if (datetime::GetTimeStampS() - self_info->last_sent_time >=
         3600 * 24 * botmanage::auto_clean_after) {
-      bot.send_group_msg(
-          group_id,
-          fmt::format("本群已超过{}未使用{}，即将自动退群，如有误请联系维护者",
-                      botmanage::auto_clean_after, config::BOT_NAME));
-      co::sleep(2000);
-      bot.set_group_leave(group_id);
-      ++count;
-      for (auto &white : config::SUPERUSERS)
-        bot.send_private_msg(
-            white, fmt::format("已自动退出群{}(超过{}天未使用)", group_id,
-                               botmanage::auto_clean_after));
+      std::lock_guard<std::mutex> locker(inactive_mutex);
+      inactive_groups.push_back(group_id);
     }
+  };
+  parallel_for_each(*group_list, kQueryConcurrency, query);
+  for (auto group_id : inactive_groups) {
+    bot.send_group_msg(
+        group_id,
+        fmt::format("本群已超过{}未使用{}，即将自动退群，如有误请联系维护者",
+                    botmanage::auto_clean_after, config::BOT_NAME));
+    co::sleep(2000);
+    bot.set_group_leave(group_id);
+    ++count;
+    for (auto &white : config::SUPERUSERS)
+      bot.send_private_msg(
+          white, fmt::format("已自动退出群{}(超过{}天未使用)", group_id,
+                             botmanage::auto_clean_after));
   }
   for (auto &white : config::SUPERUSERS)
     bot.send_private_msg(white, fmt::format("清理结束，共清理{}个群", count));
@@ -29,11 +29,11 @@ void Help::HelpMsg(const Event &event, onebot11::ApiBot &bot) {
       bot.send(event, botmanage::help_msg_friend_);
   } else if (text == "其他") {
     if (message_type[0] == 'g')
-      bot.send(event,
-                   message_segment::image(TextToImg(help_msg_group_others_)));
+      bot.send(event, message_segment::image(
+                          TextToImgAsync(help_msg_group_others_, "help").get()));
     else
-      bot.send(event,
-                   message_segment::image(TextToImg(help_msg_friend_others_)));
+      bot.send(event, message_segment::image(
+                          TextToImgAsync(help_msg_friend_others_, "help").get()));
   }else if(ServiceManager::GetInstance().CheckBundle(text)) 
   {
     sv::HandleListSvBundle(event, bot);
@@ -44,7 +44,7 @@ void Help::HelpMsg(const Event &event, onebot11::ApiBot &bot) {
     bool is_send_in_image =
         config_["自定义"][std::string(text)]["图片格式"].as<bool>();
     if (is_send_in_image)
-      bot.send(event, message_segment::image(TextToImg(content)));
+      bot.send(event, message_segment::image(TextToImgAsync(content, "help").get()));
     else
       bot.send(event, content);
   }
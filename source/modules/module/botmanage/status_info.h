@@ -13,8 +13,11 @@
 #include <chrono>
 #include <filesystem>
 #include <mutex>
+#include <vector>
 
+#include "co_future.h"
 #include "tools/aiorequests.h"
+#include "metrics/metrics.h"
 #include "message/message_segment.h"
 #include "message/utility.h"
 
@@ -42,21 +45,16 @@ inline std::string GetMemoryStatus() {
 }
 
 inline std::string GetNetworkStatus() {
-  int baidu_status, google_status;
-  auto resp_baidu = aiorequests::Get("https://www.baidu.com", 5).get();
-  if (!resp_baidu)
-    baidu_status = 404;
-  else
-    baidu_status = resp_baidu->status_code;
-
-  auto resp_google = aiorequests::Get("https://www.google.com", 5).get();
-  if (!resp_google)
-    google_status = 404;
-  else
-    google_status = resp_google->status_code;
-
-  return fmt::format("[网络] Baidu: {} | Google: {}", baidu_status,
-                     google_status);
+  // 两个请求同时发出，耗时取决于较慢的一个
+  std::vector<co_future<aiorequests::Response>> requests;
+  requests.push_back(aiorequests::Get("https://www.baidu.com", 5));
+  requests.push_back(aiorequests::Get("https://www.google.com", 5));
+  auto resps = when_all(std::move(requests)).get();
+  auto status_code = [](const aiorequests::Response &resp) {
+    return resp ? static_cast<int>(resp->status_code) : 404;
+  };
+  return fmt::format("[网络] Baidu: {} | Google: {}", status_code(resps[0]),
+                     status_code(resps[1]));
 }
 
 inline std::string GetDiskStatus() {
@@ -67,6 +65,15 @@ inline std::string GetDiskStatus() {
                      100 * (space_cap - space_avl) / space_cap,
                      space_avl / 1024);
 }
+
+inline std::string GetEventQueueStatus() {
+  return fmt::format(
+      "[队列] 积压: {} 丢弃心跳: {} 降级: {} 丢弃: {}",
+      metrics::GetMetric("event_queue.depth").Get(),
+      metrics::GetMetric("event_queue.dropped_heartbeat").Get(),
+      metrics::GetMetric("event_queue.shed_all_msg").Get(),
+      metrics::GetMetric("event_queue.dropped").Get());
+}
 }  // namespace status_info
 
 class StatusInfo : public Module {
@@ -111,9 +118,10 @@ inline void StatusInfo::Ping(const Event &event, onebot11::ApiBot &bot) {
 }
 
 inline void StatusInfo::Status(const Event &event, onebot11::ApiBot &bot) {
-  bot.send(event, fmt::format("[MigangBot]\n{}\n{}\n{}\n{}",
+  bot.send(event, fmt::format("[MigangBot]\n{}\n{}\n{}\n{}\n{}",
                               status_info::GetDiskStatus(), GetCPUStatus(),
                               status_info::GetMemoryStatus(),
+                              status_info::GetEventQueueStatus(),
                               status_info::GetLatency(event)));
 }
 
@@ -9,6 +9,7 @@
 #include "permission/permission.h"
 #include "service/service.h"
 #include "service/service_manager.h"
+#include "tools/render_cache.h"
 #include "type.h"
 #include "utility.h"
 #include "modules/module/botmanage/sv.h"
@@ -63,7 +64,11 @@ inline void HandleEnableSv(const Event &event, onebot11::ApiBot &bot) {
       bot.send_group_msg(group_id, fmt::format("服务[{}]不存在", service_name));
       return;
     }
-    if (ServiceManager::GetInstance().GroupEnable(service_name, group_id, perm))
+    auto success =
+        ServiceManager::GetInstance().GroupEnable(service_name, group_id, perm);
+    // 服务列表的图片随启用状态变化，旧的不会再命中，提前释放
+    render::RenderCache::GetInstance().Invalidate("sv");
+    if (success)
       bot.send_group_msg(group_id,
                          fmt::format("已成功启用服务[{}]", service_name));
     else {
@@ -90,8 +95,11 @@ inline void HandleDisableSv(const Event &event, onebot11::ApiBot &bot) {
       bot.send_group_msg(group_id, fmt::format("服务[{}]不存在", service_name));
       return;
     }
-    if (ServiceManager::GetInstance().GroupDisable(service_name, group_id,
-                                                   perm))
+    auto success = ServiceManager::GetInstance().GroupDisable(service_name,
+                                                              group_id, perm);
+    // 服务列表的图片随启用状态变化，旧的不会再命中，提前释放
+    render::RenderCache::GetInstance().Invalidate("sv");
+    if (success)
       bot.send_group_msg(group_id,
                          fmt::format("已成功禁用服务[{}]", service_name));
     else {
@@ -130,7 +138,7 @@ inline void HandleListSv(const Event &event, onebot11::ApiBot &bot) {
   }
   msg.pop_back();
   msg.pop_back();
-  bot.send(event, message_segment::image(TextToImg(msg)));
+  bot.send(event, message_segment::image(TextToImgAsync(msg, "sv").get()));
 }
 
 inline void HandleListSvBundle(const Event &event, onebot11::ApiBot &bot) {
@@ -148,7 +156,7 @@ inline void HandleListSvBundle(const Event &event, onebot11::ApiBot &bot) {
         }
     }
     msg += "发送[lsb 包名]来查看包内的服务列表";
-    bot.send(event, message_segment::image(TextToImg(msg)));
+    bot.send(event, message_segment::image(TextToImgAsync(msg, "sv").get()));
   } else {
     if (!ServiceManager::GetInstance().CheckBundle(option)) {
       bot.send(event,
@@ -175,7 +183,7 @@ inline void HandleListSvBundle(const Event &event, onebot11::ApiBot &bot) {
     }
     msg.pop_back();
     msg.pop_back();
-    bot.send(event, message_segment::image(TextToImg(msg)));
+    bot.send(event, message_segment::image(TextToImgAsync(msg, "sv").get()));
   }
 }
 
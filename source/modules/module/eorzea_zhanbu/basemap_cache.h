@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "logger/logger.h"
+#include "utility.h"
+
+namespace white {
+namespace module {
+namespace eorzea_zhanbu {
+
+// 占卜底图。预加载时在启动时把底图全部解码，之后所有绘制共享同一份只读的
+// cv::Mat，在副本上作画；超过内存上限或关闭预加载时，底图在首次使用时解码
+class BasemapCache {
+ public:
+  BasemapCache(std::filesystem::path dir, const bool preload,
+               const std::size_t memory_limit)
+      : dir_(std::move(dir)), preload_(preload), memory_limit_(memory_limit) {}
+
+ public:
+  // 重新扫描各职业的底图目录，返回底图数量。
+  // 新的底图全部准备好后才替换，重载期间的占卜仍使用旧底图
+  std::size_t Reload(const std::vector<std::string> &occupations);
+
+  // 随机选一张该职业的底图，返回相对路径(职业/文件名)，没有底图时为空
+  std::string Pick(const std::string &occupation) const;
+
+  // 底图文件的修改时间，用作渲染缓存的键，底图被替换后不会命中旧图片
+  int64_t Version(const std::string &basemap) const;
+
+  // 读取失败时返回nullptr
+  std::shared_ptr<const cv::Mat> Get(const std::string &basemap);
+
+ private:
+  struct State {
+    std::unordered_map<std::string, std::vector<std::string>> files;
+    std::unordered_map<std::string, int64_t> versions;
+    std::unordered_map<std::string, std::shared_ptr<const cv::Mat>> images;
+    std::size_t bytes = 0;
+  };
+
+  std::shared_ptr<const cv::Mat> Decode(const std::string &basemap) const;
+
+  // 未超过内存上限时缓存，返回是否缓存
+  bool Keep(State &state, const std::string &basemap,
+            std::shared_ptr<const cv::Mat> image) const;
+
+ private:
+  const std::filesystem::path dir_;
+  const bool preload_;
+  const std::size_t memory_limit_;
+
+  State state_;
+  mutable std::mutex mutex_;
+};
+
+inline std::shared_ptr<const cv::Mat> BasemapCache::Decode(
+    const std::string &basemap) const {
+  auto image = cv::imread(dir_ / basemap);
+  if (image.empty()) {
+    LOG_ERROR("读取占卜底图[{}]失败", basemap);
+    return nullptr;
+  }
+  return std::make_shared<const cv::Mat>(std::move(image));
+}
+
+inline bool BasemapCache::Keep(State &state, const std::string &basemap,
+                               std::shared_ptr<const cv::Mat> image) const {
+  auto bytes = image->total() * image->elemSize();
+  if (state.bytes + bytes > memory_limit_) return false;
+  if (state.images.emplace(basemap, std::move(image)).second)
+    state.bytes += bytes;
+  return true;
+}
+
+inline std::size_t BasemapCache::Reload(
+    const std::vector<std::string> &occupations) {
+  State state;
+  std::size_t count = 0;
+  for (const auto &occupation : occupations) {
+    std::error_code ec;
+    for (const auto &file :
+         std::filesystem::directory_iterator{dir_ / occupation, ec}) {
+      if (!std::string_view(file.path().native()).ends_with(".png")) continue;
+      auto basemap = occupation + "/" + file.path().filename().string();
+      state.files[occupation].push_back(basemap);
+      state.versions[basemap] =
+          file.last_write_time(ec).time_since_epoch().count();
+      ++count;
+      if (preload_)
+        if (auto image = Decode(basemap)) Keep(state, basemap, std::move(image));
+    }
+    if (ec) LOG_WARN("读取占卜底图目录[{}]失败: {}", occupation, ec.message());
+  }
+  LOG_INFO("已加载{}张占卜底图，其中{}张常驻内存，共{}MB", count,
+           state.images.size(), state.bytes >> 20);
+  std::lock_guard<std::mutex> locker(mutex_);
+  state_ = std::move(state);
+  return count;
+}
+
+inline std::string BasemapCache::Pick(const std::string &occupation) const {
+  std::lock_guard<std::mutex> locker(mutex_);
+  auto it = state_.files.find(occupation);
+  if (it == state_.files.end() || it->second.empty()) return "";
+  return *select_randomly(it->second.begin(), it->second.end());
+}
+
+inline int64_t BasemapCache::Version(const std::string &basemap) const {
+  std::lock_guard<std::mutex> locker(mutex_);
+  auto it = state_.versions.find(basemap);
+  return it == state_.versions.end() ? 0 : it->second;
+}
+
+inline std::shared_ptr<const cv::Mat> BasemapCache::Get(
+    const std::string &basemap) {
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    if (auto it = state_.images.find(basemap); it != state_.images.end())
+      return it->second;
+  }
+  // 解码在锁外进行，同一张底图并发首次使用时可能解码多次，结果相同
+  auto image = Decode(basemap);
+  if (!image) return nullptr;
+  std::lock_guard<std::mutex> locker(mutex_);
+  // 只缓存仍在当前底图列表中的文件，已被重载移除的底图不再占用内存
+  if (state_.versions.contains(basemap)) Keep(state_, basemap, image);
+  return image;
+}
+
+}  // namespace eorzea_zhanbu
+}  // namespace module
+}  // namespace white
@@ -3,12 +3,15 @@
 #include "modules/module_interface.h"
 
 #include <filesystem>
+#include <memory>
 #include <string_view>
 #include <unordered_map>
 #include <vector>
 
 #include "tools/aiorequests.h"
+#include "tools/render_cache.h"
 #include "global_config.h"
+#include "modules/module/eorzea_zhanbu/basemap_cache.h"
 #include "modules/module/eorzea_zhanbu/zhanbu_recorder.h"
 #include "modules/module/eorzea_zhanbu/zhanbu_utils.h"
 #include "utility.h"
@@ -24,7 +27,9 @@ constexpr auto kConfigExample =
     "  诸事皆宜: [\"萨纳兰今天也是艳阳高照啊\", "
     "\"美好的一天，适合挂机呢~\"]\n\n"
     "忌:\n"
-    "  2002: [\"那就90002\"]";
+    "  2002: [\"那就90002\"]\n\n"
+    "底图预加载: true      # 启动时把底图解码到内存中\n"
+    "底图内存上限MB: 256   # 超过上限的底图在使用时才读取";
 
 }  // namespace eorzea_zhanbu
 class EorzeaZhanbu : public Module {
@@ -56,29 +61,37 @@ class EorzeaZhanbu : public Module {
       }
     }
 
-    for (const auto &occupation : occupations_) {
-      auto dir = config::kAssetsDir / "images" / "zhanbu" / occupation;
-      for (const auto &file : std::filesystem::directory_iterator{dir}) {
-        if (std::string_view(file.path().native()).ends_with(".png"))
-          occupation_basemaps_[occupation].push_back(file.path().filename());
-      }
-    }
+    basemaps_ = std::make_unique<eorzea_zhanbu::BasemapCache>(
+        config::kAssetsDir / "images" / "zhanbu",
+        config_["底图预加载"].as<bool>(true),
+        config_["底图内存上限MB"].as<std::size_t>(256) << 20);
+    basemaps_->Reload(occupations_);
   }
   virtual void Register() {
     OnPrefix({"/zhanbu", "/占卜", "、占卜"}, make_pair("艾欧泽亚占卜", "娱乐"),
              ACT_InClass(EorzeaZhanbu::Zhanbu));
+    OnFullmatch({"重载占卜底图"}, make_pair("__zhanbu_reload__", "娱乐"),
+                "重新扫描并加载占卜底图",
+                ACT_InClass(EorzeaZhanbu::ReloadBasemaps),
+                permission::SUPERUSER, permission::SUPERUSER);
   }
 
  private:
   void Zhanbu(const Event &event, onebot11::ApiBot &bot);
 
+  void ReloadBasemaps(const Event &event, onebot11::ApiBot &bot);
+
   std::string GetEorzeaZhanbu(const QId uid);
 
   std::tuple<std::string, std::string, std::string, std::string, std::string,
              std::string>
   GetZhanbuResult(const QId uid);
 
-  std::string GetBasemap(const std::string &occupation);
+  // 同一天内相同的占卜结果直接使用缓存的图片，零点过期
+  std::string DrawCached(const std::string &luck, const std::string &yi,
+                                const std::string &ji, const std::string &dye,
+                                const std::string &append_msg,
+                                const std::string &basemap);
 
  private:
   std::vector<std::string> occupations_;
@@ -88,8 +101,7 @@ class EorzeaZhanbu : public Module {
   std::unordered_map<std::string, std::vector<std::string>> luck_ji_reply_;
   const std::vector<std::string> exception_msg_;
 
-  std::unordered_map<std::string, std::vector<std::string>>
-      occupation_basemaps_;
+  std::unique_ptr<eorzea_zhanbu::BasemapCache> basemaps_;
   ZhanbuRecorder recorder_;
 };
 
@@ -119,22 +131,46 @@ inline void EorzeaZhanbu::Zhanbu(const Event &event, onebot11::ApiBot &bot) {
 inline std::string EorzeaZhanbu::GetEorzeaZhanbu(const QId uid) {
   auto cur_time = datetime::GetCurrentLocalTimeStamp();
   auto record = recorder_.GetZhanbuRecord(uid);
-  static auto basemap_base_path = config::kAssetsDir / "images" / "zhanbu";
   if (std::get<6>(record) == 0 || std::get<6>(record) <= cur_time) {
     std::string luck, yi, ji, dye, append_msg, occupation;
     std::tie(luck, yi, ji, dye, append_msg, occupation) = GetZhanbuResult(uid);
-    auto basemap = fmt::format("{}/{}", occupation, GetBasemap(occupation));
+    auto basemap = basemaps_->Pick(occupation);
     recorder_.RecordZhanbu(uid, luck, yi, ji, dye, append_msg, basemap,
                            datetime::LastSecondOfToday());
-    return eorzea_zhanbu::Draw(luck, yi, ji, dye, append_msg,
-                               basemap_base_path / basemap);
+    return DrawCached(luck, yi, ji, dye, append_msg, basemap);
   } else {
-    return eorzea_zhanbu::Draw(std::get<0>(record), std::get<1>(record), std::get<2>(record), std::get<3>(record),
-                               std::get<4>(record), basemap_base_path / std::get<5>(record));
+    return DrawCached(std::get<0>(record), std::get<1>(record),
+                      std::get<2>(record), std::get<3>(record),
+                      std::get<4>(record), std::get<5>(record));
   }
   return "";
 }
 
+inline std::string EorzeaZhanbu::DrawCached(
+    const std::string &luck, const std::string &yi, const std::string &ji,
+    const std::string &dye, const std::string &append_msg,
+    const std::string &basemap) {
+  auto inputs = Json{luck, yi, ji, dye, append_msg, basemap,
+                     basemaps_->Version(basemap)}
+                    .dump();
+  return render::CachedRender(
+             "zhanbu", inputs,
+             [=, basemaps = basemaps_.get()]() -> std::string {
+               auto image = basemaps->Get(basemap);
+               if (!image) return "";
+               return eorzea_zhanbu::Draw(luck, yi, ji, dye, append_msg,
+                                          *image);
+             },
+             datetime::LastSecondOfToday())
+      .get();
+}
+
+inline void EorzeaZhanbu::ReloadBasemaps(const Event &event,
+                                         onebot11::ApiBot &bot) {
+  auto count = basemaps_->Reload(occupations_);
+  bot.send(event, fmt::format("已重新加载{}张占卜底图", count));
+}
+
 inline std::tuple<std::string, std::string, std::string, std::string,
                   std::string, std::string>
 EorzeaZhanbu::GetZhanbuResult(const QId uid) {
@@ -191,10 +227,5 @@ EorzeaZhanbu::GetZhanbuResult(const QId uid) {
           luck_occupation};
 }
 
-inline std::string EorzeaZhanbu::GetBasemap(const std::string &occupation) {
-  return *select_randomly(occupation_basemaps_.at(occupation).begin(),
-                          occupation_basemaps_.at(occupation).end());
-}
-
 }  // namespace module
 }  // namespace white
\ No newline at end of file
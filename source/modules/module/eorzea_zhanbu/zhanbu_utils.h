@@ -14,10 +14,8 @@
 #include <opencv2/core.hpp>
 #include <opencv2/core/mat.hpp>
 #include <opencv2/core/types.hpp>
-#include <opencv2/freetype.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
-#include <opencv2/imgproc/imgproc_c.h>
 
 #include "tools/aiorequests.h"
 #include "event/event.h"
@@ -25,6 +23,7 @@
 #include "logger/logger.h"
 #include "message/message_segment.h"
 #include "message/utility.h"
+#include "tools/font_service.h"
 #include "utility.h"
 
 namespace white {
@@ -107,34 +106,32 @@ inline std::vector<std::u16string> Decrement(const std::string &text_u8) {
 inline std::string Draw(const std::string &luck, const std::string &yi,
                         const std::string &ji, const std::string &dye,
                         const std::string &append_msg,
-                        const std::string &basemap) {
+                        const cv::Mat &basemap) {
   static const auto kTitleFont =
       config::kAssetsDir / "fonts" / "zhanbu" / "Mamelon.otf";
   static const auto kTextFont =
       config::kAssetsDir / "fonts" / "zhanbu" / "sakura.ttf";
-  cv::Mat img = cv::imread(basemap);
-  auto freetype2 = cv::freetype::createFreeType2();
-  int baseline = 0;
+  // 底图在多次绘制间共享，只在副本上作画
+  cv::Mat img = basemap.clone();
+  auto &fonts = render::FontService::ThreadLocal();
   // draw luck
   int font_height = 45;
   cv::Scalar color(245, 245, 245);
   std::pair image_font_center{140, 89};
-  freetype2->loadFontData(kTitleFont, 0);
-  auto font_size = freetype2->getTextSize(luck, font_height, 1, &baseline);
-  freetype2->putText(img, luck,
-                     cv::Point(image_font_center.first - font_size.width / 2,
-                               image_font_center.second - font_size.height / 2),
-                     font_height, color, -1, CV_AA, false);
+  auto font_size = fonts.GetTextSize(kTitleFont, luck, font_height);
+  fonts.PutText(img, kTitleFont, luck,
+                cv::Point(image_font_center.first - font_size.width / 2,
+                          image_font_center.second - font_size.height / 2),
+                font_height, color);
   // draw dye
   font_height = 18;
   color = cv::Scalar(50, 50, 50);
   image_font_center = std::make_pair(140, 152);
-  freetype2->loadFontData(kTextFont, 0);
-  font_size = freetype2->getTextSize(dye, font_height, 1, &baseline);
-  freetype2->putText(img, dye,
-                     cv::Point(image_font_center.first - font_size.width / 2,
-                               image_font_center.second - font_size.height / 2),
-                     font_height, color, -1, CV_AA, false);
+  font_size = fonts.GetTextSize(kTextFont, dye, font_height);
+  fonts.PutText(img, kTextFont, dye,
+                cv::Point(image_font_center.first - font_size.width / 2,
+                          image_font_center.second - font_size.height / 2),
+                font_height, color);
 
   // draw yi, ji, append_msg
   font_height = 25;
@@ -160,15 +157,16 @@ inline std::string Draw(const std::string &luck, const std::string &yi,
       auto ori_x = image_font_center.first + (slice_num - 2) * font_height / 2 +
                    (slice_num - 1) * 4 - i * (font_height + 4);
       auto ori_y = image_font_center.second - h / 2;
+      // 竖排逐字绘制，字形已缓存，每个字只是一次位图混合
       for (std::size_t j = 0; j < text_slice[i].size(); ++j) {
-        freetype2->putText(img, utf8::utf16to8(text_slice[i].substr(j, 1)),
-                           cv::Point(ori_x, ori_y), font_height, color, -1,
-                           CV_AA, false);
+        fonts.PutText(img, kTextFont,
+                      utf8::utf16to8(text_slice[i].substr(j, 1)),
+                      cv::Point(ori_x, ori_y), font_height, color);
         ori_y += font_height + 4;
       }
     }
   }
-  return message_segment::image(ImageTobase64(img));
+  return message_segment::image(EncodeImage(img));
 }
 
 }  // namespace eorzea_zhanbu
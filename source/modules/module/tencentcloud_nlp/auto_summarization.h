@@ -45,7 +45,7 @@ inline void AutoSummarization::Register() {
 
 inline void AutoSummarization::SummarizationExtraction(const Event &event,
                                                        onebot11::ApiBot &bot) {
-  auto msg = message::ExtraPlainText(event);
+  auto msg = message::ExtraText(event);
   bot.send(event, GetSummarization(msg));
 }
 
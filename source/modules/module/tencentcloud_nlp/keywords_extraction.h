@@ -43,7 +43,7 @@ inline void KeywordsExtraction::Register() {
 
 inline void KeywordsExtraction::KeywordEX(const Event &event,
                                           onebot11::ApiBot &bot) {
-  auto msg = message::ExtraPlainText(event);
+  auto msg = message::ExtraText(event);
   bot.send(event, GetKeywords(msg));
 }
 
@@ -119,7 +119,8 @@ inline void Weather::SetLocation(const Event &event, onebot11::ApiBot &bot) {
   msg +=
       "\n\n发送[实时天气 数字](例如 实时天气 "
       "0)可查看当前天气情况\n可以发送“天气帮助”获取使用说明哦~";
-  bot.send(event, message_segment::image(TextToImg(msg)), true);
+  bot.send(event,
+           message_segment::image(TextToImgUncachedAsync(msg).get()), true);
 }
 
 inline void Weather::RealTimeWeather(const Event &event,
@@ -168,7 +169,7 @@ inline void Weather::RealTimeWeather(const Event &event,
       weather["pressure"].get<std::string>(), weather["vis"].get<std::string>(),
       weather["cloud"].get<std::string>());
   msg = fmt::format("{}\n也可以进入{}查看当前城市天气详情哦~",
-                    message_segment::image(TextToImg(msg)),
+                    message_segment::image(TextToImgUncachedAsync(msg).get()),
                     weather["fxLink"].get<std::string>());
   bot.send(event, msg, true);
 }
@@ -230,7 +231,7 @@ inline void Weather::TodayWeather(const Event &event, onebot11::ApiBot &bot) {
       tenki["pressure"].get<std::string>(), tenki["vis"].get<std::string>(),
       tenki["cloud"].get<std::string>(), tenki["precip"].get<std::string>());
   msg = fmt::format("{}\n也可以进入{}查看当前城市天气详情哦~",
-                    message_segment::image(TextToImg(msg)),
+                    message_segment::image(TextToImgUncachedAsync(msg).get()),
                     tenki["fxLink"].get<std::string>());
   bot.send(event, msg, true);
 }
@@ -279,7 +280,8 @@ inline void Weather::WeatherShortDesc(const Event &event,
                        qweather::YMDTOCHS(desc["fxDate"].get<std::string>()),
                        text_trans, temp_trans);
   }
-  bot.send(event, message_segment::image(TextToImg(msg)), true);
+  bot.send(event,
+           message_segment::image(TextToImgUncachedAsync(msg).get()), true);
 }
 
 inline void Weather::UpdateEorzeanWeatherData(const Event &event, onebot11::ApiBot &bot) {
@@ -22,11 +22,16 @@
 namespace white {
 namespace module {
 
-#define ACT_InClass(func) \
-  [this](const Event &event, onebot11::ApiBot &bot) { func(event, bot); }
+// func可以返回void，也可以返回Task<>以无栈协程的方式运行
+#define ACT_InClass(func)                             \
+  [this](const Event &event, onebot11::ApiBot &bot) { \
+    return func(event, bot);                          \
+  }
 
-#define ACT_OutClass(func) \
-  [](const Event &event, onebot11::ApiBot &bot) { func(event, bot); }
+#define ACT_OutClass(func)                      \
+  [](const Event &event, onebot11::ApiBot &bot) { \
+    return func(event, bot);                    \
+  }
 
 using std::make_pair;
 using ScheduleServicePtr = std::shared_ptr<ScheduleService>;
@@ -2,6 +2,7 @@
 #define MIGANGBOT_PERMISSION_PERMISSION_H_
 
 #include "event/event.h"
+#include "event/event_view.h"
 #include "global_config.h"
 #include "type.h"
 
@@ -50,6 +51,23 @@ inline const auto GetUserPermission(const Event &event) {
   return NORMAL;
 }
 
+inline const auto GetUserPermission(const EventView &event) {
+  QId user_id = event.GetNumber<QId>("user_id");
+  if (config::SUPERUSERS.count(user_id)) return SUPERUSER;
+  if (config::WHITE_LIST.count(user_id)) return WHITE_LIST;
+  // group
+  if (FirstChar(event.GetString("message_type")) != 'g') return PRIVATE;
+  if (!event.IsNull("anonymous")) return NORMAL;
+  switch (FirstChar(event.GetObject("sender").GetString("role"))) {
+    case 'a':
+      return GROUP_ADMIN;
+    case 'o':
+      return GROUP_OWNER;
+    default:
+      return GROUP_MEMBER;
+  }
+}
+
 }  // namespace permission
 }  // namespace white
 
@@ -7,7 +7,10 @@
 #include <string>
 
 #include "bot/bot.h"
+#include "global_config.h"
 #include "logger/logger.h"
+#include "metrics/metrics.h"
+#include "tools/image_store.h"
 
 namespace white {
 
@@ -41,7 +44,7 @@ class Server {
     ws_.onmessage = [](const WebSocketChannelPtr& channel,
                        const std::string& msg) {
       LOG_DEBUG("Get Message: {}", msg);
-      go(&Bot::OnRead, channel->getContext<Bot>(), msg);
+      channel->getContext<Bot>()->OnRead(msg);
     };
     ws_.onclose = [this](const WebSocketChannelPtr& channel) {
       LOG_DEBUG("onClose");
@@ -52,6 +55,14 @@ class Server {
   void InitHttpService() {
     http_.GET("/ping",
               [](const HttpContextPtr& ctx) { return ctx->send("pong"); });
+    http_.GET("/metrics", [](const HttpContextPtr& ctx) {
+      return ctx->send(metrics::Registry::GetInstance().ToJson().dump(),
+                       APPLICATION_JSON);
+    });
+    // 以url发送的图片由这里提供，libhv会把常用的文件缓存在内存中
+    if (!config::IMAGE_BASE_URL.empty() && config::IMAGE_BASE_URL != "file")
+      http_.Static("/img",
+                   render::ImageStore::GetInstance().Dir().c_str());
   }
 
  private:
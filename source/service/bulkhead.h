@@ -0,0 +1,146 @@
+#ifndef MIGANGBOT_SERVICE_BULKHEAD_H_
+#define MIGANGBOT_SERVICE_BULKHEAD_H_
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <co/co.h>
+#include <yaml-cpp/yaml.h>
+
+#include "global_config.h"
+#include "logger/logger.h"
+#include "metrics/metrics.h"
+
+namespace white {
+
+// 单个服务的并发隔离舱。同时执行的调用不超过max_concurrency，
+// 超出的调用至多排队queue_limit个，再多则直接拒绝，
+// 避免某个慢插件占满所有协程，拖慢其他指令的响应。
+// 上限为0表示不限制，未配置的服务不受影响
+class Bulkhead {
+ public:
+  // 持有期间占用一个槽位，最后一个副本析构时释放槽位并启动下一个排队的调用
+  using Permit = std::shared_ptr<void>;
+  using Job = std::function<void(Permit)>;
+
+  enum class Admit { kRun, kQueued, kRejected };
+
+  // 同名的服务共享一个隔离舱，配置读取自全局配置中的Services.<name>
+  static Bulkhead &Of(const std::string &service_name);
+
+  Bulkhead(const std::string &service_name, const std::size_t max_concurrency,
+           const std::size_t queue_limit, std::string reject_reply = "")
+      : max_concurrency_(max_concurrency),
+        queue_limit_(queue_limit),
+        reject_reply_(std::move(reject_reply)),
+        active_(metrics::GetMetric("service." + service_name + ".active")),
+        queued_(metrics::GetMetric("service." + service_name + ".queued")),
+        rejected_(metrics::GetMetric("service." + service_name + ".rejected")) {}
+
+ public:
+  // 有空闲槽位时在新协程中执行job，否则排队或拒绝
+  Admit Submit(Job &&job);
+
+  const std::string &RejectReply() const noexcept { return reject_reply_; }
+
+ public:
+  Bulkhead(const Bulkhead &) = delete;
+  Bulkhead &operator=(const Bulkhead &) = delete;
+
+ private:
+  Permit MakePermit() {
+    return Permit(nullptr, [this](void *) { Release(); });
+  }
+
+  void Start(Job &&job) {
+    go([this, job = std::move(job)] { job(MakePermit()); });
+  }
+
+  void Release();
+
+ private:
+  const std::size_t max_concurrency_;
+  const std::size_t queue_limit_;
+  const std::string reject_reply_;
+
+  std::size_t active_count_ = 0;
+  std::deque<Job> queue_;
+  std::mutex mutex_;
+
+  metrics::Metric &active_;
+  metrics::Metric &queued_;
+  metrics::Metric &rejected_;
+};
+
+inline Bulkhead &Bulkhead::Of(const std::string &service_name) {
+  static std::mutex mutex;
+  static std::map<std::string, std::unique_ptr<Bulkhead>> all;
+  std::lock_guard<std::mutex> locker(mutex);
+  auto &ret = all[service_name];
+  if (!ret) {
+    std::size_t max_concurrency = 0, queue_limit = 0;
+    std::string reject_reply;
+    // 通过const引用读取，非const的operator[]会为缺失的键插入空节点
+    const YAML::Node &config = global_config;
+    const YAML::Node services = config["Services"];
+    const YAML::Node node =
+        services.IsDefined() && services.IsMap() ? services[service_name]
+                                                 : YAML::Node();
+    if (node.IsDefined() && node.IsMap()) {
+      max_concurrency = node["MaxConcurrency"].as<std::size_t>(0);
+      queue_limit = node["QueueLimit"].as<std::size_t>(0);
+      reject_reply = node["RejectReply"].as<std::string>("");
+      LOG_INFO("服务[{}]的并发上限为{}，排队上限为{}", service_name,
+               max_concurrency, queue_limit);
+    }
+    ret.reset(new Bulkhead(service_name, max_concurrency, queue_limit,
+                           std::move(reject_reply)));
+  }
+  return *ret;
+}
+
+inline Bulkhead::Admit Bulkhead::Submit(Job &&job) {
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    if (max_concurrency_ && active_count_ >= max_concurrency_) {
+      if (queue_.size() >= queue_limit_) {
+        rejected_.Add();
+        return Admit::kRejected;
+      }
+      queue_.push_back(std::move(job));
+      queued_.Add();
+      return Admit::kQueued;
+    }
+    ++active_count_;
+  }
+  active_.Add();
+  Start(std::move(job));
+  return Admit::kRun;
+}
+
+inline void Bulkhead::Release() {
+  Job next;
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    if (queue_.empty()) {
+      --active_count_;
+      active_.Sub();
+      return;
+    }
+    // 槽位直接交给队首的调用，active不变
+    next = std::move(queue_.front());
+    queue_.pop_front();
+  }
+  queued_.Sub();
+  Start(std::move(next));
+}
+
+}  // namespace white
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef MIGANGBOT_SERVICE_ENABLE_MATRIX_H_
+#define MIGANGBOT_SERVICE_ENABLE_MATRIX_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "type.h"
+
+namespace white {
+
+// 服务(稠密下标)×群的启用矩阵。每个群一行位图，第i位表示第i个服务
+// 的状态与其默认状态相反，没有行的群全部为默认状态。
+// 写入时复制出新快照整体发布(RCU)，读取只做一次原子读和一次位测试。
+// 处理一个事件时先用Group取得该群的行，之后对各服务只做位测试
+class EnableMatrix {
+ public:
+  EnableMatrix() : snapshot_(std::make_shared<const Snapshot>()) {
+    version_.store(NextVersion(), std::memory_order_release);
+  }
+
+ public:
+  // 注册一个服务，toggled为状态与默认相反的群，返回服务的下标
+  uint32_t Add(const bool enable_on_default,
+               const std::unordered_set<GId> &toggled);
+
+  void Set(const uint32_t index, const GId group_id, const bool enable);
+
+  bool Test(const uint32_t index, const GId group_id) const;
+
+  std::size_t Size() const {
+    return Load()->enable_on_default.size();
+  }
+
+ private:
+  using Row = std::vector<uint64_t>;
+
+  struct Snapshot {
+    std::vector<bool> enable_on_default;
+    // 行不可变，快照之间共享未修改的行
+    std::unordered_map<GId, std::shared_ptr<const Row>> rows;
+  };
+
+ public:
+  // 一个群在某个快照中的启用状态，持有快照，期间的修改对它不可见
+  class GroupView {
+   public:
+    GroupView() = default;
+
+    bool Test(const uint32_t index) const noexcept {
+      if (!snapshot_ || index >= snapshot_->enable_on_default.size())
+        return false;
+      return snapshot_->enable_on_default[index] != (row_ && Bit(*row_, index));
+    }
+
+    // 默认构造的视图不属于任何矩阵
+    const EnableMatrix *Matrix() const noexcept { return matrix_; }
+
+   private:
+    friend class EnableMatrix;
+
+    const EnableMatrix *matrix_ = nullptr;
+    std::shared_ptr<const Snapshot> snapshot_;
+    const Row *row_ = nullptr;
+  };
+
+  // 只查一次群的行，与之后的Test(index)合起来等价于Test(index, group_id)
+  GroupView Group(const GId group_id) const;
+
+ private:
+
+  static bool Bit(const Row &row, const uint32_t index) noexcept {
+    auto word = index >> 6;
+    return word < row.size() && (row[word] >> (index & 63)) & 1;
+  }
+
+  // 所有实例共用一个递增的版本号，线程本地缓存只凭版本即可判断是否过期
+  static uint64_t NextVersion() noexcept {
+    static std::atomic<uint64_t> version{0};
+    return version.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+  // 读者只在版本变化后取一次快照，这里加锁不在热路径上。
+  // 不用std::atomic<std::shared_ptr>：libstdc++的实现解锁时为relaxed，
+  // ThreadSanitizer会报告数据竞争
+  std::shared_ptr<const Snapshot> Load() const {
+    std::lock_guard<std::mutex> locker(snapshot_mutex_);
+    return snapshot_;
+  }
+
+  // 当前线程缓存的快照，引用在本线程下次调用前有效
+  const std::shared_ptr<const Snapshot> &Current() const;
+
+  void Publish(std::shared_ptr<const Snapshot> &&snapshot) {
+    {
+      std::lock_guard<std::mutex> locker(snapshot_mutex_);
+      snapshot_.swap(snapshot);
+    }
+    version_.store(NextVersion(), std::memory_order_release);
+  }
+
+ private:
+  std::shared_ptr<const Snapshot> snapshot_;
+  mutable std::mutex snapshot_mutex_;
+  std::atomic<uint64_t> version_;
+  // 串行化写者
+  std::mutex mutex_;
+};
+
+inline uint32_t EnableMatrix::Add(const bool enable_on_default,
+                                  const std::unordered_set<GId> &toggled) {
+  std::lock_guard<std::mutex> locker(mutex_);
+  auto snapshot = std::make_shared<Snapshot>(*Load());
+  uint32_t index = snapshot->enable_on_default.size();
+  snapshot->enable_on_default.push_back(enable_on_default);
+  for (auto group_id : toggled) {
+    auto &row = snapshot->rows[group_id];
+    auto copy = row ? std::make_shared<Row>(*row) : std::make_shared<Row>();
+    if (copy->size() <= (index >> 6)) copy->resize((index >> 6) + 1);
+    (*copy)[index >> 6] |= uint64_t{1} << (index & 63);
+    row = std::move(copy);
+  }
+  Publish(std::move(snapshot));
+  return index;
+}
+
+inline void EnableMatrix::Set(const uint32_t index, const GId group_id,
+                              const bool enable) {
+  std::lock_guard<std::mutex> locker(mutex_);
+  auto current = Load();
+  if (index >= current->enable_on_default.size()) return;
+  const bool toggled = enable != current->enable_on_default[index];
+  auto it = current->rows.find(group_id);
+  if (toggled == (it != current->rows.end() && Bit(*it->second, index)))
+    return;
+
+  auto snapshot = std::make_shared<Snapshot>(*current);
+  auto copy = it != current->rows.end() ? std::make_shared<Row>(*it->second)
+                                        : std::make_shared<Row>();
+  if (copy->size() <= (index >> 6)) copy->resize((index >> 6) + 1);
+  (*copy)[index >> 6] ^= uint64_t{1} << (index & 63);
+  while (!copy->empty() && !copy->back()) copy->pop_back();
+  if (copy->empty())
+    snapshot->rows.erase(group_id);
+  else
+    snapshot->rows[group_id] = std::move(copy);
+  Publish(std::move(snapshot));
+}
+
+inline const std::shared_ptr<const EnableMatrix::Snapshot> &
+EnableMatrix::Current() const {
+  // 快照只在启用/禁用时变化，每个线程缓存最近一次读到的快照，
+  // 版本未变时无需触碰共享的引用计数
+  struct Cache {
+    uint64_t version = 0;
+    std::shared_ptr<const Snapshot> snapshot;
+  };
+  thread_local Cache cache;
+  auto version = version_.load(std::memory_order_acquire);
+  if (cache.version != version) {
+    cache.snapshot = Load();
+    cache.version = version;
+  }
+  return cache.snapshot;
+}
+
+inline EnableMatrix::GroupView EnableMatrix::Group(const GId group_id) const {
+  GroupView view;
+  view.matrix_ = this;
+  view.snapshot_ = Current();
+  auto it = view.snapshot_->rows.find(group_id);
+  if (it != view.snapshot_->rows.end()) view.row_ = it->second.get();
+  return view;
+}
+
+inline bool EnableMatrix::Test(const uint32_t index,
+                               const GId group_id) const {
+  const auto &snapshot = *Current();
+  if (index >= snapshot.enable_on_default.size()) return false;
+  auto it = snapshot.rows.find(group_id);
+  const bool toggled = it != snapshot.rows.end() && Bit(*it->second, index);
+  return snapshot.enable_on_default[index] != toggled;
+}
+
+}  // namespace white
+
+#endif
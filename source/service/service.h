@@ -12,6 +12,8 @@
 #include <utility>
 
 #include "event/type.h"
+#include "service/enable_matrix.h"
+#include "service/service_store.h"
 #include "global_config.h"
 #include "permission/permission.h"
 #include "type.h"
@@ -25,8 +27,7 @@ class Service {
       : service_name_(service_name),
         description_(description),
         manage_permission_(manage_permission),
-        enable_on_default_(enable_on_default),
-        config_path_(config::kServiceDir / (service_name_ + ".json")) {
+        enable_on_default_(enable_on_default) {
     LoadConfig();
   }
 
@@ -38,61 +39,61 @@ class Service {
   const int Permission() const noexcept { return manage_permission_; };
 
   bool GroupEnable(const GId group_id, const int permission) {
-    if (permission < manage_permission_) return false;
-    if (enable_on_default_) {
-      std::lock_guard<std::mutex> locker(mutex_);
-      if (groups_.count(group_id)) groups_.erase(group_id);
-      SaveConfig();
-      return true;
-    }
-    std::lock_guard<std::mutex> locker(mutex_);
-    if (groups_.emplace(group_id).second) SaveConfig();
-    return true;
+    return SetGroupStatus(group_id, permission, true);
   }
 
   bool GroupDisable(const GId group_id, const int permission) {
-    if (permission < manage_permission_) return false;
-    if (!enable_on_default_) {
-      std::lock_guard<std::mutex> locker(mutex_);
-      if (groups_.count(group_id)) groups_.erase(group_id);
-      SaveConfig();
-      return true;
-    }
+    return SetGroupStatus(group_id, permission, false);
+  }
+
+  bool GroupStatus(const GId group_id) const noexcept {
+    if (matrix_) return matrix_->Test(index_, group_id);
     std::lock_guard<std::mutex> locker(mutex_);
-    if (groups_.emplace(group_id).second) SaveConfig();
-    return true;
+    return enable_on_default_ != groups_.contains(group_id);
+  }
+
+  // group须由本服务所在的矩阵(见Matrix)取得
+  bool GroupStatus(const EnableMatrix::GroupView &group) const noexcept {
+    return group.Test(index_);
   }
 
-  bool GroupStatus(const GId group_id) {
-    if (enable_on_default_) return !groups_.count(group_id);
-    return groups_.count(group_id);
+  // 由ServiceManager在注册时调用，此后启用状态从矩阵中读取
+  void Attach(EnableMatrix &matrix) {
+    std::lock_guard<std::mutex> locker(mutex_);
+    index_ = matrix.Add(enable_on_default_, groups_);
+    matrix_ = &matrix;
   }
 
  protected:
+  // 注册到ServiceManager之前为nullptr
+  const EnableMatrix *Matrix() const noexcept { return matrix_; }
+
   void LoadConfig() {
     if (manage_permission_ == permission::ALWAYS_ON) return;
-    if (!std::filesystem::exists(config_path_)) {
-      config_["enable_on_default"] = enable_on_default_;
-      config_["groups"] = R"([])"_json;
-      std::ofstream(config_path_) << std::setw(4) << config_ << std::endl;
-    } else {
-      std::ifstream(config_path_) >> config_;
-    }
-    enable_on_default_ = config_["enable_on_default"].get<bool>();
-    for (std::size_t i = 0; i < config_["groups"].size(); ++i)
-      groups_.insert(config_["groups"][i].get<GId>());
+    auto state =
+        ServiceStore::GetInstance().Load(service_name_, enable_on_default_);
+    enable_on_default_ = state.enable_on_default;
+    groups_ = std::move(state.groups);
   }
 
-  void SaveConfig() {
-    config_["groups"] = R"([])"_json;
-    for (auto it : groups_) config_["groups"].push_back(it);
-    std::ofstream(config_path_) << std::setw(4) << config_ << std::endl;
+ private:
+  // groups_中为状态与默认相反的群，在锁内同时更新矩阵，
+  // 保证同一服务的修改按相同顺序落到持久化日志和矩阵
+  bool SetGroupStatus(const GId group_id, const int permission,
+                      const bool enable) {
+    if (permission < manage_permission_) return false;
+    std::lock_guard<std::mutex> locker(mutex_);
+    const bool toggled = enable != enable_on_default_;
+    if (toggled ? groups_.emplace(group_id).second : groups_.erase(group_id))
+      ServiceStore::GetInstance().Record(service_name_, group_id, toggled);
+    if (matrix_) matrix_->Set(index_, group_id, enable);
+    return true;
   }
 
  protected:
   const int manage_permission_;
   bool enable_on_default_;
-  std::mutex mutex_;
+  mutable std::mutex mutex_;
   std::unordered_set<GId> groups_;
 
   const std::string service_name_;
@@ -100,9 +101,8 @@ class Service {
  private:
   const std::string description_;
 
-  const std::string config_path_;
-
-  Json config_;
+  EnableMatrix *matrix_ = nullptr;
+  uint32_t index_ = 0;
 };
 }  // namespace white
 
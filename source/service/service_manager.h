@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "type.h"
+#include <service/enable_matrix.h>
 #include <service/service.h>
 #include <service/triggered_service.h>
 #include <service/schedule_service.h>
@@ -52,6 +53,7 @@ class ServiceManager {
 
   void RegisterService(const std::string &bundle_name,
                        std::shared_ptr<Service> service) {
+    service->Attach(enable_matrix_);
     service_name_map_.emplace(service->GetServiceName(), service);
     bundle_service_map_[bundle_name].emplace(service->GetServiceName(),
                                              service);
@@ -66,8 +68,9 @@ class ServiceManager {
 
   auto GetServiceList(GId group_id) {
     std::vector<std::tuple<std::string, std::string, bool>> ret;
+    auto group = enable_matrix_.Group(group_id);
     for (auto &[name, sv] : service_name_map_)
-      ret.emplace_back(name, sv->GetDescription(), sv->GroupStatus(group_id));
+      ret.emplace_back(name, sv->GetDescription(), sv->GroupStatus(group));
     return ret;
   }
 
@@ -84,8 +87,9 @@ class ServiceManager {
       const std::string &bundle_name, GId group_id) {
     if (!bundle_service_map_.contains(bundle_name)) return {};
     std::vector<std::tuple<std::string, std::string, bool>> ret;
+    auto group = enable_matrix_.Group(group_id);
     for (auto &[name, sv] : bundle_service_map_.at(bundle_name))
-      ret.emplace_back(name, sv->GetDescription(), sv->GroupStatus(group_id));
+      ret.emplace_back(name, sv->GetDescription(), sv->GroupStatus(group));
     return ret;
   }
 
@@ -115,6 +119,8 @@ class ServiceManager {
   std::map<std::string, std::multimap<std::string, std::shared_ptr<Service>>>
       bundle_service_map_;
   std::multimap<std::string, std::shared_ptr<Service>> service_name_map_;
+
+  EnableMatrix enable_matrix_;
 };
 }  // namespace white
 
@@ -0,0 +1,262 @@
+#ifndef MIGANGBOT_SERVICE_SERVICE_STORE_H_
+#define MIGANGBOT_SERVICE_SERVICE_STORE_H_
+
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "global_config.h"
+#include "logger/logger.h"
+#include "type.h"
+
+namespace white {
+
+// 服务启用状态的持久化。kServiceDir下的services.json为快照，
+// services.journal为追加写的变更日志，每行一条JSON记录；
+// 启动时一次性读入快照并重放日志，修改只写内存并交给后台线程
+// 批量追加到日志(一批一次fsync)，日志过长时压缩为新快照
+class ServiceStore {
+ public:
+  struct State {
+    bool enable_on_default;
+    // 状态与默认相反的群
+    std::unordered_set<GId> groups;
+  };
+
+  static ServiceStore &GetInstance() {
+    static ServiceStore store;
+    return store;
+  }
+
+ public:
+  // 首次出现的服务会尝试读取旧版的<name>.json，否则使用代码中的默认值
+  State Load(const std::string &service_name, const bool enable_on_default);
+
+  // 仅在状态确实改变时写日志，同名的多个服务共享一份状态
+  void Record(const std::string &service_name, const GId group_id,
+              const bool toggled);
+
+ public:
+  ServiceStore(const ServiceStore &) = delete;
+  ServiceStore &operator=(const ServiceStore &) = delete;
+  ServiceStore(ServiceStore &&) = delete;
+  ServiceStore &operator=(ServiceStore &&) = delete;
+
+ private:
+  ServiceStore();
+  ~ServiceStore();
+
+  void Replay();
+
+  void FlushLoop();
+
+  void Append(const std::vector<std::string> &records);
+
+  bool Compact(const std::unordered_map<std::string, State> &states);
+
+  static void Apply(State &state, const GId group_id, const bool toggled) {
+    if (toggled)
+      state.groups.insert(group_id);
+    else
+      state.groups.erase(group_id);
+  }
+
+ private:
+  // 攒批的时间窗口
+  static constexpr auto kFlushInterval = std::chrono::milliseconds(200);
+  // 日志超过该记录数时压缩
+  static constexpr std::size_t kCompactThreshold = 4096;
+
+  const std::filesystem::path snapshot_path_;
+  const std::filesystem::path journal_path_;
+
+  std::unordered_map<std::string, State> states_;
+  std::vector<std::string> pending_;
+  std::size_t journal_records_ = 0;
+  bool need_compact_ = false;
+  bool stop_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread flusher_;
+};
+
+inline ServiceStore::ServiceStore()
+    : snapshot_path_(config::kServiceDir / "services.json"),
+      journal_path_(config::kServiceDir / "services.journal") {
+  Replay();
+  flusher_ = std::thread([this] { FlushLoop(); });
+}
+
+inline ServiceStore::~ServiceStore() {
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  if (flusher_.joinable()) flusher_.join();
+}
+
+inline void ServiceStore::Replay() {
+  if (std::filesystem::exists(snapshot_path_)) {
+    try {
+      Json snapshot;
+      std::ifstream(snapshot_path_) >> snapshot;
+      for (auto &[name, config] : snapshot.items()) {
+        auto &state = states_[name];
+        state.enable_on_default = config["enable_on_default"].get<bool>();
+        for (auto &group : config["groups"]) state.groups.insert(group.get<GId>());
+      }
+    } catch (const std::exception &e) {
+      LOG_ERROR("读取服务状态快照失败: {}", e.what());
+    }
+  }
+  if (std::filesystem::exists(journal_path_)) {
+    std::ifstream journal(journal_path_);
+    std::string line;
+    while (std::getline(journal, line)) {
+      if (line.empty()) continue;
+      // 最后一行可能因崩溃只写了一半，跳过即可
+      auto record = Json::parse(line, nullptr, false);
+      if (record.is_discarded()) continue;
+      auto [it, _] = states_.try_emplace(
+          record["service"].get<std::string>(),
+          State{record["enable_on_default"].get<bool>(), {}});
+      Apply(it->second, record["group"].get<GId>(),
+            record["toggled"].get<bool>());
+      ++journal_records_;
+    }
+  }
+  // 启动时把重放结果压缩掉，日志从空开始
+  if (journal_records_) need_compact_ = true;
+}
+
+inline ServiceStore::State ServiceStore::Load(
+    const std::string &service_name, const bool enable_on_default) {
+  std::lock_guard<std::mutex> locker(mutex_);
+  if (auto it = states_.find(service_name); it != states_.end())
+    return it->second;
+  State state{enable_on_default, {}};
+  auto legacy_path = config::kServiceDir / (service_name + ".json");
+  if (std::filesystem::exists(legacy_path)) {
+    try {
+      Json config;
+      std::ifstream(legacy_path) >> config;
+      state.enable_on_default = config["enable_on_default"].get<bool>();
+      for (auto &group : config["groups"]) state.groups.insert(group.get<GId>());
+    } catch (const std::exception &e) {
+      LOG_ERROR("读取服务[{}]的配置失败: {}", service_name, e.what());
+    }
+  }
+  states_.emplace(service_name, state);
+  need_compact_ = true;
+  cv_.notify_one();
+  return state;
+}
+
+inline void ServiceStore::Record(const std::string &service_name,
+                                 const GId group_id, const bool toggled) {
+  std::lock_guard<std::mutex> locker(mutex_);
+  auto it = states_.find(service_name);
+  if (it == states_.end()) return;
+  auto &state = it->second;
+  if (state.groups.contains(group_id) == toggled) return;
+  Apply(state, group_id, toggled);
+  pending_.push_back(Json{{"service", service_name},
+                          {"enable_on_default", state.enable_on_default},
+                          {"group", group_id},
+                          {"toggled", toggled}}
+                         .dump());
+  cv_.notify_one();
+}
+
+inline void ServiceStore::FlushLoop() {
+  std::unique_lock<std::mutex> locker(mutex_);
+  while (true) {
+    cv_.wait(locker,
+             [this] { return stop_ || need_compact_ || !pending_.empty(); });
+    // 等一个时间窗口，把这段时间内的修改合成一次写入
+    if (!stop_) cv_.wait_for(locker, kFlushInterval, [this] { return stop_; });
+    auto records = std::move(pending_);
+    pending_.clear();
+    const bool compact =
+        need_compact_ || journal_records_ + records.size() >= kCompactThreshold;
+    if (compact) {
+      // 快照已包含所有待写的修改，不必再追加日志
+      auto states = states_;
+      need_compact_ = false;
+      locker.unlock();
+      // 压缩失败时退回到追加日志，修改不会丢失
+      const bool compacted = Compact(states);
+      if (!compacted) Append(records);
+      locker.lock();
+      journal_records_ = compacted ? 0 : journal_records_ + records.size();
+    } else if (!records.empty()) {
+      journal_records_ += records.size();
+      locker.unlock();
+      Append(records);
+      locker.lock();
+    }
+    if (stop_ && pending_.empty() && !need_compact_) return;
+  }
+}
+
+inline void ServiceStore::Append(const std::vector<std::string> &records) {
+  if (records.empty()) return;
+  auto file = std::fopen(journal_path_.c_str(), "a");
+  if (!file) {
+    LOG_ERROR("打开服务状态日志[{}]失败", journal_path_.string());
+    return;
+  }
+  for (const auto &record : records) {
+    std::fwrite(record.data(), 1, record.size(), file);
+    std::fputc('\n', file);
+  }
+  std::fflush(file);
+  ::fsync(::fileno(file));
+  std::fclose(file);
+}
+
+inline bool ServiceStore::Compact(
+    const std::unordered_map<std::string, State> &states) {
+  Json snapshot = Json::object();
+  for (const auto &[name, state] : states)
+    snapshot[name] = {{"enable_on_default", state.enable_on_default},
+                      {"groups", state.groups}};
+  auto dump = snapshot.dump(4);
+  auto tmp_path = snapshot_path_;
+  tmp_path += ".tmp";
+  auto file = std::fopen(tmp_path.c_str(), "w");
+  if (!file) {
+    LOG_ERROR("写入服务状态快照[{}]失败", tmp_path.string());
+    return false;
+  }
+  std::fwrite(dump.data(), 1, dump.size(), file);
+  std::fflush(file);
+  ::fsync(::fileno(file));
+  std::fclose(file);
+  // 先替换快照再清空日志，中途崩溃时重放旧日志也是幂等的
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, snapshot_path_, ec);
+  if (ec) {
+    LOG_ERROR("替换服务状态快照失败: {}", ec.message());
+    return false;
+  }
+  std::filesystem::resize_file(journal_path_, 0, ec);
+  return true;
+}
+
+}  // namespace white
+
+#endif
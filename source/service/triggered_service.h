@@ -12,11 +12,13 @@
 #include <utility>
 
 #include "bot/onebot_11/api_bot.h"
+#include "event/decoded_event.h"
 #include "event/type.h"
 #include "global_config.h"
 #include "permission/permission.h"
 #include "type.h"
 #include "event/event.h"
+#include "service/bulkhead.h"
 #include "service/service.h"
 
 namespace white {
@@ -32,7 +34,8 @@ class TriggeredService : public Service {
                 enable_on_default),
         func_(new onebot11::FunctionForPlugin(std::forward<Func>(func))),
         use_permission_(use_permission),
-        only_to_me_(only_to_me) {}
+        only_to_me_(only_to_me),
+        bulkhead_(Bulkhead::Of(service_name)) {}
 
   template <typename Func>
   TriggeredService(const std::string &service_name, Func &&func,
@@ -84,20 +87,34 @@ class TriggeredService : public Service {
     return permission >= use_permission_;
   }
 
-  bool CheckIsEnable(const GId group_id) const noexcept {
-    if (enable_on_default_) return !groups_.count(group_id);
-    return groups_.count(group_id);
+  // 同一事件检查多个服务时，群的行只在第一次检查时查询
+  bool CheckIsEnable(const DecodedEvent &event) const noexcept {
+    if (auto matrix = Matrix()) return GroupStatus(event.Group(*matrix));
+    return GroupStatus(event.group_id);
   }
 
   bool CheckToMe(const bool to_me) const noexcept {
     return !only_to_me_ || to_me;
   }
 
-  template <typename... Args>
-  void Run(Args &&...args) const noexcept {
+  // 群消息需检查是否启用，指令还需在群内检查to_me
+  bool Check(const DecodedEvent &event,
+             const bool is_command = false) const noexcept {
+    if (event.message_type == MessageType::kGroup &&
+        (!CheckIsEnable(event) ||
+         (is_command && !CheckToMe(event.to_me))))
+      return false;
+    return CheckPerm(event.permission);
+  }
+
+  Bulkhead &GetBulkhead() const noexcept { return bulkhead_; }
+
+  // permit在插件执行完毕(返回Task时为协程结束)后才释放
+  void Run(const Event &event, onebot11::ApiBot &bot,
+           Bulkhead::Permit permit = nullptr) const noexcept {
     LOG_INFO("Handled by [{}]", service_name_);
     try {
-      func_->Run(std::forward<Args>(args)...);
+      func_->Run(event, bot, std::move(permit));
     } catch (const std::exception &e) {
       LOG_ERROR("Exception Happened: {}", e.what());
     }
@@ -108,6 +125,8 @@ class TriggeredService : public Service {
   const int use_permission_;
 
   const bool only_to_me_;
+
+  Bulkhead &bulkhead_;
 };
 }  // namespace white
 
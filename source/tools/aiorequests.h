@@ -9,6 +9,7 @@
 #include <string>
 
 #include "co_future.h"
+#include "tools/single_flight.h"
 
 namespace white {
 namespace aiorequests {
@@ -17,8 +18,13 @@ using requests::Request;
 using requests::Response;
 using requests::ResponseCallback;
 
-inline co_future<Response> aiorequest(Request &&req) {
+inline hv::HttpClient &Client() {
   static hv::HttpClient cli;
+  return cli;
+}
+
+inline co_future<Response> aiorequest(Request &&req) {
+  auto &cli = Client();
   auto promise = std::make_shared<co_promise<Response>>();
   auto ret = promise->get_future();
   cli.sendAsync(req, [promise = std::move(promise)](const Response& resp) {
@@ -52,6 +58,33 @@ inline co_future<Response> Get(const std::string& url, std::size_t timeout = 30,
   return aiorequest(HTTP_GET, url.c_str(), timeout, NoBody, headers);
 }
 
+// 与Get相同，但相同url与请求头的并发请求只发出一次，各调用方得到同一个
+// Response，只能读取。json响应在共享前先解析好，并发调用GetJson不会重复解析
+inline co_future<Response> SharedGet(
+    const std::string& url, std::size_t timeout = 30,
+    const http_headers& headers = DefaultHeaders) {
+  static SingleFlight<Response> flight("http_get");
+  std::string key = url;
+  if (&headers != &DefaultHeaders)
+    for (const auto& [name, value] : headers)
+      key.append("\n").append(name).append(": ").append(value);
+  return flight.Do(key, [&] {
+    auto promise = std::make_shared<co_promise<Response>>();
+    auto ret = promise->get_future();
+    auto req = std::make_shared<HttpRequest>();
+    req->method = HTTP_GET;
+    req->url = url;
+    req->timeout = timeout;
+    if (&headers != &DefaultHeaders) req->headers = headers;
+    Client().sendAsync(req, [promise = std::move(promise)](
+                                const Response& resp) {
+      if (resp && resp->ContentType() == APPLICATION_JSON) resp->GetJson();
+      promise->set_value(resp);
+    });
+    return ret;
+  });
+}
+
 inline co_future<Response> Post(const std::string& url, std::size_t timeout = 30,
                      const http_body& body = NoBody,
                      const http_headers& headers = DefaultHeaders) {
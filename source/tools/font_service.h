@@ -0,0 +1,223 @@
+#ifndef MIGANGBOT_TOOLS_FONT_SERVICE_H_
+#define MIGANGBOT_TOOLS_FONT_SERVICE_H_
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <utf8.h>
+
+#include "logger/logger.h"
+
+namespace white {
+namespace render {
+
+// 按线程缓存的字体与字形。FT_Library不是线程安全的，每个渲染线程各持有一份：
+// 字体文件在线程内只加载一次，光栅化后的字形按(字体, 字号, 码点)缓存，
+// 绘制时只需把缓存的覆盖率位图与底图混合，不再每次重新排版与光栅化
+class FontService {
+ public:
+  static FontService &ThreadLocal() {
+    thread_local FontService service;
+    return service;
+  }
+
+ public:
+  // 返回文字的宽与高(ascender - descender)，baseline为基线到底部的距离
+  cv::Size GetTextSize(const std::filesystem::path &font,
+                       const std::string_view &text, const int height,
+                       int *baseline = nullptr);
+
+  // org为文字的左上角，按字形覆盖率将color混合到img上
+  void PutText(cv::Mat &img, const std::filesystem::path &font,
+               const std::string_view &text, const cv::Point &org,
+               const int height, const cv::Scalar &color);
+
+ public:
+  FontService(const FontService &) = delete;
+  FontService &operator=(const FontService &) = delete;
+
+ private:
+  FontService() {
+    if (FT_Init_FreeType(&library_)) {
+      LOG_ERROR("FreeType初始化失败");
+      library_ = nullptr;
+    }
+  }
+
+  ~FontService() {
+    for (auto face : faces_) FT_Done_Face(face);
+    if (library_) FT_Done_FreeType(library_);
+  }
+
+  struct Glyph {
+    // 8位覆盖率
+    cv::Mat bitmap;
+    int left = 0;
+    int top = 0;
+    int advance = 0;
+  };
+
+  struct SizeMetrics {
+    int ascender = 0;
+    int descender = 0;
+  };
+
+  // 加载失败时返回-1
+  int FaceOf(const std::filesystem::path &font);
+
+  void SetSize(const int face_id, const int height);
+
+  const SizeMetrics &MetricsOf(const int face_id, const int height);
+
+  const Glyph &GlyphOf(const int face_id, const int height,
+                       const char32_t codepoint);
+
+  // 依次对每个码点调用func，遇到非法的utf8时停止
+  template <typename Func>
+  static void ForEachCodepoint(const std::string_view &text, Func &&func);
+
+  static uint64_t Key(const int face_id, const int height,
+                      const uint64_t low) noexcept {
+    return (uint64_t(face_id) << 40) | (uint64_t(height & 0xffff) << 24) |
+           low;
+  }
+
+ private:
+  // 单个线程缓存的字形数上限，超过时整体清空
+  static constexpr std::size_t kMaxGlyphs = 16384;
+
+  FT_Library library_ = nullptr;
+  std::vector<FT_Face> faces_;
+  std::vector<int> face_heights_;
+  std::unordered_map<std::string, int> face_ids_;
+  std::unordered_map<uint64_t, SizeMetrics> metrics_;
+  std::unordered_map<uint64_t, Glyph> glyphs_;
+};
+
+inline int FontService::FaceOf(const std::filesystem::path &font) {
+  if (auto it = face_ids_.find(font.native()); it != face_ids_.end())
+    return it->second;
+  FT_Face face = nullptr;
+  int id = -1;
+  if (library_ && !FT_New_Face(library_, font.c_str(), 0, &face)) {
+    id = faces_.size();
+    faces_.push_back(face);
+    face_heights_.push_back(0);
+  } else {
+    LOG_ERROR("加载字体[{}]失败", font.string());
+  }
+  // 加载失败也记下来，避免每次都重试
+  face_ids_.emplace(font.native(), id);
+  return id;
+}
+
+inline void FontService::SetSize(const int face_id, const int height) {
+  if (face_heights_[face_id] == height) return;
+  FT_Set_Pixel_Sizes(faces_[face_id], 0, height);
+  face_heights_[face_id] = height;
+}
+
+inline const FontService::SizeMetrics &FontService::MetricsOf(
+    const int face_id, const int height) {
+  auto [it, inserted] = metrics_.try_emplace(Key(face_id, height, 0));
+  if (inserted) {
+    SetSize(face_id, height);
+    const auto &metrics = faces_[face_id]->size->metrics;
+    it->second.ascender = metrics.ascender >> 6;
+    it->second.descender = metrics.descender >> 6;
+  }
+  return it->second;
+}
+
+inline const FontService::Glyph &FontService::GlyphOf(
+    const int face_id, const int height, const char32_t codepoint) {
+  auto key = Key(face_id, height, codepoint);
+  if (auto it = glyphs_.find(key); it != glyphs_.end()) return it->second;
+  if (glyphs_.size() >= kMaxGlyphs) glyphs_.clear();
+  auto &glyph = glyphs_[key];
+  SetSize(face_id, height);
+  auto face = faces_[face_id];
+  if (FT_Load_Char(face, codepoint, FT_LOAD_RENDER)) return glyph;
+  const auto slot = face->glyph;
+  const auto &bitmap = slot->bitmap;
+  glyph.left = slot->bitmap_left;
+  glyph.top = slot->bitmap_top;
+  glyph.advance = slot->advance.x >> 6;
+  if (bitmap.rows && bitmap.width) {
+    glyph.bitmap.create(bitmap.rows, bitmap.width, CV_8UC1);
+    for (unsigned int y = 0; y < bitmap.rows; ++y)
+      std::copy_n(bitmap.buffer + y * bitmap.pitch, bitmap.width,
+                  glyph.bitmap.ptr<uchar>(y));
+  }
+  return glyph;
+}
+
+template <typename Func>
+inline void FontService::ForEachCodepoint(const std::string_view &text,
+                                          Func &&func) {
+  auto it = text.begin();
+  try {
+    while (it != text.end()) func(utf8::next(it, text.end()));
+  } catch (const utf8::exception &) {
+  }
+}
+
+inline cv::Size FontService::GetTextSize(const std::filesystem::path &font,
+                                         const std::string_view &text,
+                                         const int height, int *baseline) {
+  if (baseline) *baseline = 0;
+  auto face_id = FaceOf(font);
+  if (face_id < 0) return {0, 0};
+  const auto &metrics = MetricsOf(face_id, height);
+  int width = 0;
+  ForEachCodepoint(text, [&](const char32_t codepoint) {
+    width += GlyphOf(face_id, height, codepoint).advance;
+  });
+  if (baseline) *baseline = -metrics.descender;
+  return {width, metrics.ascender - metrics.descender};
+}
+
+inline void FontService::PutText(cv::Mat &img,
+                                 const std::filesystem::path &font,
+                                 const std::string_view &text,
+                                 const cv::Point &org, const int height,
+                                 const cv::Scalar &color) {
+  auto face_id = FaceOf(font);
+  if (face_id < 0 || img.depth() != CV_8U) return;
+  const int channels = img.channels();
+  const int pen_y = org.y + MetricsOf(face_id, height).ascender;
+  int pen_x = org.x;
+  ForEachCodepoint(text, [&](const char32_t codepoint) {
+    const auto &glyph = GlyphOf(face_id, height, codepoint);
+    const int x0 = pen_x + glyph.left, y0 = pen_y - glyph.top;
+    pen_x += glyph.advance;
+    for (int y = std::max(0, -y0); y < glyph.bitmap.rows; ++y) {
+      if (y0 + y >= img.rows) break;
+      const auto *src = glyph.bitmap.ptr<uchar>(y);
+      auto *dst = img.ptr<uchar>(y0 + y);
+      for (int x = std::max(0, -x0); x < glyph.bitmap.cols; ++x) {
+        if (x0 + x >= img.cols) break;
+        const int alpha = src[x];
+        if (!alpha) continue;
+        auto *pixel = dst + (x0 + x) * channels;
+        for (int c = 0; c < channels && c < 4; ++c)
+          pixel[c] = static_cast<uchar>(
+              (pixel[c] * (255 - alpha) + color[c] * alpha + 127) / 255);
+      }
+    }
+  });
+}
+
+}  // namespace render
+}  // namespace white
+
+#endif
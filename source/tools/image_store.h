@@ -0,0 +1,132 @@
+#ifndef MIGANGBOT_TOOLS_IMAGE_STORE_H_
+#define MIGANGBOT_TOOLS_IMAGE_STORE_H_
+
+#include <openssl/evp.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "global_config.h"
+#include "logger/logger.h"
+#include "metrics/metrics.h"
+
+namespace white {
+namespace render {
+
+// 生成图片的存储，文件名为内容哈希，由内置的http服务在/img/下提供。
+// 同一张图片只写一次；读取由libhv的静态文件缓存负责，
+// 热点图片常驻内存，直接从缓存写出，不再经过websocket帧
+class ImageStore {
+ public:
+  static ImageStore &GetInstance() {
+    static ImageStore store;
+    return store;
+  }
+
+ public:
+  // 保存编码好的jpg，返回内容哈希，失败时返回空串
+  std::string Put(const std::vector<unsigned char> &jpeg);
+
+  const std::filesystem::path &Dir() const noexcept { return dir_; }
+
+  std::filesystem::path PathOf(const std::string &hash) const {
+    return dir_ / (hash + ".jpg");
+  }
+
+ public:
+  ImageStore(const ImageStore &) = delete;
+  ImageStore &operator=(const ImageStore &) = delete;
+  ImageStore(ImageStore &&) = delete;
+  ImageStore &operator=(ImageStore &&) = delete;
+
+ private:
+  ImageStore();
+  ~ImageStore() = default;
+
+  // 启动时清理长时间未写入的图片
+  void Prune();
+
+ private:
+  // 与渲染缓存磁盘层的保留时间一致，缓存中的url不会指向已删除的图片
+  static constexpr auto kTtl = std::chrono::hours(24 * 7);
+
+  const std::filesystem::path dir_;
+  std::unordered_set<std::string> stored_;
+  std::mutex mutex_;
+
+  metrics::Metric &writes_;
+  metrics::Metric &bytes_;
+};
+
+inline ImageStore::ImageStore()
+    : dir_(config::AssetsPath("image_store")),
+      writes_(metrics::GetMetric("image_store.writes")),
+      bytes_(metrics::GetMetric("image_store.bytes")) {
+  Prune();
+}
+
+inline std::string ImageStore::Put(const std::vector<unsigned char> &jpeg) {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int digest_size = 0;
+  EVP_Digest(jpeg.data(), jpeg.size(), digest, &digest_size, EVP_sha256(),
+             nullptr);
+  std::string hash;
+  hash.reserve(32);
+  for (int i = 0; i < 16; ++i)
+    fmt::format_to(std::back_inserter(hash), "{:02x}", digest[i]);
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    if (stored_.contains(hash)) return hash;
+  }
+  // 先写临时文件再改名，http服务不会读到写了一半的图片；
+  // 同一张图片并发写入时内容相同，谁后改名都一样
+  auto path = PathOf(hash);
+  auto tmp_path = path;
+  tmp_path += fmt::format(".{}.tmp", std::hash<std::thread::id>()(
+                                         std::this_thread::get_id()));
+  auto file = std::fopen(tmp_path.c_str(), "wb");
+  std::error_code ec;
+  if (file) {
+    std::fwrite(jpeg.data(), 1, jpeg.size(), file);
+    std::fclose(file);
+    std::filesystem::rename(tmp_path, path, ec);
+  }
+  if (!file || ec) {
+    LOG_ERROR("保存图片[{}]失败", path.string());
+    return "";
+  }
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    if (!stored_.insert(hash).second) return hash;
+  }
+  writes_.Add();
+  bytes_.Add(jpeg.size());
+  return hash;
+}
+
+inline void ImageStore::Prune() {
+  std::error_code ec;
+  const auto now = std::filesystem::file_time_type::clock::now();
+  for (auto &file : std::filesystem::directory_iterator(dir_, ec)) {
+    auto mtime = file.last_write_time(ec);
+    if (ec) continue;
+    if (now - mtime > kTtl || file.path().extension() != ".jpg")
+      std::filesystem::remove(file, ec);
+    else
+      stored_.insert(file.path().stem().string());
+  }
+}
+
+}  // namespace render
+}  // namespace white
+
+#endif
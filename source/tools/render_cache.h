@@ -0,0 +1,277 @@
+#ifndef MIGANGBOT_TOOLS_RENDER_CACHE_H_
+#define MIGANGBOT_TOOLS_RENDER_CACHE_H_
+
+#include <openssl/evp.h>
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "co_future.h"
+#include "global_config.h"
+#include "logger/logger.h"
+#include "metrics/metrics.h"
+#include "tools/render_pool.h"
+
+namespace white {
+namespace render {
+
+// 生成图片的内容寻址缓存，键为(模板, 输入)的哈希，值为已编码好的消息内容。
+// 输入相同则图片相同，启用状态、天气等变化会自然得到新的键，
+// 旧的项由LRU淘汰；按天变化的内容通过expire_at在零点过期。
+// 内存中按字节数做LRU，可选在磁盘上再存一层，重启后仍可命中
+class RenderCache {
+ public:
+  static RenderCache &GetInstance() {
+    static RenderCache cache;
+    return cache;
+  }
+
+  // 内容哈希的十六进制表示，同时用作磁盘上的文件名
+  static std::string Hash(const std::string_view &tmpl,
+                          const std::string_view &inputs);
+
+ public:
+  // 在内存中查找，命中时返回已编码的内容，已过期的项视为未命中
+  std::optional<std::string> Get(const std::string &key);
+
+  // 在磁盘层查找，命中后放回内存；涉及文件读写，应在渲染线程上调用
+  std::optional<std::string> Load(const std::string &key);
+
+  // 写入一次新渲染的结果，expire_at为0表示不过期
+  void Put(const std::string &key, const std::string &tmpl,
+           const std::string &payload, const std::time_t expire_at = 0);
+
+  // 丢弃某个模板的全部内存项。磁盘项为内容寻址，不会给出错误的结果，
+  // 留给PruneDisk清理。模板名用作磁盘项的头部，不能含空白
+  void Invalidate(const std::string_view &tmpl);
+
+ public:
+  RenderCache(const RenderCache &) = delete;
+  RenderCache &operator=(const RenderCache &) = delete;
+  RenderCache(RenderCache &&) = delete;
+  RenderCache &operator=(RenderCache &&) = delete;
+
+ private:
+  RenderCache();
+  ~RenderCache() = default;
+
+  struct Entry {
+    std::string key;
+    std::string tmpl;
+    std::string payload;
+    std::time_t expire_at;
+  };
+
+  using List = std::list<Entry>;
+
+  void Insert(Entry &&entry);
+
+  void Erase(List::iterator it);
+
+  std::optional<std::string> LoadFromDisk(const std::string &key);
+
+  void SaveToDisk(const Entry &entry);
+
+  // 启动时清理长时间未使用的磁盘项
+  void PruneDisk();
+
+ private:
+  // 磁盘项超过该时间未被写入则删除
+  static constexpr auto kDiskTtl = std::chrono::hours(24 * 7);
+
+  std::size_t capacity_;
+  std::size_t size_ = 0;
+  // 最近使用的在前
+  List lru_;
+  std::unordered_map<std::string_view, List::iterator> index_;
+  std::mutex mutex_;
+
+  // 为空表示不启用磁盘层
+  std::filesystem::path disk_dir_;
+
+  metrics::Metric &hit_;
+  metrics::Metric &disk_hit_;
+  metrics::Metric &miss_;
+  metrics::Metric &bytes_;
+};
+
+inline RenderCache::RenderCache()
+    : capacity_((config::RENDER_CACHE_MB ? config::RENDER_CACHE_MB : 64)
+                << 20),
+      hit_(metrics::GetMetric("render.cache.hit")),
+      disk_hit_(metrics::GetMetric("render.cache.disk_hit")),
+      miss_(metrics::GetMetric("render.cache.miss")),
+      bytes_(metrics::GetMetric("render.cache.bytes")) {
+  if (config::RENDER_CACHE_DISK) {
+    disk_dir_ = config::AssetsPath("render_cache");
+    PruneDisk();
+  }
+}
+
+inline std::string RenderCache::Hash(const std::string_view &tmpl,
+                                     const std::string_view &inputs) {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int digest_size = 0;
+  auto ctx = EVP_MD_CTX_new();
+  EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+  EVP_DigestUpdate(ctx, tmpl.data(), tmpl.size());
+  // 分隔符避免("ab", "c")与("a", "bc")得到相同的哈希
+  EVP_DigestUpdate(ctx, "", 1);
+  EVP_DigestUpdate(ctx, inputs.data(), inputs.size());
+  // 图片的发送方式不同，编码后的内容也不同，切换后不能命中旧的项
+  EVP_DigestUpdate(ctx, config::IMAGE_BASE_URL.data(),
+                   config::IMAGE_BASE_URL.size() + 1);
+  EVP_DigestFinal_ex(ctx, digest, &digest_size);
+  EVP_MD_CTX_free(ctx);
+  // 128位足够区分，文件名也短一些
+  std::string ret;
+  ret.reserve(32);
+  for (int i = 0; i < 16; ++i)
+    fmt::format_to(std::back_inserter(ret), "{:02x}", digest[i]);
+  return ret;
+}
+
+inline std::optional<std::string> RenderCache::Get(const std::string &key) {
+  std::lock_guard<std::mutex> locker(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) return std::nullopt;
+  auto entry = it->second;
+  if (entry->expire_at && entry->expire_at <= std::time(nullptr)) {
+    Erase(entry);
+    return std::nullopt;
+  }
+  lru_.splice(lru_.begin(), lru_, entry);
+  hit_.Add();
+  return entry->payload;
+}
+
+inline std::optional<std::string> RenderCache::Load(const std::string &key) {
+  if (disk_dir_.empty()) return std::nullopt;
+  auto payload = LoadFromDisk(key);
+  if (payload) disk_hit_.Add();
+  return payload;
+}
+
+inline void RenderCache::Put(const std::string &key, const std::string &tmpl,
+                             const std::string &payload,
+                             const std::time_t expire_at) {
+  miss_.Add();
+  Entry entry{key, tmpl, payload, expire_at};
+  if (!disk_dir_.empty()) SaveToDisk(entry);
+  std::lock_guard<std::mutex> locker(mutex_);
+  Insert(std::move(entry));
+}
+
+inline void RenderCache::Invalidate(const std::string_view &tmpl) {
+  std::lock_guard<std::mutex> locker(mutex_);
+  for (auto it = lru_.begin(); it != lru_.end();) {
+    auto next = std::next(it);
+    if (it->tmpl == tmpl) Erase(it);
+    it = next;
+  }
+}
+
+inline void RenderCache::Insert(Entry &&entry) {
+  if (entry.payload.size() > capacity_) return;
+  if (auto it = index_.find(entry.key); it != index_.end()) Erase(it->second);
+  size_ += entry.payload.size();
+  bytes_.Add(entry.payload.size());
+  lru_.push_front(std::move(entry));
+  index_.emplace(lru_.front().key, lru_.begin());
+  while (size_ > capacity_) Erase(std::prev(lru_.end()));
+}
+
+inline void RenderCache::Erase(List::iterator it) {
+  size_ -= it->payload.size();
+  bytes_.Sub(it->payload.size());
+  index_.erase(it->key);
+  lru_.erase(it);
+}
+
+// 磁盘项的第一行为过期时间与模板名，其后为内容
+inline std::optional<std::string> RenderCache::LoadFromDisk(
+    const std::string &key) {
+  std::ifstream file(disk_dir_ / key, std::ios::binary);
+  if (!file) return std::nullopt;
+  std::time_t expire_at = 0;
+  std::string tmpl;
+  file >> expire_at >> tmpl;
+  file.get();
+  if (!file || (expire_at && expire_at <= std::time(nullptr)))
+    return std::nullopt;
+  std::string payload((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+  std::lock_guard<std::mutex> locker(mutex_);
+  Insert(Entry{key, std::move(tmpl), payload, expire_at});
+  return payload;
+}
+
+inline void RenderCache::SaveToDisk(const Entry &entry) {
+  // 先写临时文件再改名，其他线程不会读到写了一半的内容
+  auto path = disk_dir_ / entry.key;
+  auto tmp_path = path;
+  tmp_path += ".tmp";
+  auto file = std::fopen(tmp_path.c_str(), "wb");
+  if (!file) {
+    LOG_ERROR("写入渲染缓存[{}]失败", tmp_path.string());
+    return;
+  }
+  auto header = fmt::format("{} {}\n", entry.expire_at, entry.tmpl);
+  std::fwrite(header.data(), 1, header.size(), file);
+  std::fwrite(entry.payload.data(), 1, entry.payload.size(), file);
+  std::fclose(file);
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, path, ec);
+}
+
+inline void RenderCache::PruneDisk() {
+  std::error_code ec;
+  const auto now = std::filesystem::file_time_type::clock::now();
+  for (auto &file : std::filesystem::directory_iterator(disk_dir_, ec)) {
+    auto mtime = file.last_write_time(ec);
+    if (!ec && now - mtime > kDiskTtl) std::filesystem::remove(file, ec);
+  }
+}
+
+// 按(模板, 输入)查缓存，未命中时在渲染线程池中调用render生成并写入缓存。
+// 内存命中时直接返回已完成的co_future，磁盘查找与渲染都不在调用方线程上
+template <typename F>
+inline co_future<std::string> CachedRender(const std::string &tmpl,
+                                           const std::string &inputs,
+                                           F &&render,
+                                           const std::time_t expire_at = 0) {
+  auto &cache = RenderCache::GetInstance();
+  auto key = RenderCache::Hash(tmpl, inputs);
+  if (auto payload = cache.Get(key)) {
+    co_promise<std::string> promise;
+    auto ret = promise.get_future();
+    promise.set_value(std::move(*payload));
+    return ret;
+  }
+  return Submit([&cache, key = std::move(key), tmpl,
+                 render = std::forward<F>(render), expire_at]() mutable {
+    if (auto payload = cache.Load(key)) return std::move(*payload);
+    auto payload = render();
+    if (!payload.empty()) cache.Put(key, tmpl, payload, expire_at);
+    return payload;
+  });
+}
+
+}  // namespace render
+}  // namespace white
+
+#endif
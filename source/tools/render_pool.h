@@ -0,0 +1,171 @@
+#ifndef MIGANGBOT_TOOLS_RENDER_POOL_H_
+#define MIGANGBOT_TOOLS_RENDER_POOL_H_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "co_future.h"
+#include "global_config.h"
+#include "logger/logger.h"
+#include "metrics/metrics.h"
+
+namespace white {
+namespace render {
+
+// 执行排版、图像合成与编码等CPU密集任务的专用线程池。
+// 这些任务动辄几十毫秒，直接在插件协程里执行会卡住整个调度线程，
+// 交给线程池后协程只需等待co_future，期间调度线程可以继续运行其他协程
+class RenderPool {
+ public:
+  static RenderPool &GetInstance() {
+    static RenderPool pool;
+    return pool;
+  }
+
+ public:
+  // func在渲染线程上执行，抛出的异常只记录日志，结果为默认值；
+  // 返回值须可默认构造(co_future不支持void)
+  template <typename F>
+  co_future<std::invoke_result_t<F &>> Submit(F &&func);
+
+ public:
+  RenderPool(const RenderPool &) = delete;
+  RenderPool &operator=(const RenderPool &) = delete;
+  RenderPool(RenderPool &&) = delete;
+  RenderPool &operator=(RenderPool &&) = delete;
+
+ private:
+  RenderPool();
+  ~RenderPool();
+
+  using Clock = std::chrono::steady_clock;
+
+  struct Job {
+    Clock::time_point enqueue_time;
+    std::function<void()> func;
+  };
+
+  void WorkLoop();
+
+  void Execute(Job &job);
+
+ private:
+  // 排队超过该长度时由提交者自己执行，避免无限堆积
+  static constexpr std::size_t kQueueLimit = 256;
+
+  std::deque<Job> queue_;
+  bool stop_ = false;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::thread> workers_;
+
+  metrics::Metric &queued_;
+  metrics::Metric &tasks_;
+  metrics::Metric &inline_;
+  metrics::Metric &queue_us_;
+  metrics::Metric &render_us_;
+};
+
+inline RenderPool::RenderPool()
+    : queued_(metrics::GetMetric("render.queued")),
+      tasks_(metrics::GetMetric("render.tasks")),
+      inline_(metrics::GetMetric("render.inline")),
+      queue_us_(metrics::GetMetric("render.queue_us")),
+      render_us_(metrics::GetMetric("render.render_us")) {
+  auto workers = config::RENDER_WORKERS;
+  if (workers == 0)
+    workers = std::max<std::size_t>(1, std::thread::hardware_concurrency() / 2);
+  for (std::size_t i = 0; i < workers; ++i)
+    workers_.emplace_back([this] { WorkLoop(); });
+}
+
+inline RenderPool::~RenderPool() {
+  {
+    std::lock_guard<std::mutex> locker(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto &worker : workers_)
+    if (worker.joinable()) worker.join();
+}
+
+template <typename F>
+inline co_future<std::invoke_result_t<F &>> RenderPool::Submit(F &&func) {
+  using Result = std::invoke_result_t<F &>;
+  auto promise = std::make_shared<co_promise<Result>>();
+  auto ret = promise->get_future();
+  Job job{Clock::now(),
+          [promise, func = std::forward<F>(func)]() mutable {
+            try {
+              promise->set_value(func());
+              return;
+            } catch (const std::exception &e) {
+              LOG_ERROR("渲染失败: {}", e.what());
+            } catch (...) {
+              LOG_ERROR("渲染失败");
+            }
+            promise->set_value(Result{});
+          }};
+  {
+    std::unique_lock<std::mutex> locker(mutex_);
+    if (queue_.size() < kQueueLimit) {
+      queue_.push_back(std::move(job));
+      queued_.Add();
+      locker.unlock();
+      cv_.notify_one();
+      return ret;
+    }
+  }
+  inline_.Add();
+  Execute(job);
+  return ret;
+}
+
+inline void RenderPool::WorkLoop() {
+  std::unique_lock<std::mutex> locker(mutex_);
+  while (true) {
+    cv_.wait(locker, [this] { return stop_ || !queue_.empty(); });
+    if (queue_.empty()) return;
+    auto job = std::move(queue_.front());
+    queue_.pop_front();
+    queued_.Sub();
+    locker.unlock();
+    Execute(job);
+    locker.lock();
+  }
+}
+
+inline void RenderPool::Execute(Job &job) {
+  auto start = Clock::now();
+  job.func();
+  auto end = Clock::now();
+  tasks_.Add();
+  queue_us_.Add(std::chrono::duration_cast<std::chrono::microseconds>(
+                    start - job.enqueue_time)
+                    .count());
+  render_us_.Add(
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+          .count());
+}
+
+// 在渲染线程池中执行func，调用方在get()或co_await时让出调度线程
+template <typename F>
+inline auto Submit(F &&func) {
+  return RenderPool::GetInstance().Submit(std::forward<F>(func));
+}
+
+}  // namespace render
+}  // namespace white
+
+#endif
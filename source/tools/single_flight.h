@@ -0,0 +1,87 @@
+#ifndef MIGANGBOT_TOOLS_SINGLE_FLIGHT_H_
+#define MIGANGBOT_TOOLS_SINGLE_FLIGHT_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "co_future.h"
+#include "metrics/metrics.h"
+
+namespace white {
+
+// 合并相同的并发请求：同一key已有进行中的请求时，后来者不再发起，
+// 只等待同一个结果。请求完成后立即移除，之后的调用会重新发起，
+// 因此不会返回过期的结果，缓存仍由调用方负责。
+// 每个调用方各得到一份结果的副本，T应可复制且复制代价小
+template <typename T>
+class SingleFlight {
+ public:
+  // name用于指标single_flight.<name>.started/shared
+  explicit SingleFlight(const std::string &name)
+      : state_(std::make_shared<State>()),
+        started_(metrics::GetMetric("single_flight." + name + ".started")),
+        shared_(metrics::GetMetric("single_flight." + name + ".shared")) {}
+
+  // start返回co_future<T>，只在没有进行中的同key请求时被调用。
+  // start不应抛出异常，否则等待同一key的调用方不会被唤醒
+  template <typename Start>
+  co_future<T> Do(const std::string &key, Start &&start);
+
+  // 进行中的请求数
+  std::size_t InFlight() const {
+    std::lock_guard<std::mutex> locker(state_->mutex);
+    return state_->calls.size();
+  }
+
+ private:
+  using Waiters = std::vector<std::shared_ptr<co_promise<T>>>;
+
+  struct State {
+    std::unordered_map<std::string, Waiters> calls;
+    mutable std::mutex mutex;
+  };
+
+  // 完成回调持有State，SingleFlight先于请求销毁也是安全的
+  const std::shared_ptr<State> state_;
+  metrics::Metric &started_;
+  metrics::Metric &shared_;
+};
+
+template <typename T>
+template <typename Start>
+inline co_future<T> SingleFlight<T>::Do(const std::string &key,
+                                        Start &&start) {
+  auto promise = std::make_shared<co_promise<T>>();
+  auto ret = promise->get_future();
+  {
+    std::lock_guard<std::mutex> locker(state_->mutex);
+    auto [it, inserted] = state_->calls.try_emplace(key);
+    it->second.push_back(std::move(promise));
+    if (!inserted) {
+      shared_.Add();
+      return ret;
+    }
+  }
+  started_.Add();
+  start().on_value([state = state_, key](T &&value) {
+    Waiters waiters;
+    {
+      std::lock_guard<std::mutex> locker(state->mutex);
+      auto it = state->calls.find(key);
+      waiters.swap(it->second);
+      state->calls.erase(it);
+    }
+    for (std::size_t i = 0; i + 1 < waiters.size(); ++i)
+      waiters[i]->set_value(value);
+    waiters.back()->set_value(std::move(value));
+  });
+  return ret;
+}
+
+}  // namespace white
+
+#endif
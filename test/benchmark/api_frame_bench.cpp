@@ -0,0 +1,57 @@
+// api请求帧：改动前构造nlohmann::json再dump，与ApiFrame直接写出对比。
+// 计时前先把写出的帧解析回来，确认与Json构造的请求相同
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "api/onebot_11/api_impl.h"
+#include "bench.h"
+#include "check.h"
+
+using namespace white;
+using namespace white::onebot11;
+
+namespace {
+
+constexpr GId kGroupId = 123456789;
+constexpr uint64_t kEcho = 123456789012;
+
+std::string LegacyFrame(const std::string &message) {
+  Json frame{{"action", "send_group_msg"},
+             {"params", Json{{"group_id", kGroupId},
+                             {"message", message},
+                             {"auto_escape", false}}}};
+  frame["echo"] = kEcho;
+  return frame.dump();
+}
+
+const std::string &Frame(const std::string &message) {
+  return api_impl::send_group_msg(kGroupId, message, false).Finish(kEcho);
+}
+
+}  // namespace
+
+int main() {
+  const std::string tricky = "你好\"\\\n\t\x01 [CQ:at,qq=1] end";
+  CHECK(Json::parse(Frame(tricky)) == Json::parse(LegacyFrame(tricky)));
+  CHECK(!Json::parse(api_impl::delete_msg(-5).Finish()).contains("echo"));
+
+  const std::string chat = "今天天气不错，大家一起去玩吧";
+  std::string article;
+  for (int i = 0; i < 200; ++i) article += "这是一条很长的消息，包含\"引号\"和换行\n";
+
+  auto before = bench::Run("Json + dump (chat)", 200000, [&] {
+    bench::DoNotOptimize(LegacyFrame(chat));
+  });
+  auto after = bench::Run("ApiFrame (chat)", 200000,
+                          [&] { bench::DoNotOptimize(Frame(chat).data()); });
+  bench::Speedup(before, after);
+
+  before = bench::Run("Json + dump (12KB)", 20000, [&] {
+    bench::DoNotOptimize(LegacyFrame(article));
+  });
+  after = bench::Run("ApiFrame (12KB)", 20000,
+                     [&] { bench::DoNotOptimize(Frame(article).data()); });
+  bench::Speedup(before, after);
+  return 0;
+}
@@ -0,0 +1,130 @@
+// CommandMatcher一次扫描 vs 全匹配表 + 前缀Trie + 后缀Trie + 逐个运行正则
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "event/command_matcher.h"
+#include "event/regex_matcher.h"
+#include "event/trie.h"
+#include "logger/logger.h"
+#include "utility.h"
+
+using namespace white;
+
+namespace {
+
+constexpr int kFullmatch = 120;
+constexpr int kPrefix = 150;
+constexpr int kSuffix = 40;
+constexpr int kMessages = 10000;
+
+const char *const kWords[] = {"今日", "天气", "查询", "签到", "占卜", "帮助",
+                              "服务", "启用", "禁用", "热搜", "摘要", "关键词",
+                              "早安", "晚安", "抽卡", "排行", "help", "bot",
+                              "weather", "rank"};
+
+std::shared_ptr<TriggeredService> MakeService(const std::string &name) {
+  return std::make_shared<TriggeredService>(
+      name, [](const Event &, onebot11::ApiBot &) {});
+}
+
+std::string RandomPhrase(std::mt19937 &rng, const int words) {
+  std::string phrase;
+  for (int i = 0; i < words; ++i)
+    phrase += kWords[rng() % std::size(kWords)];
+  return phrase;
+}
+
+}  // namespace
+
+int main() {
+  LOG_INIT("command_match_bench.log", "WARN");
+  std::mt19937 rng(4);
+
+  // 分发路径原有的查找结构
+  StringMap<std::shared_ptr<TriggeredService>> fullmatch;
+  Trie prefix;
+  Trie suffix;
+  std::vector<RegexMatcher> regex;
+  CommandMatcher matcher;
+
+  for (int i = 0; i < kFullmatch; ++i) {
+    auto command = RandomPhrase(rng, 2 + rng() % 2);
+    auto service = MakeService("full" + std::to_string(i));
+    if (fullmatch.emplace(command, service).second)
+      matcher.AddFullmatch(command, service);
+  }
+  for (int i = 0; i < kPrefix; ++i) {
+    auto command = RandomPhrase(rng, 1 + rng() % 3);
+    auto service = MakeService("prefix" + std::to_string(i));
+    if (prefix.Insert(command, service)) matcher.AddPrefix(command, service);
+  }
+  for (int i = 0; i < kSuffix; ++i) {
+    auto command = RandomPhrase(rng, 2);
+    auto service = MakeService("suffix" + std::to_string(i));
+    if (suffix.InsertFromBack(command, service))
+      matcher.AddSuffix(command, service);
+  }
+  // 与bilibili_parser注册的正则相同
+  regex.emplace_back(
+      std::initializer_list<std::string>{
+          R"(http[s]?://(?:[a-zA-Z]|[0-9]|[$-_@.&+]|[!*\(\),]|(?:%[0-9a-fA-F][0-9a-fA-F]))+)"},
+      MakeService("url"));
+  regex.emplace_back(
+      std::initializer_list<std::string>{R"((av|AV)\d+)",
+                                         R"((BV|bv)([a-zA-Z0-9])+)"},
+      MakeService("bilibili"));
+  for (std::size_t i = 0; i < regex.size(); ++i)
+    matcher.AddRegex(i, regex[i].GetLiterals());
+  matcher.Build();
+
+  // 大部分是普通聊天，少量命令与链接
+  std::vector<std::string> messages;
+  for (int i = 0; i < kMessages; ++i) {
+    switch (rng() % 10) {
+      case 0:
+        messages.push_back(RandomPhrase(rng, 1 + rng() % 3) + " 北京");
+        break;
+      case 1:
+        messages.push_back("看看这个 https://www.bilibili.com/video/BV1xx411c7mD");
+        break;
+      default:
+        messages.push_back("今天群里好热闹啊，大家晚上一起打本吗 " +
+                           std::to_string(rng()));
+    }
+  }
+
+  std::size_t hits = 0;
+  auto legacy = [&] {
+    for (const auto &message : messages) {
+      int size = 0;
+      hits += fullmatch.find(message) != fullmatch.end();
+      hits += static_cast<bool>(prefix.LongestPrefix(message, size));
+      hits += static_cast<bool>(suffix.LongestSuffix(message, size));
+      for (auto &matcher : regex) hits += matcher.Check(message);
+    }
+    bench::DoNotOptimize(hits);
+  };
+  auto compiled = [&] {
+    for (const auto &message : messages) {
+      auto match = matcher.Match(message);
+      hits += match.fullmatch != nullptr;
+      hits += match.prefix != nullptr;
+      hits += match.suffix != nullptr;
+      for (std::size_t i = 0; i < regex.size(); ++i)
+        if (match.IsRegexCandidate(i)) hits += regex[i].Check(message);
+    }
+    bench::DoNotOptimize(hits);
+  };
+
+  std::printf("%zu fullmatch, %zu prefix, %zu suffix, %zu regex services, "
+              "%d messages per op\n",
+              fullmatch.size(), prefix.Size(), suffix.Size(), regex.size(),
+              kMessages);
+  auto before = bench::Run("map + trie + trie + every regex", 50, legacy);
+  auto after = bench::Run("CommandMatcher + candidate regex", 50, compiled);
+  bench::Speedup(before, after);
+  return 0;
+}
@@ -0,0 +1,87 @@
+// CQ码：改动前的@bot前缀解析与at_sender拼接，与Tokenizer/Builder对比，
+// 另给出完整Parse在一段聊天记录上的吞吐
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "bench.h"
+#include "check.h"
+#include "message/cq_code.h"
+#include "type.h"
+
+using namespace white;
+
+namespace {
+
+constexpr QId kSelfId = 2854196310;
+
+// 改动前DecodedEvent的写法，只认不带其他参数的at
+bool LegacyToMe(std::string_view message) {
+  if (!message.starts_with("[CQ:at,qq=")) return false;
+  auto at_id_end = std::min(message.find(']'), message.size());
+  QId at_id = 0;
+  auto [ptr, ec] =
+      std::from_chars(message.data() + 10, message.data() + at_id_end, at_id);
+  return ec == std::errc() && ptr == message.data() + at_id_end &&
+         at_id == kSelfId;
+}
+
+// 与DecodedEvent::DecodeMessage相同
+bool ToMe(std::string_view message) {
+  if (!message.starts_with("[CQ:at,")) return false;
+  message::Tokenizer tokenizer(message);
+  auto first = tokenizer.Next();
+  return first && first->Number<QId>("qq") == kSelfId;
+}
+
+const std::vector<std::string> kChatLog = {
+    "早上好",
+    "[CQ:at,qq=2854196310] 今日运势",
+    "[CQ:reply,id=-12345][CQ:at,qq=10001] 好耶[CQ:face,id=178]",
+    "看看这个[CQ:image,file=3b8f2c0e.image,url=https://gchat.qpic.cn/"
+    "gchatpic_new/1/2-3-ABCDEF/0?term=2&amp;is_origin=0]",
+    "https://www.bilibili.com/video/BV1xx411c7mD 笑死",
+    "关键词提取 这是一段比较长的文字用于测试分词效果，大家觉得怎么样呢"};
+
+}  // namespace
+
+int main() {
+  for (const auto &message : kChatLog)
+    CHECK(LegacyToMe(message) == ToMe(message));
+  // 带name参数的at以前认不出来
+  CHECK(ToMe("[CQ:at,qq=2854196310,name=米缸] 在吗"));
+
+  auto before = bench::Run("@bot: prefix + from_chars", 200000, [&] {
+    for (const auto &message : kChatLog)
+      bench::DoNotOptimize(LegacyToMe(message));
+  });
+  auto after = bench::Run("@bot: Tokenizer", 200000, [&] {
+    for (const auto &message : kChatLog) bench::DoNotOptimize(ToMe(message));
+  });
+  bench::Speedup(before, after);
+
+  const std::string reply = "今天的运势是：大吉";
+  before = bench::Run("at_sender: fmt::format", 200000, [&] {
+    bench::DoNotOptimize(fmt::format("[CQ:at,qq={}] {}", QId{10001}, reply));
+  });
+  after = bench::Run("at_sender: Builder", 200000, [&] {
+    bench::DoNotOptimize(
+        message::Builder().At(QId{10001}).Raw(" ").Raw(reply).Build());
+  });
+  bench::Speedup(before, after);
+
+  std::size_t bytes = 0;
+  for (const auto &message : kChatLog) bytes += message.size();
+  auto ns = bench::Run("Parse (chat log)", 200000, [&] {
+    for (const auto &message : kChatLog)
+      bench::DoNotOptimize(message::Parse(message).size());
+  });
+  std::printf("%-44s %10.1f M msg/s, %.0f MB/s\n", "Parse throughput",
+              kChatLog.size() / ns * 1e3, bytes / ns * 1e3);
+  return 0;
+}
@@ -0,0 +1,112 @@
+// api响应：改动前先解析为Json再逐个字段get<>()，与DecodeValue直接填充对比。
+// 计时前先确认两者得到相同的字段
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "bench.h"
+#include "bot/onebot_11/desired_value.h"
+#include "check.h"
+
+using namespace white;
+using namespace white::onebot11;
+
+namespace {
+
+std::vector<GroupInfo> LegacyGroupList(const std::string &data) {
+  auto value = Json::parse(data);
+  std::vector<GroupInfo> groups;
+  for (std::size_t i = 0; i < value.size(); ++i)
+    groups.push_back({value[i]["group_id"].get<GId>(),
+                      value[i]["group_name"].get<std::string>(),
+                      value[i]["member_count"].get<int>(),
+                      value[i]["max_member_count"].get<int>()});
+  return groups;
+}
+
+GroupMemberInfo LegacyMemberInfo(const std::string &data) {
+  auto value = Json::parse(data);
+  return {value["group_id"].get<GId>(),
+          value["user_id"].get<QId>(),
+          value["nickname"].get<std::string>(),
+          value["card"].get<std::string>(),
+          value["sex"].get<std::string>(),
+          value["age"].get<int>(),
+          value["area"].get<std::string>(),
+          value["join_time"].get<int>(),
+          value["last_sent_time"].get<int>(),
+          value["level"].get<std::string>(),
+          value["role"].get<std::string>(),
+          value["unfriendly"].get<bool>(),
+          value["title"].get<std::string>(),
+          value["title_expire_time"].get<int>(),
+          value["card_changeable"].get<bool>()};
+}
+
+// 带转义与多余嵌套字段的群列表
+std::string GroupList(const int size) {
+  std::string list = "[";
+  for (int i = 0; i < size; ++i) {
+    if (i) list += ",";
+    list += fmt::format(
+        R"({{"group_id":{},"group_name":"测试群\"{}\"中","member_count":{},)"
+        R"("max_member_count":2000,"group_create_time":0,"group_level":0,)"
+        R"("extra":{{"a":[1,2,{{"b":"}}"}}]}}}})",
+        100000 + i, i, i * 3);
+  }
+  return list + "]";
+}
+
+const std::string kMember =
+    R"({"group_id":1,"user_id":2,"nickname":"n","card":"","sex":"male",)"
+    R"("age":18,"area":"","join_time":1600000000,"last_sent_time":1600000001,)"
+    R"("level":"5","role":"admin","unfriendly":false,"title":"t",)"
+    R"("title_expire_time":-1,"card_changeable":true,"shut_up_timestamp":0})";
+
+}  // namespace
+
+int main() {
+  const auto list = GroupList(500);
+  {
+    std::vector<GroupInfo> groups;
+    CHECK(DecodeValue(list, groups));
+    auto legacy = LegacyGroupList(list);
+    CHECK(groups.size() == legacy.size());
+    for (std::size_t i = 0; i < groups.size(); ++i) {
+      CHECK(groups[i].group_id == legacy[i].group_id);
+      CHECK(groups[i].group_name == legacy[i].group_name);
+      CHECK(groups[i].member_count == legacy[i].member_count);
+      CHECK(groups[i].max_member_count == legacy[i].max_member_count);
+    }
+    GroupMemberInfo member{};
+    CHECK(DecodeValue(kMember, member));
+    auto expected = LegacyMemberInfo(kMember);
+    CHECK(member.role == expected.role && member.level == expected.level);
+    CHECK(member.join_time == expected.join_time);
+    CHECK(member.title_expire_time == expected.title_expire_time);
+    CHECK(member.card_changeable == expected.card_changeable);
+  }
+
+  std::printf("get_group_list: 500 groups, %zu bytes\n", list.size());
+  auto before = bench::Run("Json::parse + get<> (group list)", 2000, [&] {
+    bench::DoNotOptimize(LegacyGroupList(list).size());
+  });
+  auto after = bench::Run("DecodeValue (group list)", 2000, [&] {
+    std::vector<GroupInfo> groups;
+    DecodeValue(list, groups);
+    bench::DoNotOptimize(groups.size());
+  });
+  bench::Speedup(before, after);
+
+  before = bench::Run("Json::parse + get<> (member info)", 40000, [&] {
+    bench::DoNotOptimize(LegacyMemberInfo(kMember).age);
+  });
+  after = bench::Run("DecodeValue (member info)", 40000, [&] {
+    GroupMemberInfo member{};
+    DecodeValue(kMember, member);
+    bench::DoNotOptimize(member.age);
+  });
+  bench::Speedup(before, after);
+  return 0;
+}
@@ -0,0 +1,86 @@
+// CQ码转义：改动前的四次std::regex_replace与单遍扫描对比。
+// 计时前先在随机输入上确认结果与旧实现一致
+#include <random>
+#include <regex>
+#include <string>
+
+#include "bench.h"
+#include "check.h"
+#include "message/escape.h"
+
+using namespace white;
+using namespace white::message;
+
+namespace {
+
+std::string LegacyEscape(const std::string &str, const bool escape_comma) {
+  auto ret = std::regex_replace(str, std::regex("&"), "&amp;");
+  ret = std::regex_replace(ret, std::regex("\\["), "&#91;");
+  ret = std::regex_replace(ret, std::regex("\\]"), "&#93;");
+  if (escape_comma) ret = std::regex_replace(ret, std::regex(","), "&#44;");
+  return ret;
+}
+
+std::string LegacyUnescape(const std::string &str) {
+  auto ret = std::regex_replace(str, std::regex("&#44;"), ",");
+  ret = std::regex_replace(ret, std::regex("&#91;"), "[");
+  ret = std::regex_replace(ret, std::regex("&#93;"), "]");
+  ret = std::regex_replace(ret, std::regex("&amp;"), "&");
+  return ret;
+}
+
+void CheckEquivalent() {
+  std::mt19937 rng(1);
+  static constexpr char kAlphabet[] = "ab&[],;#91amp4 3";
+  for (int n = 0; n < 20000; ++n) {
+    std::string str;
+    for (int i = rng() % 70; i > 0; --i)
+      str += kAlphabet[rng() % (sizeof(kAlphabet) - 1)];
+    CHECK(Escape(str, true) == LegacyEscape(str, true));
+    CHECK(Escape(str, false) == LegacyEscape(str, false));
+    CHECK(Unescape(str) == LegacyUnescape(str));
+    auto copy = str;
+    UnescapeInPlace(copy);
+    CHECK(copy == LegacyUnescape(str));
+  }
+}
+
+}  // namespace
+
+int main() {
+  CheckEquivalent();
+  const std::string chat = "今天天气不错，大家一起去玩吧 hello world";
+  std::string weibo;
+  for (int i = 0; i < 60; ++i)
+    weibo += "这是一条很长的微博[话题]内容，包含 & 符号和, 逗号 ";
+  const auto escaped = Escape(weibo);
+
+  auto before = bench::Run("regex escape (chat)", 20000, [&] {
+    bench::DoNotOptimize(LegacyEscape(chat, true));
+  });
+  auto after = bench::Run("Escape (chat)", 20000,
+                          [&] { bench::DoNotOptimize(Escape(chat)); });
+  bench::Speedup(before, after);
+
+  before = bench::Run("regex escape (weibo)", 2000, [&] {
+    bench::DoNotOptimize(LegacyEscape(weibo, true));
+  });
+  after = bench::Run("Escape (weibo)", 2000,
+                     [&] { bench::DoNotOptimize(Escape(weibo)); });
+  bench::Speedup(before, after);
+
+  before = bench::Run("regex unescape (weibo)", 2000, [&] {
+    bench::DoNotOptimize(LegacyUnescape(escaped));
+  });
+  after = bench::Run("Unescape (weibo)", 2000,
+                     [&] { bench::DoNotOptimize(Unescape(escaped)); });
+  bench::Speedup(before, after);
+
+  std::string buf;
+  bench::Run("EscapeTo, reused buffer (weibo)", 2000, [&] {
+    buf.clear();
+    EscapeTo(buf, weibo);
+    bench::DoNotOptimize(buf.data());
+  });
+  return 0;
+}
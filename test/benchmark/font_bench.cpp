@@ -0,0 +1,123 @@
+// 文字渲染：每次加载字体并为测量与绘制各光栅化一遍(仿照cv::freetype的做法，
+// 直接以FreeType实现，并非cv::freetype本身)，与FontService的线程内字体与
+// 字形缓存对比。只计排版与光栅化，不含编码。
+// 结果未在真实的OpenCV与配置的字体上验证，仅供参考
+// 用法: font_bench [字体文件]，默认为TextToImg使用的字体
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "global_config.h"
+#include "logger/logger.h"
+#include "tools/font_service.h"
+
+using namespace white;
+
+namespace {
+
+constexpr int kFontHeight = 24;
+constexpr int kLineHeight = 29;
+
+// 改动前每次调用的开销：加载字体，getTextSize与putText各排版光栅化一遍
+int Uncached(const std::string &font, const std::vector<std::string> &lines,
+             cv::Mat &img) {
+  FT_Library library;
+  FT_Init_FreeType(&library);
+  FT_Face face;
+  FT_New_Face(library, font.c_str(), 0, &face);
+  FT_Set_Pixel_Sizes(face, 0, kFontHeight);
+  int width = 0;
+  for (const auto &line : lines) {
+    int x = 0;
+    for (auto it = line.begin(); it != line.end();) {
+      FT_Load_Char(face, utf8::next(it, line.end()), FT_LOAD_RENDER);
+      x += face->glyph->advance.x >> 6;
+    }
+    width = std::max(width, x);
+  }
+  int y = 20;
+  for (const auto &line : lines) {
+    int x = 20;
+    for (auto it = line.begin(); it != line.end();) {
+      FT_Load_Char(face, utf8::next(it, line.end()), FT_LOAD_RENDER);
+      const auto &bitmap = face->glyph->bitmap;
+      const int x0 = x + face->glyph->bitmap_left;
+      const int y0 = y + 20 - face->glyph->bitmap_top;
+      for (int r = 0; r < static_cast<int>(bitmap.rows); ++r) {
+        if (y0 + r < 0 || y0 + r >= img.rows) continue;
+        auto dst = img.ptr<uchar>(y0 + r);
+        for (int c = 0; c < static_cast<int>(bitmap.width); ++c) {
+          if (x0 + c < 0 || x0 + c >= img.cols) continue;
+          const int alpha = bitmap.buffer[r * bitmap.pitch + c];
+          for (int k = 0; k < 3; ++k)
+            dst[(x0 + c) * 3 + k] = dst[(x0 + c) * 3 + k] * (255 - alpha) / 255;
+        }
+      }
+      x += face->glyph->advance.x >> 6;
+    }
+    y += kLineHeight;
+  }
+  FT_Done_Face(face);
+  FT_Done_FreeType(library);
+  return width;
+}
+
+int Cached(const std::string &font, const std::vector<std::string> &lines,
+           cv::Mat &img) {
+  auto &service = render::FontService::ThreadLocal();
+  int width = 0;
+  for (const auto &line : lines)
+    width = std::max(width, service.GetTextSize(font, line, kFontHeight).width);
+  int y = 20;
+  for (const auto &line : lines) {
+    service.PutText(img, font, line, {20, y}, kFontHeight, cv::Scalar(0, 0, 0));
+    y += kLineHeight;
+  }
+  return width;
+}
+
+// 与lssv输出大小相近的中英混排列表
+std::vector<std::string> Listing() {
+  static const char *kNames[] = {
+      "天气",   "占卜",     "关键词提取", "自动摘要", "微博热搜",
+      "早安",   "晚安",     "帮助",       "服务管理", "B站解析",
+      "群管理", "好友申请", "入群申请",   "自动清理"};
+  std::string text =
+      "以下为本群可用服务以及启用情况\n=====================\n";
+  for (int i = 0; i < 28; ++i)
+    text += std::string("[✓] ") + kNames[i % 14] +
+            ": Weather forecast and city lookup 查询城市天气\n\n";
+  std::vector<std::string> lines;
+  std::istringstream stream(text);
+  for (std::string line; std::getline(stream, line);) lines.push_back(line);
+  return lines;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  LOG_INIT("logs/font_bench.log", "INFO");
+  const std::string font =
+      argc > 1 ? argv[1]
+               : (config::kAssetsDir / "fonts" / "SourceHanSansHWSC-Regular.otf")
+                     .string();
+  if (!std::filesystem::exists(font)) {
+    std::printf("字体文件不存在: %s\n", font.c_str());
+    return 1;
+  }
+  const auto lines = Listing();
+  cv::Mat img(lines.size() * kLineHeight + 40, 900, CV_8UC3,
+              cv::Scalar(200, 200, 200));
+  std::printf("%zu lines, %dpx\n", lines.size(), kFontHeight);
+  auto before = bench::Run("load face + rasterize per call", 200, [&] {
+    bench::DoNotOptimize(Uncached(font, lines, img));
+  });
+  auto after = bench::Run("FontService", 200, [&] {
+    bench::DoNotOptimize(Cached(font, lines, img));
+  });
+  bench::Speedup(before, after);
+  return 0;
+}
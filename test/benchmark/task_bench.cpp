@@ -0,0 +1,75 @@
+// 挂起等待api响应时，Task协程链在堆上占用的内存。
+// 每个请求等待一个co_future，Task为两层co_await链。
+// 不与go()协程对比：挂起的cocoyaxi协程保存的栈不经过operator new，
+// 需在真实的cocoyaxi构建上另行测量
+// 用法: task_bench [并发请求数]
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "bench.h"
+#include "co_task.h"
+#include "logger/logger.h"
+
+using namespace white;
+
+namespace {
+
+std::atomic<long> heap_bytes{0};
+
+void WaitFor(const std::atomic<int> &counter, const int target) {
+  while (counter.load() < target) co::sleep(1);
+}
+
+Task<int> Leaf(co_future<int> future) {
+  int value = co_await std::move(future);
+  co_return value + 1;
+}
+
+Task<> Root(co_future<int> future, std::atomic<int> &done) {
+  int value = co_await Leaf(std::move(future));
+  bench::DoNotOptimize(value);
+  ++done;
+}
+
+// 返回挂起期间每个请求新分配的堆内存
+long Measure(const int requests) {
+  std::vector<co_promise<int>> promises(requests);
+  std::atomic<int> done{0};
+  const long heap_before = heap_bytes;
+  // Task挂起在co_await上，Detach返回时已完成挂起
+  for (auto &promise : promises) Root(promise.get_future(), done).Detach();
+  const long ret = (heap_bytes - heap_before) / requests;
+  for (auto &promise : promises) promise.set_value(1);
+  WaitFor(done, requests);
+  return ret;
+}
+
+}  // namespace
+
+void *operator new(std::size_t size) {
+  heap_bytes += size;
+  if (auto ptr = std::malloc(size)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+int main(int argc, char *argv[]) {
+  LOG_INIT("logs/task_bench.log", "INFO");
+  const int requests = argc > 1 ? std::atoi(argv[1]) : 10000;
+  co::WaitGroup wg;
+  wg.add(1);
+  go([&] {
+    std::printf("%-44s %8ld B/request heap\n", "Task + co_await",
+                Measure(requests));
+    wg.done();
+  });
+  wg.wait();
+  return 0;
+}
@@ -0,0 +1,143 @@
+// 连续数组的Trie vs 原先每个字节一个堆节点、unordered_map存子节点的布局
+#include <cctype>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench.h"
+#include "event/trie.h"
+#include "logger/logger.h"
+
+using namespace white;
+
+namespace {
+
+constexpr int kCommands = 400;
+constexpr int kMessages = 10000;
+
+// 原先的布局，只保留查找所需的部分；命令长度写入int而不是Event，
+// 只比较存储结构本身
+class LegacyTrie {
+ public:
+  bool Insert(const std::string &key,
+              std::shared_ptr<TriggeredService> service) {
+    return InsertImpl(key.begin(), key.end(), key.size(), std::move(service));
+  }
+
+  bool InsertFromBack(const std::string &key,
+                      std::shared_ptr<TriggeredService> service) {
+    return InsertImpl(key.rbegin(), key.rend(), -static_cast<int>(key.size()),
+                      std::move(service));
+  }
+
+  const std::shared_ptr<TriggeredService> &LongestPrefix(
+      const std::string &key, int &command_size) const {
+    return Search(key.begin(), key.end(), command_size);
+  }
+
+  const std::shared_ptr<TriggeredService> &LongestSuffix(
+      const std::string &key, int &command_size) const {
+    return Search(key.rbegin(), key.rend(), command_size);
+  }
+
+ private:
+  struct Node {
+    std::unordered_map<char, std::unique_ptr<Node>> childs;
+    std::shared_ptr<TriggeredService> service;
+    int command_size = 0;
+  };
+
+  template <typename It>
+  bool InsertImpl(It start, It end, const int command_size,
+                  std::shared_ptr<TriggeredService> &&service) {
+    auto node = root_.get();
+    for (; start != end; ++start) {
+      auto &child = node->childs[static_cast<char>(std::tolower(*start))];
+      if (!child) child = std::make_unique<Node>();
+      node = child.get();
+    }
+    if (node->service) return false;
+    node->service = std::move(service);
+    node->command_size = command_size;
+    return true;
+  }
+
+  template <typename It>
+  const std::shared_ptr<TriggeredService> &Search(It start, It end,
+                                                  int &command_size) const {
+    const Node *node = root_.get();
+    const Node *found = nullptr;
+    for (; start != end; ++start) {
+      auto it = node->childs.find(static_cast<char>(std::tolower(*start)));
+      if (it == node->childs.end()) break;
+      node = it->second.get();
+      if (node->service) found = node;
+    }
+    if (!found) return empty_;
+    command_size = found->command_size;
+    return found->service;
+  }
+
+  std::unique_ptr<Node> root_ = std::make_unique<Node>();
+  const std::shared_ptr<TriggeredService> empty_;
+};
+
+const char *const kChars[] = {"今", "日", "天", "气", "查", "询",
+                              "签", "到", "a", "B"};
+
+std::string RandomText(std::mt19937 &rng, const int chars) {
+  std::string text;
+  for (int i = 0; i < chars; ++i) text += kChars[rng() % std::size(kChars)];
+  return text;
+}
+
+}  // namespace
+
+int main() {
+  LOG_INIT("trie_bench.log", "WARN");
+  std::mt19937 rng(3);
+  Trie prefix, suffix;
+  LegacyTrie legacy_prefix, legacy_suffix;
+  for (int i = 0; i < kCommands; ++i) {
+    auto service = std::make_shared<TriggeredService>(
+        "trie" + std::to_string(i), [](const Event &, onebot11::ApiBot &) {});
+    auto command = RandomText(rng, 2 + rng() % 4);
+    prefix.Insert(command, service);
+    legacy_prefix.Insert(command, service);
+    suffix.InsertFromBack(command, service);
+    legacy_suffix.InsertFromBack(command, service);
+  }
+  std::vector<std::string> messages;
+  for (int i = 0; i < kMessages; ++i)
+    messages.push_back(RandomText(rng, 1 + rng() % 20));
+
+  std::size_t hits = 0;
+  int size = 0;
+  std::printf("%d commands, %d mostly CJK messages per op\n", kCommands,
+              kMessages);
+  auto before = bench::Run("legacy LongestPrefix", 100, [&] {
+    for (const auto &message : messages)
+      hits += static_cast<bool>(legacy_prefix.LongestPrefix(message, size));
+    bench::DoNotOptimize(hits);
+  });
+  auto after = bench::Run("Trie::LongestPrefix", 100, [&] {
+    for (const auto &message : messages)
+      hits += static_cast<bool>(prefix.LongestPrefix(message, size));
+    bench::DoNotOptimize(hits);
+  });
+  bench::Speedup(before, after);
+  before = bench::Run("legacy LongestSuffix", 100, [&] {
+    for (const auto &message : messages)
+      hits += static_cast<bool>(legacy_suffix.LongestSuffix(message, size));
+    bench::DoNotOptimize(hits);
+  });
+  after = bench::Run("Trie::LongestSuffix", 100, [&] {
+    for (const auto &message : messages)
+      hits += static_cast<bool>(suffix.LongestSuffix(message, size));
+    bench::DoNotOptimize(hits);
+  });
+  bench::Speedup(before, after);
+  return 0;
+}
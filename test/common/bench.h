@@ -0,0 +1,43 @@
+#ifndef MIGANGBOT_TEST_COMMON_BENCH_H_
+#define MIGANGBOT_TEST_COMMON_BENCH_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+
+namespace white {
+namespace bench {
+
+// 防止被测的结果被编译器优化掉
+template <typename T>
+inline void DoNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// 先预热一次，再运行iterations次，打印并返回每次的平均耗时(ns)
+template <typename Func>
+inline double Run(const char *name, const std::size_t iterations, Func &&func) {
+  func();
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; ++i) func();
+  const double ns = std::chrono::duration<double, std::nano>(
+                        std::chrono::steady_clock::now() - start)
+                        .count() /
+                    iterations;
+  if (ns >= 1e6)
+    std::printf("%-44s %10.3f ms/op\n", name, ns / 1e6);
+  else if (ns >= 1e3)
+    std::printf("%-44s %10.3f us/op\n", name, ns / 1e3);
+  else
+    std::printf("%-44s %10.1f ns/op\n", name, ns);
+  return ns;
+}
+
+inline void Speedup(const double before_ns, const double after_ns) {
+  std::printf("%-44s %10.2fx\n", "speedup", before_ns / after_ns);
+}
+
+}  // namespace bench
+}  // namespace white
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef MIGANGBOT_TEST_COMMON_CHECK_H_
+#define MIGANGBOT_TEST_COMMON_CHECK_H_
+
+#include <cstdio>
+#include <cstdlib>
+
+// 与assert不同，Release构建下同样生效；失败时打印位置并以非0退出
+#define CHECK(condition)                                                 \
+  do {                                                                   \
+    if (!(condition)) {                                                  \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                   #condition);                                          \
+      std::exit(1);                                                      \
+    }                                                                    \
+  } while (0)
+
+#endif
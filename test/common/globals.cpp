@@ -0,0 +1,27 @@
+#include "global_config.h"
+
+namespace {
+
+// 服务状态等写入临时目录，不影响工作目录
+std::filesystem::path TempDir(const char *name) {
+  auto dir = std::filesystem::temp_directory_path() / "migangbot_test" / name;
+  std::filesystem::create_directories(dir);
+  return dir;
+}
+
+}  // namespace
+
+// 主程序在main.cpp中定义这些全局配置，测试与基准使用默认值
+YAML::Node white::global_config;
+std::filesystem::path white::config::kConfigDir = TempDir("config");
+std::filesystem::path white::config::kAssetsDir{"assets"};
+std::filesystem::path white::config::kServiceDir = TempDir("service");
+std::string white::config::BOT_NAME{"米缸"};
+std::unordered_set<white::QId> white::config::SUPERUSERS;
+std::unordered_set<white::QId> white::config::WHITE_LIST;
+std::size_t white::config::EVENT_QUEUE_SIZE = 1024;
+std::size_t white::config::EVENT_WORKERS = 4;
+std::size_t white::config::RENDER_WORKERS = 0;
+std::size_t white::config::RENDER_CACHE_MB = 0;
+bool white::config::RENDER_CACHE_DISK = false;
+std::string white::config::IMAGE_BASE_URL;
@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include <vector>
 
@@ -16,14 +18,22 @@ nlohmann::json set_echo(const nlohmann::json& t) {
 }
 
 int main(int argc, char** argv) {
-  if (argc < 3) {
-    printf("Usage: %s url count thread_num\n", argv[0]);
+  if (argc < 4) {
+    printf("Usage: %s url count thread_num [idle_seconds]\n", argv[0]);
     return -10;
   }
   const char* url = argv[1];
   const std::size_t loop_count = atoi(argv[2]);
   const std::size_t thread_num = atoi(argv[3]);
-  std::vector<std::size_t> count_per_thread(thread_num);
+  // 连续这么久没有收到api请求就认为压测结束
+  const std::size_t idle_seconds = argc > 4 ? atoi(argv[4]) : 3;
+  std::vector<std::atomic<std::size_t>> count_per_thread(thread_num);
+  std::atomic<int64_t> last_recv_ns{0};
+  auto now_ns = []() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  };
 
   nlohmann::json message{{"anonymous", nullptr},
                          {"font", 0},
@@ -42,18 +52,21 @@ int main(int argc, char** argv) {
 
   std::string msg_str = message.dump();
 
+  const auto start_ns = now_ns();
   std::vector<std::thread> threads;
   for (std::size_t i = 0; i < thread_num; ++i) {
-    threads.push_back(
-        std::thread{[loop_count, &msg_str, &url, i, &count_per_thread]() {
+    threads.push_back(std::thread{[loop_count, idle_seconds, &msg_str, &url, i,
+                                   &count_per_thread, &last_recv_ns,
+                                   &now_ns]() {
           WebSocketClient ws;
           ws.onopen = []() { printf("onopen\n"); };
           ws.onclose = []() { printf("onclose\n"); };
+          // 每收到一个api请求就回一个响应，即一次完整的api往返
           ws.onmessage = [&](const std::string& msg) {
             ++count_per_thread[i];
+            last_recv_ns = now_ns();
             nlohmann::json json_msg = nlohmann::json::parse(msg);
             ws.send(set_echo(json_msg).dump());
-            std::cout << "Recv: " << msg << std::endl;
           };
 
           reconn_setting_t reconn;
@@ -70,16 +83,27 @@ int main(int argc, char** argv) {
             if (!ws.isConnected()) continue;
             ws.send(msg_str);
           }
-          while (ws.isConnected()) {
+          while (ws.isConnected() && count_per_thread[i] < loop_count) {
+            auto last = last_recv_ns.load();
+            if (last && now_ns() - last >
+                            static_cast<int64_t>(idle_seconds) * 1000000000)
+              break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
           }
+          ws.close();
         }});
   }
   for (auto& t : threads) t.join();
+  std::size_t success = 0;
+  for (auto& count : count_per_thread) success += count;
+  // 只统计到最后一次收到请求为止，不含空闲等待
+  const double seconds =
+      (std::max(last_recv_ns.load(), start_ns) - start_ns) / 1e9;
   std::cout << "Total Send Count: " << loop_count * thread_num << std::endl;
-  std::cout << "Success: "
-            << std::accumulate(count_per_thread.begin(), count_per_thread.end(),
-                               0)
-            << std::endl;
+  std::cout << "Success: " << success << std::endl;
+  std::cout << "Elapsed: " << seconds << "s" << std::endl;
+  if (seconds > 0)
+    std::cout << "Api Round-trips/s: " << success / seconds << std::endl;
 
   return 0;
 }
\ No newline at end of file
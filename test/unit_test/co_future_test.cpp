@@ -0,0 +1,99 @@
+// when_all/when_any的结果与生命周期：输入永远不会完成且其promise已释放时，
+// 组合用的上下文与已到达的结果都应被释放
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "check.h"
+#include "co_future.h"
+
+using namespace white;
+
+namespace {
+
+using Value = std::shared_ptr<int>;
+
+void TestWhenAll() {
+  std::vector<co_promise<int>> promises(5);
+  std::vector<co_future<int>> futures;
+  for (auto &promise : promises) futures.push_back(promise.get_future());
+  auto all = when_all(std::move(futures));
+  std::vector<std::thread> threads;
+  for (int i = 4; i >= 0; --i)
+    threads.emplace_back([&, i] { promises[i].set_value(i * 10); });
+  for (auto &thread : threads) thread.join();
+  CHECK(all.ready());
+  CHECK((all.get() == std::vector<int>{0, 10, 20, 30, 40}));
+
+  // vector<bool>的各元素共用存储，结果不能直接写入同一个vector
+  std::vector<co_promise<bool>> flags(3);
+  std::vector<co_future<bool>> flag_futures;
+  for (auto &flag : flags) flag_futures.push_back(flag.get_future());
+  auto all_flags = when_all(std::move(flag_futures));
+  flags[1].set_value(true);
+  flags[0].set_value(false);
+  flags[2].set_value(true);
+  CHECK((all_flags.get() == std::vector<bool>{false, true, true}));
+
+  CHECK(when_all(std::vector<co_future<int>>{}).get().empty());
+}
+
+void TestWhenAny() {
+  std::vector<co_promise<int>> promises(3);
+  std::vector<co_future<int>> futures;
+  for (auto &promise : promises) futures.push_back(promise.get_future());
+  auto any = when_any(std::move(futures));
+  promises[2].set_value(7);
+  promises[0].set_value(1);
+  auto [index, value] = any.get();
+  CHECK(index == 2 && value == 7);
+}
+
+void TestWhenAllNeverCompletes() {
+  std::weak_ptr<int> arrived;
+  {
+    auto done = std::make_unique<co_promise<Value>>();
+    auto never = std::make_unique<co_promise<Value>>();
+    std::vector<co_future<Value>> futures;
+    futures.push_back(done->get_future());
+    futures.push_back(never->get_future());
+    auto all = when_all(std::move(futures));
+    auto value = std::make_shared<int>(1);
+    arrived = value;
+    done->set_value(std::move(value));
+    CHECK(!all.ready());
+    CHECK(!arrived.expired());
+    // 另一个输入再也不会完成
+    never.reset();
+  }
+  CHECK(arrived.expired());
+}
+
+void TestWhenAnyNeverCompletes() {
+  std::weak_ptr<int> arrived;
+  {
+    auto done = std::make_unique<co_promise<Value>>();
+    auto never = std::make_unique<co_promise<Value>>();
+    std::vector<co_future<Value>> futures;
+    futures.push_back(never->get_future());
+    futures.push_back(done->get_future());
+    auto any = when_any(std::move(futures));
+    auto value = std::make_shared<int>(1);
+    arrived = value;
+    done->set_value(std::move(value));
+    CHECK(any.ready());
+    never.reset();
+  }
+  CHECK(arrived.expired());
+}
+
+}  // namespace
+
+int main() {
+  TestWhenAll();
+  TestWhenAny();
+  TestWhenAllNeverCompletes();
+  TestWhenAnyNeverCompletes();
+  return 0;
+}
@@ -0,0 +1,59 @@
+// DecodeValue：整数字段接受值为整数的浮点数，其他非整数的数值只跳过该字段，
+// 不影响同一对象中其余字段的解码
+#include <string>
+#include <vector>
+
+#include "bot/onebot_11/desired_value.h"
+#include "check.h"
+
+using namespace white;
+using namespace white::onebot11;
+
+namespace {
+
+void TestIntegralFloat() {
+  GroupInfo group{};
+  CHECK(DecodeValue(R"({"group_id":1.0,"group_name":"g",)"
+                    R"("member_count":"3.0","max_member_count":2e3})",
+                    group));
+  CHECK(group.group_id == 1);
+  CHECK(group.group_name == "g");
+  CHECK(group.member_count == 3);
+  CHECK(group.max_member_count == 2000);
+}
+
+void TestSkippedField() {
+  GroupInfo group{};
+  group.member_count = -1;
+  group.max_member_count = -1;
+  // 有小数部分与超出int范围的值都只跳过该字段
+  CHECK(DecodeValue(R"({"group_id":12345678901,"member_count":1.5,)"
+                    R"("max_member_count":1e10,"group_name":"g"})",
+                    group));
+  CHECK(group.group_id == 12345678901);
+  CHECK(group.member_count == -1);
+  CHECK(group.max_member_count == -1);
+  CHECK(group.group_name == "g");
+
+  std::vector<GroupInfo> groups;
+  CHECK(DecodeValue(R"([{"group_id":1,"member_count":2.5},{"group_id":2.0}])",
+                    groups));
+  CHECK(groups.size() == 2);
+  CHECK(groups[0].group_id == 1 && groups[1].group_id == 2);
+}
+
+void TestInvalidNumber() {
+  // 不是数字的值仍使整个解码失败
+  GroupInfo group{};
+  CHECK(!DecodeValue(R"({"group_id":"abc"})", group));
+  CHECK(!DecodeValue(R"({"group_id":1.0x})", group));
+}
+
+}  // namespace
+
+int main() {
+  TestIntegralFloat();
+  TestSkippedField();
+  TestInvalidNumber();
+  return 0;
+}
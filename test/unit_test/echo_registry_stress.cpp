@@ -0,0 +1,140 @@
+// EchoRegistry并发压力测试：Register/Complete/Cancel/Sweep/Clear同时进行，
+// 每一次注册的回调恰好被调用一次或恰好被取消一次，结束后不残留任何项
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bot/onebot_11/echo_registry.h"
+#include "check.h"
+
+using namespace white::onebot11;
+
+namespace {
+
+constexpr int kRegistrars = 4;
+constexpr int kCompleters = 4;
+constexpr int kPerRegistrar = 20000;
+
+struct Record {
+  std::atomic<int> calls{0};
+  std::atomic<int> cancels{0};
+};
+
+// 注册方交给完成方的echo
+class Handoff {
+ public:
+  void Push(const uint64_t echo, Record *record) {
+    std::lock_guard<std::mutex> locker(mutex_);
+    queue_.emplace_back(echo, record);
+  }
+
+  bool Pop(std::pair<uint64_t, Record *> &item) {
+    std::lock_guard<std::mutex> locker(mutex_);
+    if (queue_.empty()) return false;
+    item = queue_.front();
+    queue_.pop_front();
+    return true;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<std::pair<uint64_t, Record *>> queue_;
+};
+
+}  // namespace
+
+int main() {
+  auto registry = std::make_shared<EchoRegistry>();
+  std::vector<std::unique_ptr<Record[]>> records;
+  for (int t = 0; t < kRegistrars; ++t)
+    records.push_back(std::make_unique<Record[]>(kPerRegistrar));
+  Handoff handoff;
+  std::atomic<int> registrars_running{kRegistrars};
+  std::atomic<bool> stop{false};
+  std::atomic<long> full{0};
+  std::atomic<long> stale_hits{0};
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kRegistrars; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(t);
+      for (int i = 0; i < kPerRegistrar; ++i) {
+        auto record = &records[t][i];
+        // 约四分之一已经过期，与Sweep竞争
+        auto deadline = rng() % 4 ? EchoRegistry::NowMs() + 60000
+                                  : EchoRegistry::NowMs() - 1;
+        auto echo = registry->Register(
+            [record](const ApiStatus, const std::string_view &) {
+              record->calls.fetch_add(1, std::memory_order_relaxed);
+            },
+            deadline);
+        if (!echo) {
+          // 槽位已满，视为从未注册
+          ++full;
+          record->cancels.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+        handoff.Push(echo, record);
+      }
+      --registrars_running;
+    });
+  }
+  for (int t = 0; t < kCompleters; ++t) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(100 + t);
+      std::pair<uint64_t, Record *> item;
+      while (registrars_running || handoff.Pop(item)) {
+        if (!handoff.Pop(item)) {
+          std::this_thread::yield();
+          continue;
+        }
+        auto [echo, record] = item;
+        if (rng() % 3) {
+          registry->Complete(echo, ApiStatus::kOk, "{}");
+        } else {
+          // 与EchoTicket析构时相同
+          EchoTicket ticket(registry, echo);
+          if (ticket.Release())
+            record->cancels.fetch_add(1, std::memory_order_relaxed);
+        }
+        // 已经移除的echo不会再命中，即使槽位已被复用
+        if (registry->Complete(echo, ApiStatus::kOk, "{}")) ++stale_hits;
+      }
+    });
+  }
+  threads.emplace_back([&] {
+    while (!stop) {
+      registry->Sweep();
+      std::this_thread::yield();
+    }
+  });
+  threads.emplace_back([&] {
+    // 模拟连接断开时的Clear，与其他操作交错
+    for (int i = 0; i < 20 && !stop; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      registry->Clear();
+    }
+  });
+
+  for (int t = 0; t < kRegistrars + kCompleters; ++t) threads[t].join();
+  stop = true;
+  for (std::size_t t = kRegistrars + kCompleters; t < threads.size(); ++t)
+    threads[t].join();
+  registry->Clear();
+
+  CHECK(stale_hits == 0);
+  CHECK(registry->Size() == 0);
+  for (int t = 0; t < kRegistrars; ++t)
+    for (int i = 0; i < kPerRegistrar; ++i) {
+      auto &record = records[t][i];
+      CHECK(record.calls + record.cancels == 1);
+    }
+  std::printf("registered %d, slab full %ld\n", kRegistrars * kPerRegistrar,
+              full.load());
+  return 0;
+}
@@ -0,0 +1,70 @@
+// EnableMatrix并发压力测试：写者反复切换开关，读者只能看到某个已发布的快照，
+// 未被写入的服务与群始终保持默认值，写者结束后所有线程都看到最终状态
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "service/enable_matrix.h"
+
+using namespace white;
+
+namespace {
+
+constexpr uint32_t kServices = 100;
+constexpr uint32_t kToggledService = 5;
+constexpr int kReaders = 4;
+constexpr int kWriters = 4;
+constexpr int kSetsPerWriter = 5000;
+
+}  // namespace
+
+int main() {
+  EnableMatrix matrix;
+  // 偶数下标默认开启，并在同号的群中关闭
+  for (uint32_t i = 0; i < kServices; ++i)
+    matrix.Add(i % 2 == 0, {static_cast<GId>(i)});
+
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> readers;
+  for (int t = 0; t < kReaders; ++t) {
+    readers.emplace_back([&] {
+      while (!stop) {
+        // 与事件处理相同：先取得群的视图，再逐个服务测试
+        auto group = matrix.Group(1000);
+        for (uint32_t i = 0; i < kServices; ++i) {
+          if (i == kToggledService) continue;
+          CHECK(matrix.Test(i, static_cast<GId>(i)) == (i % 2 != 0));
+          CHECK(matrix.Test(i, 1000) == (i % 2 == 0));
+          CHECK(group.Test(i) == (i % 2 == 0));
+        }
+        std::this_thread::yield();
+      }
+    });
+  }
+  std::vector<std::thread> writers;
+  for (int t = 0; t < kWriters; ++t) {
+    writers.emplace_back([&, t] {
+      const GId group_id = 1000 + t;
+      for (int k = 0; k < kSetsPerWriter; ++k)
+        matrix.Set(kToggledService, group_id, k & 1);
+      matrix.Set(kToggledService, group_id, t & 1);
+      // 写者自己的读取总能看到自己最后一次写入
+      CHECK(matrix.Test(kToggledService, group_id) == (t & 1));
+    });
+  }
+  for (auto &writer : writers) writer.join();
+  stop = true;
+  for (auto &reader : readers) reader.join();
+
+  for (int t = 0; t < kWriters; ++t) {
+    CHECK(matrix.Test(kToggledService, 1000 + t) == (t & 1));
+    CHECK(matrix.Test(kToggledService - 1, 1000 + t));
+    CHECK(matrix.Group(1000 + t).Test(kToggledService) == (t & 1));
+  }
+  CHECK(!matrix.Test(kServices, 1000));
+  CHECK(!matrix.Group(1000).Test(kServices));
+  CHECK(!EnableMatrix::GroupView().Test(0));
+  CHECK(matrix.Size() == kServices);
+  return 0;
+}
@@ -0,0 +1,65 @@
+// JsonObjectView：超过kMaxFields个字段的对象，其余字段仍能查到，
+// 重复的键取第一个，格式错误的对象整体无效
+#include <string>
+
+#include <fmt/format.h>
+
+#include "check.h"
+#include "event/event_view.h"
+#include "logger/logger.h"
+
+using namespace white;
+
+namespace {
+
+// 含嵌套值与空白的n个字段
+std::string Object(const int n) {
+  std::string object = "{";
+  for (int i = 0; i < n; ++i) {
+    if (i) object += i % 2 ? " , " : ",";
+    if (i % 3 == 0)
+      object += fmt::format(R"("k{}" : {})", i, i);
+    else if (i % 3 == 1)
+      object += fmt::format(R"("k{}":"v{},}}")", i, i);
+    else
+      object += fmt::format(R"("k{}":{{"a":[{},"}}"]}})", i, i);
+  }
+  return object + " }";
+}
+
+void TestManyFields() {
+  const auto object = Object(40);
+  JsonObjectView view(object);
+  CHECK(view.Valid());
+  for (int i = 0; i < 40; ++i) CHECK(view.Contains(fmt::format("k{}", i)));
+  CHECK(!view.Contains("k40"));
+  CHECK(view.GetNumber("k39") == 39);
+  CHECK(view.GetString("k37") == "v37,}");
+  CHECK(view.GetObject("k38").Raw("a") == R"([38,"}"])");
+  CHECK(view.Raw("missing").empty());
+}
+
+void TestDuplicateAndInvalid() {
+  auto object = Object(33);
+  object.insert(object.size() - 2, R"(,"k0":100,"k33":1,"k33":2)");
+  JsonObjectView view(object);
+  CHECK(view.Valid());
+  CHECK(view.GetNumber("k0") == 0);
+  CHECK(view.GetNumber("k33") == 1);
+
+  // 第32个之后的字段格式错误时整个对象无效
+  auto broken = Object(34);
+  broken.insert(broken.size() - 2, R"(,"k34")");
+  JsonObjectView invalid(broken);
+  CHECK(!invalid.Valid());
+  CHECK(!invalid.Contains("k33"));
+}
+
+}  // namespace
+
+int main() {
+  LOG_INIT("logs/event_view_test.log", "INFO");
+  TestManyFields();
+  TestDuplicateAndInvalid();
+  return 0;
+}
@@ -0,0 +1,86 @@
+// InfoCache：通知只让相关的群与成员失效，失效前发出的请求不再写回，
+// 其他群与其他成员的请求照常写回
+#include "bot/onebot_11/info_cache.h"
+#include "check.h"
+
+using namespace white;
+using namespace white::onebot11;
+
+namespace {
+
+GroupInfo Group(const GId group_id) { return {group_id, "g", 1, 2}; }
+
+GroupMemberInfo Member(const GId group_id, const QId user_id) {
+  GroupMemberInfo info{};
+  info.group_id = group_id;
+  info.user_id = user_id;
+  return info;
+}
+
+void TestMemberNotice() {
+  InfoCache cache;
+  auto before = cache.Generation();
+  cache.OnNotice("group_card", "", 1, 10, 99);
+  // 同一成员的旧响应被丢弃，同群其他成员与其他群不受影响
+  cache.PutMemberInfo(Member(1, 10), before);
+  cache.PutMemberInfo(Member(1, 11), before);
+  cache.PutMemberInfo(Member(2, 10), before);
+  cache.PutGroupInfo(Group(1), before);
+  CHECK(!cache.GetMemberInfo(1, 10));
+  CHECK(cache.GetMemberInfo(1, 11));
+  CHECK(cache.GetMemberInfo(2, 10));
+  CHECK(cache.GetGroupInfo(1));
+  // 通知之后发出的请求可以写回
+  cache.PutMemberInfo(Member(1, 10), cache.Generation());
+  CHECK(cache.GetMemberInfo(1, 10));
+}
+
+void TestGroupNotice() {
+  InfoCache cache;
+  auto before = cache.Generation();
+  cache.OnNotice("group_increase", "approve", 1, 10, 99);
+  cache.PutGroupList({Group(1), Group(2)}, before);
+  cache.PutGroupInfo(Group(1), before);
+  cache.PutGroupInfo(Group(2), before);
+  cache.PutMemberInfo(Member(1, 11), before);
+  CHECK(!cache.GetGroupList());
+  CHECK(!cache.GetGroupInfo(1));
+  CHECK(cache.GetGroupInfo(2));
+  CHECK(cache.GetMemberInfo(1, 11));
+
+  // bot自己退群时整群的成员都失效
+  before = cache.Generation();
+  cache.OnNotice("group_decrease", "kick_me", 2, 99, 99);
+  cache.PutMemberInfo(Member(2, 11), before);
+  cache.PutMemberInfo(Member(1, 12), before);
+  CHECK(!cache.GetMemberInfo(2, 11));
+  CHECK(cache.GetMemberInfo(1, 12));
+}
+
+void TestClearAndOverflow() {
+  InfoCache cache;
+  auto before = cache.Generation();
+  cache.Clear();
+  cache.PutGroupInfo(Group(1), before);
+  CHECK(!cache.GetGroupInfo(1));
+  cache.PutGroupInfo(Group(1), cache.Generation());
+  CHECK(cache.GetGroupInfo(1));
+
+  // 失效记录超过上限后，此前发出的请求一律不写回
+  before = cache.Generation();
+  for (QId user_id = 0; user_id <= InfoCache::kMaxStamps; ++user_id)
+    cache.OnNotice("group_card", "", 3, 1000 + user_id, 99);
+  cache.PutMemberInfo(Member(4, 1), before);
+  CHECK(!cache.GetMemberInfo(4, 1));
+  cache.PutMemberInfo(Member(4, 1), cache.Generation());
+  CHECK(cache.GetMemberInfo(4, 1));
+}
+
+}  // namespace
+
+int main() {
+  TestMemberNotice();
+  TestGroupNotice();
+  TestClearAndOverflow();
+  return 0;
+}
@@ -0,0 +1,157 @@
+// SingleFlight与ApiBot::SendShared：同key的并发请求只发起一次，
+// 每个等待者都得到结果；echo槽位已满时不发出请求；Cancel只影响本调用方
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bot/onebot_11/api_bot.h"
+#include "check.h"
+#include "logger/logger.h"
+#include "tools/single_flight.h"
+
+using namespace white;
+using namespace white::onebot11;
+
+namespace {
+
+constexpr int kCallers = 50;
+
+int64_t MetricOf(const std::string &name) {
+  return metrics::GetMetric(name).Get();
+}
+
+co_future<std::string> ReadyFuture(const std::string &value) {
+  co_promise<std::string> promise;
+  auto ret = promise.get_future();
+  promise.set_value(value);
+  return ret;
+}
+
+void TestSingleFlight() {
+  SingleFlight<std::string> flight("test");
+  const auto started = MetricOf("single_flight.test.started");
+  const auto shared = MetricOf("single_flight.test.shared");
+  int upstream_calls = 0;
+  co_promise<std::string> upstream;
+  std::vector<co_future<std::string>> results;
+  for (int i = 0; i < kCallers; ++i)
+    results.push_back(flight.Do("key", [&] {
+      ++upstream_calls;
+      return upstream.get_future();
+    }));
+  // 其他key不受影响
+  auto other = flight.Do("other", [&] {
+    ++upstream_calls;
+    return ReadyFuture("x");
+  });
+  CHECK(upstream_calls == 2);
+  CHECK(flight.InFlight() == 1);
+  CHECK(MetricOf("single_flight.test.started") - started == 2);
+  CHECK(MetricOf("single_flight.test.shared") - shared == kCallers - 1);
+
+  // 在其他线程上完成，所有等待者都得到同一个值
+  std::thread([&] { upstream.set_value("body"); }).join();
+  for (auto &result : results) CHECK(result.get() == "body");
+  CHECK(other.get() == "x");
+  CHECK(flight.InFlight() == 0);
+
+  // 完成后不再共享，重新发起
+  CHECK(flight.Do("key", [&] {
+               ++upstream_calls;
+               return ReadyFuture("y");
+             }).get() == "y");
+  CHECK(upstream_calls == 3);
+}
+
+struct Sent {
+  std::vector<std::string> frames;
+  std::mutex mutex;
+
+  std::vector<std::string> Take() {
+    std::lock_guard<std::mutex> locker(mutex);
+    return std::move(frames);
+  }
+};
+
+void TestSendShared() {
+  auto registry = std::make_shared<EchoRegistry>();
+  Sent sent;
+  ApiBot bot(
+      [&](const std::string &frame) {
+        std::lock_guard<std::mutex> locker(sent.mutex);
+        sent.frames.push_back(frame);
+      },
+      registry);
+  const auto started = MetricOf("single_flight.api.started");
+  const auto shared = MetricOf("single_flight.api.shared");
+  std::vector<ApiFuture<std::vector<GroupInfo>>> lists;
+  for (int i = 0; i < kCallers; ++i) lists.push_back(bot.get_group_list(true));
+  std::vector<ApiFuture<GroupMemberInfo>> members;
+  for (int i = 0; i < 4; ++i)
+    members.push_back(bot.get_group_member_info(1, i % 2, true));
+  auto frames = sent.Take();
+  // 一个群列表请求，两个不同成员的请求
+  CHECK(frames.size() == 3);
+  CHECK(MetricOf("single_flight.api.started") - started == 3);
+  CHECK(MetricOf("single_flight.api.shared") - shared == kCallers - 1 + 2);
+
+  // 取消其中一个调用方，其他调用方照常得到响应
+  lists[0].Cancel();
+  CHECK(lists[0].Wait().status == ApiStatus::kCancelled);
+
+  for (const auto &frame : frames) {
+    auto request = Json::parse(frame);
+    auto echo = request["echo"].get<uint64_t>();
+    if (request["action"] == "get_group_list")
+      registry->Complete(echo, ApiStatus::kOk,
+                         R"([{"group_id":1,"group_name":"g",)"
+                         R"("member_count":1,"max_member_count":2}])");
+    else if (request["params"]["user_id"] == 0)
+      registry->Complete(echo, ApiStatus::kOk,
+                         R"({"group_id":1,"user_id":0,"role":"owner"})");
+    else
+      registry->Complete(echo, ApiStatus::kOk,
+                         R"({"group_id":1,"user_id":1,"role":"member"})");
+  }
+  for (int i = 1; i < kCallers; ++i) {
+    auto result = lists[i].Wait();
+    CHECK(result.Ok() && result->size() == 1);
+    CHECK((*result)[0].group_name == "g");
+  }
+  for (int i = 0; i < 4; ++i) {
+    auto result = members[i].Wait();
+    CHECK(result.Ok() && result->role == (i % 2 ? "member" : "owner"));
+  }
+  CHECK(registry->Size() == 0);
+}
+
+void TestSendSharedRegistryFull() {
+  auto registry = std::make_shared<EchoRegistry>();
+  Sent sent;
+  ApiBot bot(
+      [&](const std::string &frame) {
+        std::lock_guard<std::mutex> locker(sent.mutex);
+        sent.frames.push_back(frame);
+      },
+      registry);
+  const auto deadline_ms = EchoRegistry::NowMs() + 60000;
+  while (registry->Register([](const ApiStatus, const std::string_view &) {},
+                            deadline_ms)) {
+  }
+  auto result = bot.get_group_list(true).Wait();
+  CHECK(result.status == ApiStatus::kFailed);
+  // 没有echo的请求不会发出
+  CHECK(sent.Take().empty());
+  registry->Clear();
+}
+
+}  // namespace
+
+int main() {
+  LOG_INIT("logs/single_flight_test.log", "INFO");
+  TestSingleFlight();
+  TestSendShared();
+  TestSendSharedRegistryFull();
+  return 0;
+}